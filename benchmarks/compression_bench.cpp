@@ -0,0 +1,82 @@
+/**
+ * @file compression_bench.cpp
+ * @brief CPU time versus bytes saved for response compression
+ */
+
+#include "crest/compression.hpp"
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+static std::string make_json(size_t target_size) {
+    std::string body = "[";
+    for (int i = 0; body.size() < target_size; ++i) {
+        if (i > 0) body += ",";
+        body += "{\"id\":" + std::to_string(i) +
+                ",\"name\":\"user" + std::to_string(i * 7919 % 10007) +
+                "\",\"email\":\"user" + std::to_string(i) + "@example.com\",\"active\":" +
+                (i % 3 ? "true" : "false") + ",\"score\":" + std::to_string((i * 31) % 1000) + "}";
+    }
+    body += "]";
+    return body;
+}
+
+template <typename F>
+static double time_us(int iterations, F&& fn) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) fn();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::micro>(end - start).count() / iterations;
+}
+
+int main() {
+    if (!crest::Compressor::available()) {
+        std::printf("Crest was built without zlib; nothing to measure.\n");
+        return 0;
+    }
+
+    const std::vector<size_t> sizes = {1024, 16 * 1024, 256 * 1024};
+    const std::vector<std::pair<crest::Encoding, std::vector<int>>> encodings = {
+        {crest::Encoding::GZIP, {1, 6, 9}},
+        {crest::Encoding::BROTLI, {1, 5, 11}},
+    };
+
+    std::printf("%-8s %-10s %-6s %12s %12s %8s %12s %14s\n",
+                "encoding", "size", "level", "out bytes", "ratio", "us/op", "MB/s", "fresh us/op");
+
+    for (const auto& [encoding, levels] : encodings) {
+      if (!crest::Compressor::supports(encoding)) continue;
+
+      for (size_t size : sizes) {
+        std::string body = make_json(size);
+        int iterations = size >= 256 * 1024 ? 20 : 1000;
+
+        for (int level : levels) {
+            std::string out;
+            crest::Compressor& reused = crest::Compressor::local(encoding, level);
+
+            double reused_us = time_us(iterations, [&] {
+                out.clear();
+                reused.compress(body.data(), body.size(), out);
+            });
+
+            // A new compressor per response pays for zlib's state allocation every time
+            double fresh_us = time_us(iterations, [&] {
+                std::string fresh_out;
+                crest::Compressor fresh(encoding, level);
+                fresh.compress(body.data(), body.size(), fresh_out);
+            });
+
+            double ratio = (double)out.size() / (double)body.size();
+            double mbps = (double)body.size() / reused_us;
+
+            std::printf("%-8s %-10zu %-6d %12zu %11.1f%% %8.1f %12.1f %14.1f\n",
+                        crest::encoding_name(encoding), body.size(), level, out.size(),
+                        ratio * 100.0, reused_us, mbps, fresh_us);
+        }
+      }
+    }
+
+    return 0;
+}
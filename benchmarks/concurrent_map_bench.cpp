@@ -0,0 +1,121 @@
+/**
+ * @file concurrent_map_bench.cpp
+ * @brief Shared key-value store throughput under contention
+ */
+
+#include "crest/concurrent_map.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// The store from examples/cpp/concurrent_example.cpp: one mutex around one map
+class MutexMap {
+public:
+    bool get(const std::string& key, std::string& out) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = map_.find(key);
+        if (it == map_.end()) return false;
+        out = it->second;
+        return true;
+    }
+
+    void put(const std::string& key, const std::string& value) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        map_[key] = value;
+    }
+
+private:
+    std::mutex mutex_;
+    std::unordered_map<std::string, std::string> map_;
+};
+
+// Every write_every-th operation of each thread is a write, the rest are reads
+template <typename Get, typename Put>
+static double run(int threads, int ops_per_thread, int write_every, const std::vector<std::string>& keys,
+                  Get&& get, Put&& put) {
+    std::atomic<bool> go{false};
+    std::vector<std::thread> workers;
+    workers.reserve(threads);
+    const std::string value(64, 'v');
+
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
+            size_t index = (size_t)t * 7919;
+            std::string out;
+            for (int i = 0; i < ops_per_thread; ++i) {
+                const std::string& key = keys[index++ % keys.size()];
+                if (i % write_every == 0) {
+                    put(key, value);
+                } else {
+                    get(key, out);
+                }
+            }
+        });
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+    for (auto& worker : workers) worker.join();
+    auto end = std::chrono::steady_clock::now();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    return (double)threads * ops_per_thread / seconds / 1e6;
+}
+
+int main() {
+    const int ops = 200000;
+    const std::string value(64, 'v');
+
+    std::vector<std::string> keys;
+    for (int i = 0; i < 4096; ++i) keys.push_back("user:" + std::to_string(i));
+
+    std::printf("%-30s %-8s %-8s %14s\n", "store", "threads", "writes", "Mops/s");
+
+    for (int threads : {1, 8, 32}) {
+        for (int write_every : {10, 2}) {
+            const char* mix = write_every == 10 ? "10%" : "50%";
+
+            MutexMap mutex_map;
+            for (const auto& key : keys) mutex_map.put(key, value);
+            double baseline = run(threads, ops, write_every, keys,
+                [&](const std::string& key, std::string& out) { mutex_map.get(key, out); },
+                [&](const std::string& key, const std::string& v) { mutex_map.put(key, v); });
+
+            crest::ConcurrentMap<std::string, std::string> sharded;
+            for (const auto& key : keys) sharded.insert(key, value);
+            double concurrent = run(threads, ops, write_every, keys,
+                [&](const std::string& key, std::string& out) { sharded.get(key, out); },
+                [&](const std::string& key, const std::string& v) { sharded.insert_or_assign(key, v); });
+
+            crest::Cache<std::string, std::string>::Options opts;
+            opts.max_entries = keys.size() * 2;
+            opts.ttl_ms = 60000;
+            crest::Cache<std::string, std::string> cache(opts);
+            for (const auto& key : keys) cache.put(key, value);
+            double lru = run(threads, ops, write_every, keys,
+                [&](const std::string& key, std::string& out) { cache.get(key, out); },
+                [&](const std::string& key, const std::string& v) { cache.put(key, v); });
+
+            std::printf("%-30s %-8d %-8s %14.2f\n", "mutex + std::unordered_map", threads, mix, baseline);
+            std::printf("%-30s %-8d %-8s %14.2f\n", "crest::ConcurrentMap", threads, mix, concurrent);
+            std::printf("%-30s %-8d %-8s %14.2f\n", "crest::Cache (LRU + TTL)", threads, mix, lru);
+        }
+    }
+
+    // Memory accounting: a byte budget holds regardless of how many keys pass through
+    crest::Cache<std::string, std::string>::Options bounded;
+    bounded.max_bytes = 1024 * 1024;
+    crest::Cache<std::string, std::string> rotating(bounded);
+    for (int i = 0; i < 1000000; ++i) rotating.put("session:" + std::to_string(i), value);
+    auto stats = rotating.stats();
+    std::printf("\n1M keys into a 1 MiB cache -> %zu live, %zu bytes, %llu evicted\n",
+                stats.entries, stats.bytes, (unsigned long long)stats.evictions);
+
+    return 0;
+}
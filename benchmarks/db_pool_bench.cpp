@@ -0,0 +1,72 @@
+/**
+ * @file db_pool_bench.cpp
+ * @brief Connection pool throughput and mutex time with and without thread caches
+ */
+
+#include "crest/database.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+// Does no I/O, so the pool's own overhead is all that is measured
+class NullConnection : public crest::db::Connection {
+public:
+    bool connect(const std::string&) override { return true; }
+    void disconnect() override {}
+    bool is_connected() const override { return true; }
+    crest::db::ResultSet execute(const std::string&) override { return {}; }
+    crest::db::ResultSet execute(const std::string&, const std::vector<crest::db::Value>&) override { return {}; }
+    int execute_update(const std::string&) override { return 0; }
+    int execute_update(const std::string&, const std::vector<crest::db::Value>&) override { return 1; }
+    bool begin_transaction() override { return true; }
+    bool commit() override { return true; }
+    bool rollback() override { return true; }
+    std::string escape(const std::string& str) override { return str; }
+    std::string last_error() const override { return ""; }
+};
+
+static void run(size_t threads, size_t cache_size) {
+    const int requests = 50000;
+    const int borrows_per_request = 4;
+
+    crest::db::ConnectionPool::Config config;
+    config.min_connections = threads;
+    config.max_connections = threads * 2;
+    config.thread_cache_size = cache_size;
+    crest::db::ConnectionPool pool(config, [](const std::string&) { return std::make_shared<NullConnection>(); });
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&] {
+            for (int r = 0; r < requests; ++r) {
+                for (int b = 0; b < borrows_per_request; ++b) {
+                    auto conn = pool.lease();
+                    conn->execute_update("UPDATE t SET x = 1");
+                }
+            }
+        });
+    }
+    for (auto& w : workers) w.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    auto stats = pool.stats();
+    double borrows = (double)threads * requests * borrows_per_request;
+    std::printf("%-8zu %-6zu %12.0f %10.1f%% %12llu %12.1f %12.1f\n",
+                threads, cache_size, borrows / seconds,
+                100.0 * (double)stats.fast_acquires / borrows,
+                (unsigned long long)stats.lock_acquisitions,
+                stats.lock_hold_ns / 1e6, stats.lock_wait_ns / 1e6);
+}
+
+int main() {
+    std::printf("%-8s %-6s %12s %11s %12s %12s %12s\n",
+                "threads", "cache", "borrows/s", "lock-free", "lock takes", "held ms", "waited ms");
+    for (size_t threads : {1, 4, 8}) {
+        run(threads, 0);
+        run(threads, 2);
+    }
+    return 0;
+}
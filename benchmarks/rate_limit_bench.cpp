@@ -0,0 +1,100 @@
+/**
+ * @file rate_limit_bench.cpp
+ * @brief Rate limiter throughput under contention
+ */
+
+#include "crest/rate_limit.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// The previous RateLimitMiddleware: one mutex around an unbounded map
+class MutexLimiter {
+public:
+    bool acquire(const std::string& key) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto now = std::time(nullptr);
+        auto& entry = counts_[key];
+        if (now - entry.second >= 60) {
+            entry.first = 0;
+            entry.second = now;
+        }
+        return ++entry.first <= 1000000000;
+    }
+
+private:
+    std::map<std::string, std::pair<int, time_t>> counts_;
+    std::mutex mutex_;
+};
+
+template <typename F>
+static double run(int threads, int ops_per_thread, const std::vector<std::string>& keys, F&& acquire) {
+    std::atomic<bool> go{false};
+    std::vector<std::thread> workers;
+    workers.reserve(threads);
+
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
+            size_t index = (size_t)t * 7919;
+            for (int i = 0; i < ops_per_thread; ++i) {
+                acquire(keys[index++ % keys.size()]);
+            }
+        });
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+    for (auto& worker : workers) worker.join();
+    auto end = std::chrono::steady_clock::now();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    return (double)threads * ops_per_thread / seconds / 1e6;
+}
+
+int main() {
+    const int threads = 32;
+    const int ops = 200000;
+
+    std::vector<std::string> many;
+    for (int i = 0; i < 4096; ++i) {
+        many.push_back("10." + std::to_string(i / 256) + "." + std::to_string(i % 256) + ".1");
+    }
+    std::vector<std::string> hot = {"203.0.113.7"};
+
+    crest::RateLimiter::Options opts;
+    opts.max_requests = 1000000000;
+    opts.window_seconds = 60;
+
+    std::printf("%-22s %-10s %14s\n", "limiter", "keys", "Mops/s @32thr");
+
+    for (const auto* keys : {&many, &hot}) {
+        MutexLimiter mutex_limiter;
+        double baseline = run(threads, ops, *keys, [&](const std::string& key) {
+            mutex_limiter.acquire(key);
+        });
+
+        crest::RateLimiter limiter(opts);
+        double gcra = run(threads, ops, *keys, [&](const std::string& key) {
+            limiter.acquire(key);
+        });
+
+        std::printf("%-22s %-10zu %14.2f\n", "mutex + std::map", keys->size(), baseline);
+        std::printf("%-22s %-10zu %14.2f\n", "crest::RateLimiter", keys->size(), gcra);
+    }
+
+    // Key rotation: memory stays at capacity instead of growing per key
+    crest::RateLimiter::Options bounded;
+    bounded.capacity = 4096;
+    crest::RateLimiter rotating(bounded);
+    for (int i = 0; i < 1000000; ++i) rotating.acquire("spoofed-" + std::to_string(i));
+    std::printf("\n1M rotated keys -> %zu live of %zu slots\n", rotating.size(), rotating.capacity());
+
+    return 0;
+}
@@ -0,0 +1,137 @@
+/**
+ * @file result_set_bench.cpp
+ * @brief Memory and time of the columnar ResultSet against a vector of maps
+ */
+
+#include "crest/database.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <malloc.h>
+#include <new>
+#include <string>
+#include <vector>
+
+// Every heap allocation is counted, so "memory" is what a layout really costs.
+// Sizes come from the allocator itself, which keeps pointers untouched and
+// counts the allocator's rounding as well.
+static size_t live_bytes = 0;
+static size_t allocations = 0;
+
+void* operator new(size_t size) {
+    void* ptr = std::malloc(size ? size : 1);
+    if (!ptr) throw std::bad_alloc();
+    live_bytes += malloc_usable_size(ptr);
+    ++allocations;
+    return ptr;
+}
+
+// Not inlined: GCC would otherwise see new-expressions paired with free()
+// and warn about mismatched allocation functions
+__attribute__((noinline)) void operator delete(void* ptr) noexcept {
+    if (!ptr) return;
+    live_bytes -= malloc_usable_size(ptr);
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    operator delete(ptr);
+}
+
+using MapRows = std::vector<crest::db::Row>;
+
+static const std::vector<std::string> columns = {"id", "name", "email", "age", "score", "active"};
+
+static std::vector<crest::db::Value> make_row(int i) {
+    return {i, "user" + std::to_string(i), "user" + std::to_string(i) + "@example.com",
+            20 + i % 50, i * 0.5, i % 3 == 0};
+}
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+template <typename Build, typename Scan>
+static void measure(const char* name, int rows, Build build, Scan scan) {
+    const int rounds = 20;
+    double build_s = 0;
+    double scan_s = 0;
+    size_t bytes = 0;
+    size_t allocs = 0;
+    double checksum = 0;
+    for (int r = 0; r < rounds; ++r) {
+        size_t bytes_before = live_bytes;
+        size_t allocs_before = allocations;
+        auto start = std::chrono::steady_clock::now();
+        auto result = build(rows);
+        build_s += seconds_since(start);
+        bytes = live_bytes - bytes_before;
+        allocs = allocations - allocs_before;
+
+        start = std::chrono::steady_clock::now();
+        checksum += scan(result);
+        scan_s += seconds_since(start);
+    }
+    std::printf("%-10s %8d %12.2f %10zu %12.0f %12.0f   (%.0f)\n", name, rows, (double)bytes / rows, allocs,
+                build_s / rounds * 1e6, scan_s / rounds * 1e6, checksum);
+}
+
+int main() {
+    std::printf("%-10s %8s %12s %10s %12s %12s\n", "layout", "rows", "bytes/row", "allocs", "build(us)", "scan(us)");
+
+    for (int rows : {1000, 10000, 100000}) {
+        measure("map", rows,
+            [](int n) {
+                MapRows result;
+                for (int i = 0; i < n; ++i) {
+                    auto values = make_row(i);
+                    crest::db::Row row;
+                    for (size_t c = 0; c < columns.size(); ++c) row[columns[c]] = values[c];
+                    result.push_back(std::move(row));
+                }
+                return result;
+            },
+            // What handlers do today: look every row up by name
+            [](const MapRows& result) {
+                double total = 0;
+                for (const auto& row : result) {
+                    total += std::get<double>(row.at("score"));
+                    total += (double)std::get<std::string>(row.at("name")).size();
+                }
+                return total;
+            });
+
+        measure("columnar", rows,
+            [](int n) {
+                crest::db::ResultSet result(columns);
+                result.reserve(n);
+                for (int i = 0; i < n; ++i) result.append(make_row(i));
+                return result;
+            },
+            [](const crest::db::ResultSet& result) {
+                double total = 0;
+                size_t name = result.column("name");
+                for (double score : result.doubles(result.column("score"))) total += score;
+                for (size_t i = 0; i < result.size(); ++i) total += (double)result.text(i, name).size();
+                return total;
+            });
+
+        measure("row views", rows,
+            [](int n) {
+                crest::db::ResultSet result(columns);
+                result.reserve(n);
+                for (int i = 0; i < n; ++i) result.append(make_row(i));
+                return result;
+            },
+            // Handler code reading by name through the row views
+            [](const crest::db::ResultSet& result) {
+                double total = 0;
+                for (auto row : result) {
+                    total += std::get<double>(row.value("score"));
+                    total += (double)row.text("name").size();
+                }
+                return total;
+            });
+    }
+    return 0;
+}
@@ -4,8 +4,7 @@
  */
 
 #include "crest/crest.hpp"
-#include <mutex>
-#include <unordered_map>
+#include "crest/concurrent_map.hpp"
 #include <atomic>
 #include <chrono>
 #include <iostream>
@@ -24,9 +23,8 @@ int main() {
     // Thread-safe request counter
     std::atomic<uint64_t> request_count{0};
     
-    // Thread-safe data store
-    std::mutex data_mutex;
-    std::unordered_map<std::string, std::string> cache;
+    // Thread-safe data store, sharded so requests for different keys don't contend
+    crest::ConcurrentMap<std::string, std::string> cache;
     
     // Health check endpoint (no locking needed)
     app.get("/", [&](crest::Request& req, crest::Response& res) {
@@ -38,12 +36,10 @@ int main() {
     app.get("/cache", [&](crest::Request& req, crest::Response& res) {
         request_count.fetch_add(1);
         std::string key = req.query("key");
+        std::string value;
         
-        std::lock_guard<std::mutex> lock(data_mutex);
-        auto it = cache.find(key);
-        
-        if (it != cache.end()) {
-            res.json(200, "{\"key\":\"" + key + "\",\"value\":\"" + it->second + "\"}");
+        if (cache.get(key, value)) {
+            res.json(200, "{\"key\":\"" + key + "\",\"value\":\"" + value + "\"}");
         } else {
             res.json(404, "{\"error\":\"Key not found\"}");
         }
@@ -55,8 +51,7 @@ int main() {
         std::string key = req.query("key");
         std::string value = req.body();
         
-        std::lock_guard<std::mutex> lock(data_mutex);
-        cache[key] = value;
+        cache.insert_or_assign(key, value);
         
         res.json(201, "{\"status\":\"created\",\"key\":\"" + key + "\"}");
     });
@@ -66,10 +61,7 @@ int main() {
         request_count.fetch_add(1);
         std::string key = req.query("key");
         
-        std::lock_guard<std::mutex> lock(data_mutex);
-        size_t erased = cache.erase(key);
-        
-        if (erased > 0) {
+        if (cache.erase(key)) {
             res.json(200, "{\"status\":\"deleted\",\"key\":\"" + key + "\"}");
         } else {
             res.json(404, "{\"error\":\"Key not found\"}");
@@ -80,7 +72,6 @@ int main() {
     app.get("/stats", [&](crest::Request& req, crest::Response& res) {
         request_count.fetch_add(1);
         
-        std::lock_guard<std::mutex> lock(data_mutex);
         size_t cache_size = cache.size();
         uint64_t total_requests = request_count.load();
         
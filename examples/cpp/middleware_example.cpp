@@ -18,7 +18,7 @@ int main() {
     cors_opts.allow_credentials = false;
     cors_opts.max_age = 86400;
     
-    crest::CorsMiddleware cors(cors_opts);
+    app.use(std::make_shared<crest::CorsMiddleware>(cors_opts));
     
     // Configure rate limiting
     crest::RateLimitMiddleware::Options rate_opts;
@@ -26,7 +26,7 @@ int main() {
     rate_opts.window_seconds = 60;
     rate_opts.message = "Too many requests, please slow down";
     
-    crest::RateLimitMiddleware rate_limiter(rate_opts);
+    app.use(std::make_shared<crest::RateLimitMiddleware>(rate_opts));
     
     // Configure authentication
     auto token_validator = [](const std::string& token) -> bool {
@@ -34,10 +34,10 @@ int main() {
         return token == "secret-token-123" || token == "admin-token-456";
     };
     
-    crest::AuthMiddleware auth(token_validator);
+    auto auth = std::make_shared<crest::AuthMiddleware>(token_validator);
     
     // Logging middleware
-    crest::LoggingMiddleware logger;
+    app.use(std::make_shared<crest::LoggingMiddleware>());
     
     // Public endpoint (no auth required)
     app.get("/", [](crest::Request& req, crest::Response& res) {
@@ -80,6 +80,13 @@ int main() {
         })");
     });
     
+    // Authentication for the protected and admin routes only
+    app.use(crest::Method::GET, "/protected", auth);
+    app.use("/admin", auth);
+    
+    // Health checks skip CORS, rate limiting and logging
+    app.skip_global_middleware(crest::Method::GET, "/health");
+    
     std::cout << "Server running on http://0.0.0.0:8000" << std::endl;
     std::cout << "Endpoints:" << std::endl;
     std::cout << "  GET  /              - Public welcome" << std::endl;
@@ -0,0 +1,257 @@
+/**
+ * @file background.hpp
+ * @brief Low-priority background work deferred off the request path
+ * @version 0.0.0
+ */
+
+#ifndef CREST_BACKGROUND_HPP
+#define CREST_BACKGROUND_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace crest {
+
+/**
+ * @brief Bounded queue of tasks run by its own low-priority worker threads
+ *
+ * Separate from the request thread pool, so emails, audit writes and other
+ * work the client does not wait for never occupy a request worker's slot in
+ * line, and its threads run below normal OS priority where the platform
+ * allows. The queue holds at most capacity tasks; submit() refuses the rest
+ * rather than letting a slow backend grow memory without bound.
+ *
+ * A task that throws is counted in stats().failed and does not stop the worker.
+ */
+class BackgroundQueue {
+public:
+    using Task = std::function<void()>;
+
+    struct Options {
+        size_t threads;
+        size_t capacity;
+        bool low_priority;
+        int flush_timeout_ms;
+
+        Options() : threads(1), capacity(10000), low_priority(true), flush_timeout_ms(5000) {}
+    };
+
+    struct Stats {
+        size_t pending;
+        uint64_t completed;
+        uint64_t failed;
+        uint64_t rejected;
+        uint64_t discarded;
+    };
+
+    explicit BackgroundQueue(const Options& opts = Options());
+
+    /**
+     * @brief Flush for up to flush_timeout_ms, then stop; tasks still queued are discarded
+     */
+    ~BackgroundQueue();
+
+    BackgroundQueue(const BackgroundQueue&) = delete;
+    BackgroundQueue& operator=(const BackgroundQueue&) = delete;
+
+    /**
+     * @brief Queue a task
+     * @return false if the queue is full or shut down (the task is not run)
+     */
+    bool submit(Task task);
+
+    /**
+     * @brief Wait until every queued and running task has finished
+     * @param timeout_ms Upper bound on the wait; -1 uses flush_timeout_ms
+     * @return false if tasks were still pending when the timeout passed
+     */
+    bool flush(int timeout_ms = -1);
+
+    Stats stats() const;
+
+private:
+    void worker();
+
+    Options options_;
+    mutable std::mutex mutex_;
+    std::condition_variable work_cv_;
+    std::condition_variable idle_cv_;
+    std::deque<Task> queue_;
+    size_t active_;
+    bool stopping_;
+    uint64_t completed_, failed_, rejected_, discarded_;
+    std::vector<std::thread> workers_;
+};
+
+/**
+ * @brief The process-wide queue behind crest::defer() and Response::after_send()
+ *
+ * Created on first use; crest_run() flushes it when the server stops.
+ */
+BackgroundQueue& background();
+
+/**
+ * @brief Configure the process-wide queue
+ * @return false if it was already created (the options are then ignored)
+ */
+bool configure_background(const BackgroundQueue::Options& opts);
+
+/**
+ * @brief Run a task on the process-wide background queue
+ * @return false if the queue is full
+ */
+inline bool defer(BackgroundQueue::Task task) {
+    return background().submit(std::move(task));
+}
+
+/**
+ * @brief Collects items from many requests and hands them to flush() in batches
+ *
+ * add() only appends to a buffer. The first item in an empty buffer
+ * schedules a drain on the background queue, and everything added before
+ * that drain runs goes out in the same flush() call (up to max_batch per
+ * call). Under load, batches therefore grow on their own, e.g. into one
+ * multi-row INSERT instead of one round trip per request.
+ *
+ * @code
+ * crest::BatchSink<AuditEvent> audit([&](std::vector<AuditEvent>& events) {
+ *     db.insert_audit_events(events);
+ * });
+ * app.post("/orders", [&](crest::Request& req, crest::Response& res) {
+ *     audit.add({"order.created", req.remote_addr()});
+ *     res.json(201, "{}");
+ * });
+ * @endcode
+ */
+template <typename T>
+class BatchSink {
+public:
+    using Flush = std::function<void(std::vector<T>&)>;
+
+    /**
+     * @param flush Called on a background thread with each batch
+     * @param max_batch Largest batch passed to flush
+     * @param capacity Items buffered before add() starts refusing them
+     * @param queue Queue to drain on (default: the process-wide one)
+     */
+    explicit BatchSink(Flush flush, size_t max_batch = 256, size_t capacity = 100000, BackgroundQueue* queue = nullptr)
+        : flush_(std::move(flush)), max_batch_(max_batch ? max_batch : 1), capacity_(capacity), queue_(queue),
+          scheduled_(false) {}
+
+    /**
+     * @brief Waits for a scheduled drain, then flushes what is left on this thread
+     *
+     * A drain the queue discarded unrun (e.g. because the queue was destroyed
+     * first) no longer counts as scheduled, so this does not wait for it.
+     */
+    ~BatchSink() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        drained_cv_.wait(lock, [this] { return !scheduled_; });
+        while (!pending_.empty()) {
+            std::vector<T> batch = take_batch();
+            lock.unlock();
+            run(batch);
+            lock.lock();
+        }
+    }
+
+    BatchSink(const BatchSink&) = delete;
+    BatchSink& operator=(const BatchSink&) = delete;
+
+    /**
+     * @return false if the buffer is full
+     */
+    bool add(T item) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (pending_.size() >= capacity_) return false;
+            pending_.push_back(std::move(item));
+            if (scheduled_) return true;
+            scheduled_ = true;
+        }
+        BackgroundQueue& queue = queue_ ? *queue_ : background();
+        // If the queue refuses or later discards the drain, the ticket
+        // unschedules it; the items stay buffered for the next add()
+        queue.submit([ticket = std::make_shared<DrainTicket>(this)] {
+            ticket->ran = true;
+            ticket->sink->drain();
+        });
+        return true;
+    }
+
+    size_t pending() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return pending_.size();
+    }
+
+private:
+    // Owned by the queued drain task; released with it whether or not it ran
+    struct DrainTicket {
+        BatchSink* sink;
+        bool ran = false;
+
+        explicit DrainTicket(BatchSink* owner) : sink(owner) {}
+        ~DrainTicket() {
+            if (!ran) sink->unschedule();
+        }
+    };
+
+    void unschedule() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        scheduled_ = false;
+        drained_cv_.notify_all();
+    }
+
+    std::vector<T> take_batch() {
+        std::vector<T> batch;
+        if (pending_.size() <= max_batch_) {
+            batch.swap(pending_);
+        } else {
+            batch.reserve(max_batch_);
+            for (size_t i = 0; i < max_batch_; ++i) batch.push_back(std::move(pending_[i]));
+            pending_.erase(pending_.begin(), pending_.begin() + (std::ptrdiff_t)max_batch_);
+        }
+        return batch;
+    }
+
+    void run(std::vector<T>& batch) {
+        try {
+            flush_(batch);
+        } catch (...) {
+            // A failing backend must not wedge the sink; the batch is lost
+        }
+    }
+
+    void drain() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!pending_.empty()) {
+            std::vector<T> batch = take_batch();
+            lock.unlock();
+            run(batch);
+            lock.lock();
+        }
+        scheduled_ = false;
+        drained_cv_.notify_all();
+    }
+
+    Flush flush_;
+    size_t max_batch_;
+    size_t capacity_;
+    BackgroundQueue* queue_;
+    mutable std::mutex mutex_;
+    std::condition_variable drained_cv_;
+    std::vector<T> pending_;
+    bool scheduled_;
+};
+
+} // namespace crest
+
+#endif /* CREST_BACKGROUND_HPP */
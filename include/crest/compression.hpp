@@ -0,0 +1,86 @@
+/**
+ * @file compression.hpp
+ * @brief Response compression for Crest framework
+ * @version 0.0.0
+ */
+
+#ifndef CREST_COMPRESSION_HPP
+#define CREST_COMPRESSION_HPP
+
+#include <string>
+#include <memory>
+#include <cstddef>
+
+namespace crest {
+
+enum class Encoding {
+    IDENTITY,
+    GZIP,
+    DEFLATE,
+    BROTLI
+};
+
+/**
+ * @brief Content-Encoding token for an encoding ("gzip", "deflate", "br", "identity")
+ */
+const char* encoding_name(Encoding encoding);
+
+/**
+ * @brief Pick the best supported encoding from an Accept-Encoding header
+ * @param accept_encoding Header value (e.g., "gzip;q=1.0, deflate;q=0.5")
+ * @return Preferred encoding this build supports, IDENTITY when none is acceptable
+ */
+Encoding negotiate_encoding(const std::string& accept_encoding);
+
+/**
+ * @brief Streaming compressor with reusable state
+ *
+ * Output is appended to the caller's buffer, so a buffer that is cleared and
+ * reused keeps its capacity across requests. Use write() with flush = true
+ * for each chunk of a chunked response and finish() after the last one.
+ */
+class Compressor {
+public:
+    explicit Compressor(Encoding encoding = Encoding::GZIP, int level = 6);
+    ~Compressor();
+
+    Compressor(const Compressor&) = delete;
+    Compressor& operator=(const Compressor&) = delete;
+
+    /**
+     * @brief Whether Crest was built with compression support
+     */
+    static bool available();
+    
+    /**
+     * @brief Whether a specific encoding was compiled in
+     */
+    static bool supports(Encoding encoding);
+
+    /**
+     * @brief Compressor owned by the calling thread, created on first use
+     */
+    static Compressor& local(Encoding encoding, int level);
+
+    bool write(const char* data, size_t length, std::string& out, bool flush = false);
+    bool finish(std::string& out);
+    void reset();
+
+    /**
+     * @brief Compress a whole buffer as one stream
+     */
+    bool compress(const char* data, size_t length, std::string& out);
+
+    Encoding encoding() const { return encoding_; }
+    int level() const { return level_; }
+
+private:
+    struct State;
+    std::unique_ptr<State> state_;
+    Encoding encoding_;
+    int level_;
+};
+
+} // namespace crest
+
+#endif /* CREST_COMPRESSION_HPP */
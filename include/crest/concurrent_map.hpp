@@ -0,0 +1,554 @@
+/**
+ * @file concurrent_map.hpp
+ * @brief Sharded concurrent hash map and bounded LRU/TTL cache for handler state
+ * @version 0.0.0
+ */
+
+#ifndef CREST_CONCURRENT_MAP_HPP
+#define CREST_CONCURRENT_MAP_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+namespace crest {
+
+namespace concurrent_detail {
+
+// Power of two, at least 4 shards per hardware thread so writers rarely meet
+inline size_t shard_count(size_t requested) {
+    size_t want = requested;
+    if (want == 0) {
+        unsigned hw = std::thread::hardware_concurrency();
+        want = std::max<size_t>(16, (size_t)(hw ? hw : 4) * 4);
+    }
+    size_t count = 1;
+    while (count < want) count <<= 1;
+    return count;
+}
+
+// std::hash is the identity for integers; spread it before taking shard bits
+inline size_t shard_index(size_t hash, size_t count) {
+    uint64_t mixed = (uint64_t)hash * 0x9e3779b97f4a7c15ull;
+    return (size_t)(mixed >> 32) & (count - 1);
+}
+
+template <typename T>
+size_t default_weight(const T& value) {
+    if constexpr (std::is_same_v<T, std::string>) {
+        return sizeof(T) + value.capacity();
+    } else if constexpr (requires { value.size(); typename T::value_type; }) {
+        return sizeof(T) + value.size() * sizeof(typename T::value_type);
+    } else {
+        return sizeof(T);
+    }
+}
+
+// Hash node, bucket slot and list links around each cached entry
+constexpr size_t kEntryOverhead = 64;
+
+} // namespace concurrent_detail
+
+/**
+ * @brief Hash map that many handler threads can read and write at once
+ *
+ * Keys are spread over independently locked shards, each an unordered_map
+ * behind its own mutex padded to its own cache line, so threads working on
+ * different keys almost never wait on each other, where a single mutex around
+ * one map serializes every request. Critical sections are a single lookup, too
+ * short for a reader-writer lock to pay for its extra atomics. Values are
+ * returned by copy; use update()/upsert() to change a value in place without
+ * a get-then-put race.
+ *
+ * @code
+ * crest::ConcurrentMap<std::string, int> hits;
+ * hits.upsert(req.path(), [](int& n) { ++n; });
+ * @endcode
+ */
+template <typename K, typename V, typename Hash = std::hash<K>, typename KeyEqual = std::equal_to<K>>
+class ConcurrentMap {
+public:
+    /**
+     * @param shards Number of shards, rounded up to a power of two (0 = 4 per hardware thread)
+     */
+    explicit ConcurrentMap(size_t shards = 0)
+        : count_(concurrent_detail::shard_count(shards)), shards_(new Shard[count_]) {}
+
+    ConcurrentMap(const ConcurrentMap&) = delete;
+    ConcurrentMap& operator=(const ConcurrentMap&) = delete;
+
+    /**
+     * @brief Copy of the value for key, if present
+     */
+    std::optional<V> get(const K& key) const {
+        const Shard& shard = shard_for(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.map.find(key);
+        if (it == shard.map.end()) return std::nullopt;
+        return it->second;
+    }
+
+    /**
+     * @brief Copy-assign the value for key into out, reusing out's storage
+     * @return false if the key is absent (out is left unchanged)
+     */
+    bool get(const K& key, V& out) const {
+        const Shard& shard = shard_for(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.map.find(key);
+        if (it == shard.map.end()) return false;
+        out = it->second;
+        return true;
+    }
+
+    bool contains(const K& key) const {
+        const Shard& shard = shard_for(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        return shard.map.find(key) != shard.map.end();
+    }
+
+    /**
+     * @brief Insert if absent
+     * @return false if the key was already present
+     */
+    template <typename T = V>
+    bool insert(const K& key, T&& value) {
+        Shard& shard = shard_for(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        return shard.map.try_emplace(key, std::forward<T>(value)).second;
+    }
+
+    /**
+     * @brief Insert, or assign over the existing value (reusing its storage)
+     */
+    template <typename T = V>
+    void insert_or_assign(const K& key, T&& value) {
+        Shard& shard = shard_for(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.map.insert_or_assign(key, std::forward<T>(value));
+    }
+
+    /**
+     * @brief Run fn(V&) on the value for key, default-constructing it if absent
+     *
+     * fn runs under the shard's lock: keep it short and do not touch the map from it.
+     */
+    template <typename F>
+    void upsert(const K& key, F&& fn) {
+        Shard& shard = shard_for(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        fn(shard.map[key]);
+    }
+
+    /**
+     * @brief Run fn(V&) on the value for key if present
+     * @return false if the key was absent
+     */
+    template <typename F>
+    bool update(const K& key, F&& fn) {
+        Shard& shard = shard_for(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.map.find(key);
+        if (it == shard.map.end()) return false;
+        fn(it->second);
+        return true;
+    }
+
+    bool erase(const K& key) {
+        Shard& shard = shard_for(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        return shard.map.erase(key) > 0;
+    }
+
+    /**
+     * @brief Call fn(key, value) for every entry, one shard locked at a time
+     *
+     * Not a snapshot: entries in shards not yet visited may change meanwhile.
+     */
+    template <typename F>
+    void for_each(F&& fn) const {
+        for (size_t i = 0; i < count_; ++i) {
+            std::lock_guard<std::mutex> lock(shards_[i].mutex);
+            for (const auto& [key, value] : shards_[i].map) fn(key, value);
+        }
+    }
+
+    size_t size() const {
+        size_t total = 0;
+        for (size_t i = 0; i < count_; ++i) {
+            std::lock_guard<std::mutex> lock(shards_[i].mutex);
+            total += shards_[i].map.size();
+        }
+        return total;
+    }
+
+    bool empty() const { return size() == 0; }
+
+    void clear() {
+        for (size_t i = 0; i < count_; ++i) {
+            std::lock_guard<std::mutex> lock(shards_[i].mutex);
+            shards_[i].map.clear();
+        }
+    }
+
+    size_t shard_count() const { return count_; }
+
+private:
+    struct alignas(64) Shard {
+        mutable std::mutex mutex;
+        std::unordered_map<K, V, Hash, KeyEqual> map;
+    };
+
+    Shard& shard_for(const K& key) const {
+        return shards_[concurrent_detail::shard_index(Hash{}(key), count_)];
+    }
+
+    size_t count_;
+    std::unique_ptr<Shard[]> shards_;
+};
+
+/**
+ * @brief Bounded, thread-safe LRU cache with optional expiry
+ *
+ * Sharded like ConcurrentMap, but each shard keeps its entries in recency
+ * order and evicts the least recently used ones once it is over its share of
+ * max_entries or max_bytes. Sizes come from a weigher (default: sizeof plus
+ * the heap bytes of strings and contiguous containers) and include a fixed
+ * per-entry overhead. Entries older than their TTL are dropped when they are
+ * next looked up, when they reach the LRU tail, or by purge_expired().
+ *
+ * Limits are enforced per shard, so the cache may start evicting slightly
+ * before a global limit is reached when keys hash unevenly.
+ *
+ * @code
+ * crest::Cache<std::string, std::string>::Options opts;
+ * opts.max_bytes = 32 * 1024 * 1024;
+ * opts.ttl_ms = 60000;
+ * crest::Cache<std::string, std::string> users(opts);
+ *
+ * std::string profile = users.get_or_put(id, [&] { return load_profile(id); });
+ * @endcode
+ */
+template <typename K, typename V, typename Hash = std::hash<K>, typename KeyEqual = std::equal_to<K>>
+class Cache {
+public:
+    struct Options {
+        size_t max_entries;
+        size_t max_bytes;
+        int64_t ttl_ms;
+        size_t shards;
+
+        Options() : max_entries(0), max_bytes(0), ttl_ms(0), shards(0) {}
+    };
+
+    struct Stats {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t insertions;
+        uint64_t evictions;
+        uint64_t expirations;
+        size_t entries;
+        size_t bytes;
+    };
+
+    using Weigher = std::function<size_t(const K&, const V&)>;
+
+    /**
+     * @param opts max_entries / max_bytes bound the cache (0 = unbounded);
+     *             ttl_ms is the default time to live (0 = never expires);
+     *             shards is rounded up to a power of two (0 = automatic)
+     * @param weigher Bytes charged for an entry, before the fixed overhead
+     */
+    explicit Cache(const Options& opts = Options(), Weigher weigher = nullptr)
+        : options_(opts), weigher_(std::move(weigher)) {
+        size_t requested = opts.shards;
+        if (requested == 0 && opts.max_entries > 0) {
+            // Small caches get fewer shards so each can hold a useful number of entries
+            requested = std::min(concurrent_detail::shard_count(0), std::max<size_t>(1, opts.max_entries / 8));
+        }
+        count_ = concurrent_detail::shard_count(requested);
+        shard_entries_ = opts.max_entries ? (opts.max_entries + count_ - 1) / count_ : 0;
+        shard_bytes_ = opts.max_bytes ? (opts.max_bytes + count_ - 1) / count_ : 0;
+        shards_.reset(new Shard[count_]);
+    }
+
+    Cache(const Cache&) = delete;
+    Cache& operator=(const Cache&) = delete;
+
+    /**
+     * @brief Copy of the cached value, marking it most recently used
+     */
+    std::optional<V> get(const K& key) {
+        std::optional<V> result;
+        lookup(key, [&](const V& value) { result.emplace(value); });
+        return result;
+    }
+
+    /**
+     * @brief Copy-assign the cached value into out, reusing out's storage
+     * @return false on a miss (out is left unchanged)
+     */
+    bool get(const K& key, V& out) {
+        return lookup(key, [&](const V& value) { out = value; });
+    }
+
+    /**
+     * @brief Whether key is cached and unexpired, without changing its recency
+     */
+    bool contains(const K& key) const {
+        Shard& shard = shard_for(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.index.find(key);
+        return it != shard.index.end() && !expired(*it->second, now_us());
+    }
+
+    /**
+     * @brief Insert or replace with the default TTL
+     */
+    template <typename T = V>
+    void put(const K& key, T&& value) {
+        put(key, std::forward<T>(value), options_.ttl_ms);
+    }
+
+    /**
+     * @brief Insert or replace with its own TTL (0 = never expires)
+     *
+     * Replacing assigns over the cached value, so same-sized updates do not allocate.
+     */
+    template <typename T = V>
+    void put(const K& key, T&& value, int64_t ttl_ms) {
+        size_t cost = concurrent_detail::kEntryOverhead + weigh(key, value);
+        int64_t now = now_us();
+        int64_t expires = ttl_ms > 0 ? now + ttl_ms * 1000 : 0;
+
+        Shard& shard = shard_for(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.index.find(key);
+        if (it != shard.index.end()) {
+            auto entry = it->second;
+            entry->value = std::forward<T>(value);
+            entry->expires_us = expires;
+            shard.bytes = shard.bytes - entry->cost + cost;
+            entry->cost = cost;
+            if (entry != shard.lru.begin()) shard.lru.splice(shard.lru.begin(), shard.lru, entry);
+        } else {
+            shard.lru.push_front(Entry{key, V(std::forward<T>(value)), expires, cost});
+            shard.index.emplace(key, shard.lru.begin());
+            shard.bytes += cost;
+        }
+        ++shard.insertions;
+        evict(shard, now);
+    }
+
+    /**
+     * @brief Cached value for key, or make() stored and returned on a miss
+     *
+     * make() runs without any lock held, so concurrent misses on one key may
+     * each call it; the first value stored wins and is returned to all of them.
+     */
+    template <typename F>
+    V get_or_put(const K& key, F&& make) {
+        if (auto cached = get(key)) return std::move(*cached);
+        V value = make();
+
+        int64_t now = now_us();
+        Shard& shard = shard_for(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.index.find(key);
+        if (it != shard.index.end() && !expired(*it->second, now)) return it->second->value;
+        if (it != shard.index.end()) shard.erase(it->second);
+
+        size_t cost = concurrent_detail::kEntryOverhead + weigh(key, value);
+        int64_t expires = options_.ttl_ms > 0 ? now + options_.ttl_ms * 1000 : 0;
+        shard.lru.push_front(Entry{key, value, expires, cost});
+        shard.index.emplace(key, shard.lru.begin());
+        shard.bytes += cost;
+        ++shard.insertions;
+        evict(shard, now);
+        return value;
+    }
+
+    bool erase(const K& key) {
+        Shard& shard = shard_for(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.index.find(key);
+        if (it == shard.index.end()) return false;
+        shard.erase(it->second);
+        return true;
+    }
+
+    /**
+     * @brief Drop every expired entry (O(size)); expired entries are otherwise removed lazily
+     * @return Number of entries removed
+     */
+    size_t purge_expired() {
+        size_t removed = 0;
+        int64_t now = now_us();
+        for (size_t i = 0; i < count_; ++i) {
+            Shard& shard = shards_[i];
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            for (auto it = shard.lru.begin(); it != shard.lru.end();) {
+                auto next = std::next(it);
+                if (expired(*it, now)) {
+                    shard.erase(it);
+                    ++shard.expirations;
+                    ++removed;
+                }
+                it = next;
+            }
+        }
+        return removed;
+    }
+
+    void clear() {
+        for (size_t i = 0; i < count_; ++i) {
+            std::lock_guard<std::mutex> lock(shards_[i].mutex);
+            shards_[i].index.clear();
+            shards_[i].lru.clear();
+            shards_[i].bytes = 0;
+        }
+    }
+
+    size_t size() const {
+        size_t total = 0;
+        for (size_t i = 0; i < count_; ++i) {
+            std::lock_guard<std::mutex> lock(shards_[i].mutex);
+            total += shards_[i].lru.size();
+        }
+        return total;
+    }
+
+    /**
+     * @brief Bytes charged for all entries, including per-entry overhead
+     */
+    size_t bytes() const {
+        size_t total = 0;
+        for (size_t i = 0; i < count_; ++i) {
+            std::lock_guard<std::mutex> lock(shards_[i].mutex);
+            total += shards_[i].bytes;
+        }
+        return total;
+    }
+
+    Stats stats() const {
+        Stats total{};
+        for (size_t i = 0; i < count_; ++i) {
+            const Shard& shard = shards_[i];
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            total.hits += shard.hits;
+            total.misses += shard.misses;
+            total.insertions += shard.insertions;
+            total.evictions += shard.evictions;
+            total.expirations += shard.expirations;
+            total.entries += shard.lru.size();
+            total.bytes += shard.bytes;
+        }
+        return total;
+    }
+
+    size_t shard_count() const { return count_; }
+
+private:
+    struct Entry {
+        K key;
+        V value;
+        int64_t expires_us;
+        size_t cost;
+    };
+
+    // Counters live with the data they describe, under the shard lock, so
+    // statistics add no shared cache line to the hot path
+    struct alignas(64) Shard {
+        mutable std::mutex mutex;
+        std::list<Entry> lru;
+        std::unordered_map<K, typename std::list<Entry>::iterator, Hash, KeyEqual> index;
+        size_t bytes = 0;
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t insertions = 0;
+        uint64_t evictions = 0;
+        uint64_t expirations = 0;
+
+        void erase(typename std::list<Entry>::iterator it) {
+            bytes -= it->cost;
+            index.erase(it->key);
+            lru.erase(it);
+        }
+    };
+
+    template <typename F>
+    bool lookup(const K& key, F&& copy) {
+        Shard& shard = shard_for(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.index.find(key);
+        if (it == shard.index.end()) {
+            ++shard.misses;
+            return false;
+        }
+        // Entries without a TTL skip the clock read
+        if (it->second->expires_us != 0 && expired(*it->second, now_us())) {
+            shard.erase(it->second);
+            ++shard.expirations;
+            ++shard.misses;
+            return false;
+        }
+        if (it->second != shard.lru.begin()) shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+        ++shard.hits;
+        copy(it->second->value);
+        return true;
+    }
+
+    static int64_t now_us() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static bool expired(const Entry& entry, int64_t now) {
+        return entry.expires_us != 0 && now >= entry.expires_us;
+    }
+
+    size_t weigh(const K& key, const V& value) const {
+        if (weigher_) return weigher_(key, value);
+        return concurrent_detail::default_weight(key) + concurrent_detail::default_weight(value);
+    }
+
+    // The newest entry is kept even if it alone exceeds the byte budget
+    void evict(Shard& shard, int64_t now) {
+        while (shard.lru.size() > 1 &&
+               ((shard_entries_ && shard.lru.size() > shard_entries_) || (shard_bytes_ && shard.bytes > shard_bytes_))) {
+            auto victim = std::prev(shard.lru.end());
+            if (expired(*victim, now)) {
+                ++shard.expirations;
+            } else {
+                ++shard.evictions;
+            }
+            shard.erase(victim);
+        }
+    }
+
+    Shard& shard_for(const K& key) const {
+        return shards_[concurrent_detail::shard_index(Hash{}(key), count_)];
+    }
+
+    Options options_;
+    Weigher weigher_;
+    size_t count_;
+    size_t shard_entries_;
+    size_t shard_bytes_;
+    std::unique_ptr<Shard[]> shards_;
+};
+
+} // namespace crest
+
+#endif /* CREST_CONCURRENT_MAP_HPP */
@@ -37,6 +37,7 @@ extern "C" {
 typedef struct crest_app crest_app_t;
 typedef struct crest_request crest_request_t;
 typedef struct crest_response crest_response_t;
+typedef struct crest_pending crest_pending_t;
 
 typedef struct crest_config {
     const char* title;
@@ -114,6 +115,15 @@ CREST_API void crest_set_request_schema(crest_app_t* app, crest_method_t method,
  */
 CREST_API void crest_set_response_schema(crest_app_t* app, crest_method_t method, const char* path, const char* schema);
 
+/**
+ * @brief Set the request timeout for a route, overriding the app-wide timeout
+ * @param app Application instance
+ * @param method HTTP method
+ * @param path Route path
+ * @param timeout_ms Timeout in milliseconds; 0 falls back to the app-wide timeout
+ */
+CREST_API void crest_set_route_timeout(crest_app_t* app, crest_method_t method, const char* path, int timeout_ms);
+
 /**
  * @brief Start the server
  * @param app Application instance
@@ -166,6 +176,35 @@ CREST_API const char* crest_request_get_query(crest_request_t* req, const char*
  */
 CREST_API const char* crest_request_get_header(crest_request_t* req, const char* key);
 
+/**
+ * @brief Get a cookie sent by the client
+ * @param req Request object
+ * @param name Cookie name (case-sensitive)
+ * @return Cookie value or NULL
+ */
+CREST_API const char* crest_request_get_cookie(crest_request_t* req, const char* name);
+
+/**
+ * @brief Get the peer address of the connection
+ * @param req Request object
+ * @return IP address string, empty when unknown
+ */
+CREST_API const char* crest_request_get_remote_addr(crest_request_t* req);
+
+/**
+ * @brief Get the time left before the request's deadline
+ * @param req Request object
+ * @return Milliseconds left (0 once expired), or -1 when the request has no deadline
+ */
+CREST_API int64_t crest_request_get_remaining_ms(crest_request_t* req);
+
+/**
+ * @brief Check whether the request's deadline has passed
+ * @param req Request object
+ * @return true if the client no longer wants the result
+ */
+CREST_API bool crest_request_deadline_exceeded(crest_request_t* req);
+
 /**
  * @brief Send JSON response
  * @param res Response object
@@ -198,6 +237,27 @@ CREST_API void crest_response_html(crest_response_t* res, int status, const char
  */
 CREST_API void crest_response_set_header(crest_response_t* res, const char* key, const char* value);
 
+/**
+ * @brief Finish the response after the handler returns
+ *
+ * The handler may return without responding and hand req, res and the
+ * returned handle to another thread or event loop. That code fills in res
+ * and calls crest_response_complete() exactly once. The worker is free in
+ * the meantime, and req and res stay valid until completion. If the
+ * request's deadline passes first, the client gets a 504 right away; res
+ * must still be completed, and its content is then discarded.
+ *
+ * @param res Response object of a request being served
+ * @return Handle for crest_response_complete(), or NULL outside the server
+ */
+CREST_API crest_pending_t* crest_response_defer(crest_response_t* res);
+
+/**
+ * @brief Send a deferred response; callable from any thread
+ * @param pending Handle from crest_response_defer(); invalid afterwards
+ */
+CREST_API void crest_response_complete(crest_pending_t* pending);
+
 /**
  * @brief Enable/disable Swagger UI
  * @param app Application instance
@@ -226,6 +286,22 @@ CREST_API void crest_set_description(crest_app_t* app, const char* description);
  */
 CREST_API void crest_set_proxy(crest_app_t* app, const char* proxy_url);
 
+/**
+ * @brief Set the default request timeout
+ * @param app Application instance
+ * @param timeout_ms Milliseconds from accept to deadline; 0 for no timeout
+ */
+CREST_API void crest_set_request_timeout(crest_app_t* app, int timeout_ms);
+
+/**
+ * @brief Shed load with 503 once requests queue for too long
+ * @param app Application instance
+ * @param target_ms Acceptable queueing delay; 0 disables load shedding
+ * @param interval_ms How long the delay must stay above target before dropping
+ * @param max_concurrency Upper bound for the adaptive limit on queued plus running connections
+ */
+CREST_API void crest_set_load_shedding(crest_app_t* app, int target_ms, int interval_ms, int max_concurrency);
+
 /**
  * @brief Enable or disable console logging
  * @param enabled true to enable, false to disable
@@ -12,14 +12,26 @@
 #define CREST_HPP
 
 #include "crest.h"
+#include "deadline.hpp"
+#include "task.hpp"
+#include "parallel.hpp"
 #include <string>
 #include <functional>
 #include <memory>
 #include <map>
 #include <vector>
+#include <type_traits>
+#include <initializer_list>
 
 namespace crest {
 
+namespace internal {
+struct RouteState;
+class ResponseCache;
+class Scheduler;
+struct TimerState;
+}
+
 constexpr const char* VERSION = CREST_VERSION;
 
 enum class Method {
@@ -44,7 +56,22 @@ enum class Status {
     METHOD_NOT_ALLOWED = 405,
     INTERNAL_ERROR = 500,
     NOT_IMPLEMENTED = 501,
-    SERVICE_UNAVAILABLE = 503
+    SERVICE_UNAVAILABLE = 503,
+    GATEWAY_TIMEOUT = 504
+};
+
+/**
+ * @brief Attributes of a Set-Cookie header
+ */
+struct CookieOptions {
+    std::string path;
+    std::string domain;
+    int max_age_seconds;    // -1 = session cookie, 0 = delete now
+    bool secure;
+    bool http_only;
+    std::string same_site;  // "Strict", "Lax", "None" or empty to omit
+    
+    CookieOptions() : path("/"), domain(), max_age_seconds(-1), secure(false), http_only(true), same_site("Lax") {}
 };
 
 class Request {
@@ -56,6 +83,20 @@ public:
     std::string body() const;
     std::string query(const std::string& key) const;
     std::string header(const std::string& key) const;
+    std::string remote_addr() const;
+    
+    /**
+     * @brief Value of a cookie; the Cookie header is parsed on first use
+     */
+    std::string cookie(const std::string& name) const;
+    bool has_cookie(const std::string& name) const;
+    std::map<std::string, std::string> cookies() const;
+    
+    /**
+     * @brief When the client stops waiting for this request
+     */
+    Deadline deadline() const;
+    
     std::map<std::string, std::string> queries() const;
     std::map<std::string, std::string> headers() const;
     
@@ -77,6 +118,32 @@ public:
     void html(int status, const std::string& html);
     void set_header(const std::string& key, const std::string& value);
     
+    /**
+     * @brief Add a Set-Cookie header
+     * @throws Exception if the name is not a token or the value holds characters cookies cannot carry
+     */
+    void set_cookie(const std::string& name, const std::string& value, const CookieOptions& opts = CookieOptions());
+    
+    /**
+     * @brief Tell the client to delete a cookie (path and domain must match how it was set)
+     */
+    void clear_cookie(const std::string& name, const CookieOptions& opts = CookieOptions());
+    
+    /**
+     * @brief Run a task after this response has been written to the client
+     *
+     * The task goes to the background queue (see crest/background.hpp), so the
+     * client's latency covers only the critical path. Tasks run even if
+     * sending failed; they are dropped if the response is never sent, a
+     * deadline already answered the client with 504, or the queue is full.
+     */
+    void after_send(std::function<void()> task);
+    
+    int status() const;
+    std::string body() const;
+    std::string header(const std::string& key) const;
+    bool sent() const;
+    
     crest_response_t* raw() { return res_; }
     
 private:
@@ -85,6 +152,51 @@ private:
 
 using Handler = std::function<void(Request&, Response&)>;
 
+/**
+ * @brief Coroutine route handler; see crest/task.hpp
+ */
+using AsyncHandler = std::function<Task<void>(Request&, Response&)>;
+
+namespace internal {
+template <typename F>
+using IfAsyncHandler = std::enable_if_t<std::is_same_v<std::invoke_result_t<F&, Request&, Response&>, Task<void>>, int>;
+
+/**
+ * @brief Route handler that starts a coroutine handler
+ */
+Handler async_entry(AsyncHandler handler);
+}
+
+/**
+ * @brief Continuation passed to middleware to invoke the rest of the chain
+ *
+ * A non-owning reference to a callable living on the caller's stack, so
+ * calling through the chain never allocates. Do not store it beyond the
+ * handle() call that received it.
+ */
+class Next {
+public:
+    template <typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, Next>>>
+    Next(F&& fn) noexcept
+        : target_(const_cast<void*>(static_cast<const void*>(std::addressof(fn)))),
+          invoke_([](void* target) { (*static_cast<std::remove_reference_t<F>*>(target))(); }) {}
+    
+    void operator()() const { invoke_(target_); }
+
+private:
+    void* target_;
+    void (*invoke_)(void*);
+};
+
+using NextFunction = Next;
+using MiddlewareFunction = std::function<void(Request&, Response&, NextFunction)>;
+
+class Middleware {
+public:
+    virtual ~Middleware() = default;
+    virtual void handle(Request& req, Response& res, NextFunction next) = 0;
+};
+
 struct Config {
     std::string title = "Crest API";
     std::string description = "RESTful API built with Crest";
@@ -95,6 +207,65 @@ struct Config {
     std::string proxy_url;
     int max_connections = 1000;
     int timeout_seconds = 30;
+    bool load_shedding = false;
+    int queue_target_ms = 5;
+    int queue_interval_ms = 100;
+};
+
+/**
+ * @brief Request parts that select a distinct cached response, besides method and path
+ */
+struct CacheKey {
+    std::vector<std::string> query;
+    std::vector<std::string> headers;
+    // Allow caching a route that has (global, group or route) middleware
+    bool with_middleware = false;
+    
+    CacheKey() = default;
+    CacheKey(std::initializer_list<std::string> query_keys) : query(query_keys) {}
+};
+
+/**
+ * @brief How a timer started with App::every() or App::after() fires
+ */
+struct TimerOptions {
+    int jitter_ms;       // Each run is delayed by a random 0..jitter_ms, so instances do not fire in lockstep
+    bool allow_overlap;  // Start a run even if the previous one is still going
+
+    TimerOptions() : jitter_ms(0), allow_overlap(false) {}
+};
+
+/**
+ * @brief Handle to a scheduled job; copies refer to the same job
+ */
+class Timer {
+public:
+    Timer() = default;
+    
+    /**
+     * @brief Stop future runs (a run already started finishes)
+     */
+    void cancel();
+    
+    /**
+     * @brief false once cancelled or, for a one-shot timer, once it has run
+     */
+    bool active() const;
+    
+    /**
+     * @brief Runs started so far
+     */
+    uint64_t runs() const;
+    
+    /**
+     * @brief Periodic runs skipped because the previous run was still going
+     */
+    uint64_t skipped() const;
+    
+private:
+    friend class internal::Scheduler;
+    explicit Timer(std::shared_ptr<internal::TimerState> state) : state_(std::move(state)) {}
+    std::shared_ptr<internal::TimerState> state_;
 };
 
 class App {
@@ -172,6 +343,53 @@ public:
      */
     App& route(Method method, const std::string& path, Handler handler, const std::string& description = "");
     
+    /**
+     * @brief Register a coroutine route, whose handler returns crest::Task<void>
+     *
+     * The handler may co_await crest::sleep_for(), crest::run_blocking(),
+     * crest::Completion and other Tasks. While it is suspended its worker
+     * serves other requests, and it resumes on the thread pool. Middleware
+     * runs before it as usual, but code a middleware runs after next() sees a
+     * response that is not sent yet if the handler suspended, so compression,
+     * ETags, idempotency and coalescing do not apply to those responses.
+     *
+     * @code
+     * app.get("/slow", [](crest::Request& req, crest::Response& res) -> crest::Task<void> {
+     *     co_await crest::sleep_for(std::chrono::seconds(1));
+     *     res.json(200, "{}");
+     * });
+     * @endcode
+     */
+    template <typename F, internal::IfAsyncHandler<F> = 0>
+    App& route(Method method, const std::string& path, F&& handler, const std::string& description = "") {
+        return route(method, path, internal::async_entry(std::forward<F>(handler)), description);
+    }
+    
+    template <typename F, internal::IfAsyncHandler<F> = 0>
+    App& get(const std::string& path, F&& handler, const std::string& description = "") {
+        return route(Method::GET, path, std::forward<F>(handler), description);
+    }
+    
+    template <typename F, internal::IfAsyncHandler<F> = 0>
+    App& post(const std::string& path, F&& handler, const std::string& description = "") {
+        return route(Method::POST, path, std::forward<F>(handler), description);
+    }
+    
+    template <typename F, internal::IfAsyncHandler<F> = 0>
+    App& put(const std::string& path, F&& handler, const std::string& description = "") {
+        return route(Method::PUT, path, std::forward<F>(handler), description);
+    }
+    
+    template <typename F, internal::IfAsyncHandler<F> = 0>
+    App& del(const std::string& path, F&& handler, const std::string& description = "") {
+        return route(Method::DELETE, path, std::forward<F>(handler), description);
+    }
+    
+    template <typename F, internal::IfAsyncHandler<F> = 0>
+    App& patch(const std::string& path, F&& handler, const std::string& description = "") {
+        return route(Method::PATCH, path, std::forward<F>(handler), description);
+    }
+    
     /**
      * @brief Set request schema for a route
      * @param method HTTP method
@@ -190,6 +408,123 @@ public:
      */
     App& set_response_schema(Method method, const std::string& path, const std::string& schema);
     
+    /**
+     * @brief Set the request timeout for a route, overriding Config::timeout_seconds
+     * @param method HTTP method
+     * @param path Route path
+     * @param timeout_ms Timeout in milliseconds; 0 uses the app-wide timeout
+     * @return Reference to this app for chaining
+     */
+    App& set_timeout(Method method, const std::string& path, int timeout_ms);
+    
+    /**
+     * @brief Cache the most recently registered GET route's responses
+     *
+     * Hits are sent straight from a serialized buffer without running the
+     * handler. Once ttl_ms has passed, a response stays servable for
+     * stale_while_revalidate_ms more while a single request refreshes it in
+     * the background.
+     *
+     * A route with middleware is only cached with key.with_middleware set.
+     * Its middleware then still runs on every hit, up to where the handler
+     * would be called, so authentication and rate limits apply; if it answers
+     * (e.g. 401 or 429) the hit is not served. Hits are shared between all
+     * clients whose request has the same key, so list headers such as
+     * Authorization in key.headers when the response depends on them.
+     *
+     * @code
+     * app.get("/catalog", list_catalog).cache(5000, {"page", "category"});
+     * @endcode
+     *
+     * @param ttl_ms How long a response is fresh
+     * @param key Query parameters and headers that select a distinct response
+     * @param stale_while_revalidate_ms How long a stale response may still be served
+     * @return Reference to this app for chaining
+     * @throws Exception if the last route is not a GET route, or has middleware
+     *         without key.with_middleware
+     */
+    App& cache(int ttl_ms, const CacheKey& key = CacheKey(), int stale_while_revalidate_ms = 0);
+    
+    /**
+     * @brief Cache a GET route's responses (see cache(int, const CacheKey&, int))
+     */
+    App& cache(Method method, const std::string& path, int ttl_ms, const CacheKey& key = CacheKey(),
+               int stale_while_revalidate_ms = 0);
+    
+    /**
+     * @brief Memory budget shared by all cached routes (default 64 MiB)
+     */
+    void set_cache_capacity(size_t max_bytes);
+    
+    /**
+     * @brief Add global middleware, run for every route in registration order
+     * @param middleware Middleware instance
+     * @return Reference to this app for chaining
+     */
+    App& use(std::shared_ptr<Middleware> middleware);
+    App& use(MiddlewareFunction middleware);
+    
+    /**
+     * @brief Add middleware for a route group, run after global middleware
+     * @param prefix Path prefix (e.g., "/api" matches "/api" and "/api/users")
+     * @param middleware Middleware instance
+     * @return Reference to this app for chaining
+     */
+    App& use(const std::string& prefix, std::shared_ptr<Middleware> middleware);
+    App& use(const std::string& prefix, MiddlewareFunction middleware);
+    
+    /**
+     * @brief Add middleware for a single route, run after group middleware
+     * @param method HTTP method
+     * @param path Route path
+     * @param middleware Middleware instance
+     * @return Reference to this app for chaining
+     */
+    App& use(Method method, const std::string& path, std::shared_ptr<Middleware> middleware);
+    App& use(Method method, const std::string& path, MiddlewareFunction middleware);
+    
+    /**
+     * @brief Exclude a route from global middleware (group and route middleware still run)
+     * @param method HTTP method
+     * @param path Route path
+     * @return Reference to this app for chaining
+     */
+    App& skip_global_middleware(Method method, const std::string& path);
+    
+    /**
+     * @brief Run a job every interval_ms while the server is running
+     *
+     * Jobs run on the request thread pool, driven by the server's timer
+     * wheel (10ms resolution). Runs are scheduled from the previous
+     * scheduled time rather than from when the job finished, so they do not
+     * drift; if a run is still going when the next is due, that run is
+     * skipped unless allow_overlap is set. The first run is interval_ms after
+     * the server starts, or after this call if it is already running.
+     * Timers stop when the server stops and resume with the next run().
+     *
+     * @code
+     * crest::TimerOptions jitter;
+     * jitter.jitter_ms = 2000;
+     * app.every(30000, [&] { catalog.refresh(); }, jitter);
+     * @endcode
+     *
+     * @param interval_ms Time between runs
+     * @param job Job to run; exceptions are logged
+     * @param options Jitter and overlap settings
+     * @return Handle to cancel the job
+     * @throws Exception if interval_ms is not positive
+     */
+    Timer every(int interval_ms, std::function<void()> job, const TimerOptions& options = TimerOptions());
+    
+    /**
+     * @brief Run a job once, delay_ms after the server starts or after this call if it is running
+     * @param delay_ms Delay before the run
+     * @param job Job to run; exceptions are logged
+     * @param options Jitter settings
+     * @return Handle to cancel the job
+     */
+    Timer after(int delay_ms, std::function<void()> job, const TimerOptions& options = TimerOptions());
+    
     /**
      * @brief Start the server
      * @param host Host address
@@ -226,6 +561,21 @@ public:
      */
     void set_proxy(const std::string& proxy_url);
     
+    /**
+     * @brief Set the default request timeout
+     * @param timeout_ms Milliseconds from accept to deadline; 0 for no timeout
+     */
+    void set_request_timeout(int timeout_ms);
+    
+    /**
+     * @brief Answer 503 instead of queueing without bound under overload
+     * @param enabled true to enable, false to disable
+     * @param target_ms Acceptable time a request may wait for a worker
+     * @param interval_ms How long the wait must stay above target before shedding
+     * @param max_concurrency Ceiling for the adaptive limit on queued plus running requests
+     */
+    void set_load_shedding(bool enabled, int target_ms = 5, int interval_ms = 100, int max_concurrency = 1000);
+    
     /**
      * @brief Enable or disable console logging
      * @param enabled true to enable, false to disable
@@ -245,8 +595,18 @@ public:
     crest_app_t* raw() { return app_; }
     
 private:
+    internal::RouteState* find_route(Method method, const std::string& path);
+    void build_chain(internal::RouteState& route);
+    void build_chains();
+    // Rebuild every chain; if a cached route rejects its new chain, undo the change and rethrow
+    void rebuild_or_undo(const std::function<void()>& undo);
+    
     crest_app_t* app_;
-    std::map<void*, Handler> handlers_;
+    std::vector<std::shared_ptr<Middleware>> middleware_;
+    std::vector<std::pair<std::string, std::shared_ptr<Middleware>>> group_middleware_;
+    std::vector<std::unique_ptr<internal::RouteState>> routes_;
+    std::unique_ptr<internal::ResponseCache> response_cache_;
+    std::unique_ptr<internal::Scheduler> scheduler_;
 };
 
 class Exception : public std::exception {
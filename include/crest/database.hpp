@@ -10,17 +10,279 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
 #include <memory>
 #include <functional>
 #include <variant>
 #include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <string_view>
+#include <unordered_map>
+#include "deadline.hpp"
 
 namespace crest {
 namespace db {
 
 using Value = std::variant<std::nullptr_t, int, double, std::string, bool>;
 using Row = std::map<std::string, Value>;
-using ResultSet = std::vector<Row>;
+
+/**
+ * @brief Storage type of a ResultSet column
+ *
+ * A column takes the type of its first non-null value. A value of another
+ * type turns it into Mixed, which stores Values.
+ */
+enum class ColumnType { Null, Int, Double, String, Bool, Mixed };
+
+/**
+ * @brief Query result stored column by column
+ *
+ * Column names are kept once in an index shared by every row, each column
+ * is one contiguous array of its type, and the text of all string cells
+ * lives in a single arena. A 10k-row result is therefore a handful of
+ * allocations instead of a map and a copy of every column name per row.
+ *
+ * Rows are read through RowView: value() copies a cell, text() views a
+ * string cell, and a view converts to a map-based Row where existing code
+ * needs one (with at() returning references). Hot loops can read a
+ * column's typed array directly.
+ *
+ * Drivers fill it with add_column() and append(), or push_back(Row).
+ *
+ * @code
+ * crest::db::ResultSet rows = conn->execute("SELECT id, name FROM users");
+ * for (auto row : rows) {
+ *     std::string_view name = row.text("name");   // no copy
+ *     int id = std::get<int>(row.value("id"));
+ * }
+ * const std::vector<int>& ids = rows.ints(rows.column("id"));
+ * @endcode
+ */
+class ResultSet {
+public:
+    static constexpr size_t npos = (size_t)-1;
+    
+    class RowView {
+    public:
+        RowView(const ResultSet* set, size_t row) : set_(set), row_(row) {}
+        
+        size_t index() const { return row_; }
+        
+        /**
+         * @brief A copy of a cell
+         * @throws std::out_of_range if there is no such column
+         */
+        Value value(const std::string& column) const;
+        Value value(size_t column) const { return set_->value(row_, column); }
+        
+        // The map-based Row's at() and operator[] returned references that
+        // callers kept; a view can only return copies, so these do not
+        // compile. Use value(), text(), or convert to a Row.
+        Value at(const std::string& column) const = delete;
+        Value operator[](const std::string& column) const = delete;
+        
+        size_t count(const std::string& column) const { return set_->column(column) != npos ? 1 : 0; }
+        bool is_null(const std::string& column) const;
+        
+        /**
+         * @brief A string cell without copying it; empty for other types
+         */
+        std::string_view text(const std::string& column) const;
+        
+        Row to_row() const;
+        operator Row() const { return to_row(); }
+
+    private:
+        const ResultSet* set_;
+        size_t row_;
+    };
+    
+    class iterator {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = RowView;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = RowView;
+        
+        iterator(const ResultSet* set, size_t row) : set_(set), row_(row) {}
+        
+        RowView operator*() const { return RowView(set_, row_); }
+        RowView operator[](difference_type n) const { return RowView(set_, row_ + n); }
+        iterator& operator++() { ++row_; return *this; }
+        iterator operator++(int) { iterator copy = *this; ++row_; return copy; }
+        iterator& operator--() { --row_; return *this; }
+        iterator& operator+=(difference_type n) { row_ += n; return *this; }
+        iterator operator+(difference_type n) const { return iterator(set_, row_ + n); }
+        difference_type operator-(const iterator& other) const { return (difference_type)row_ - (difference_type)other.row_; }
+        bool operator==(const iterator& other) const { return row_ == other.row_; }
+        bool operator!=(const iterator& other) const { return row_ != other.row_; }
+        bool operator<(const iterator& other) const { return row_ < other.row_; }
+
+    private:
+        const ResultSet* set_;
+        size_t row_;
+    };
+    using const_iterator = iterator;
+    
+    ResultSet() : rows_(0) {}
+    ResultSet(std::initializer_list<Row> rows);
+    
+    /**
+     * @brief Empty result with a fixed set of columns, for append()
+     */
+    explicit ResultSet(const std::vector<std::string>& columns);
+    
+    /**
+     * @return Index of the new column; existing rows get null in it
+     */
+    size_t add_column(const std::string& name);
+    
+    /**
+     * @brief Add a row with one value per column, in column order
+     * @throws std::invalid_argument if values.size() != column_count()
+     */
+    void append(const std::vector<Value>& values);
+    
+    /**
+     * @brief Add a row by column name; new names become columns
+     */
+    void push_back(const Row& row);
+    
+    void reserve(size_t rows);
+    
+    size_t size() const { return rows_; }
+    bool empty() const { return rows_ == 0; }
+    
+    RowView operator[](size_t row) const { return RowView(this, row); }
+    RowView at(size_t row) const;
+    RowView front() const { return RowView(this, 0); }
+    iterator begin() const { return iterator(this, 0); }
+    iterator end() const { return iterator(this, rows_); }
+    
+    size_t column_count() const { return names_.size(); }
+    const std::vector<std::string>& column_names() const { return names_; }
+    
+    /**
+     * @return The column's index, or npos
+     */
+    size_t column(const std::string& name) const;
+    
+    ColumnType column_type(size_t column) const { return columns_[column].type; }
+    
+    Value value(size_t row, size_t column) const;
+    bool is_null(size_t row, size_t column) const;
+    std::string_view text(size_t row, size_t column) const;
+    
+    /**
+     * @brief A column's contiguous values; null cells hold 0 / false / ""
+     * @throws std::logic_error if the column is not of that type
+     */
+    const std::vector<int>& ints(size_t column) const;
+    const std::vector<double>& doubles(size_t column) const;
+    const std::vector<uint8_t>& bools(size_t column) const;
+    
+    /**
+     * @brief Bytes held by the result, excluding the object itself
+     */
+    size_t memory_usage() const;
+
+private:
+    // A string cell: its bytes in arena_
+    struct Text {
+        uint32_t offset;
+        uint32_t length;
+    };
+    
+    struct Column {
+        ColumnType type = ColumnType::Null;
+        std::vector<uint8_t> nulls;         // 1 for a null cell
+        std::vector<int> ints;
+        std::vector<double> doubles;
+        std::vector<uint8_t> bools;
+        std::vector<Text> texts;
+        std::vector<Value> mixed;
+    };
+    
+    void set_cell(Column& column, const Value& value);
+    void to_mixed(Column& column);
+    const Column& typed(size_t column, ColumnType type) const;
+    
+    std::vector<std::string> names_;
+    std::unordered_map<std::string, size_t> index_;    // Shared by all rows
+    std::vector<Column> columns_;
+    std::string arena_;
+    size_t rows_;
+};
+
+/**
+ * @brief A query compiled by the database for repeated execution
+ *
+ * Drivers with server-side prepared statements derive from it to keep
+ * their handle and release it in the destructor.
+ */
+class Statement {
+public:
+    explicit Statement(std::string sql) : sql_(std::move(sql)) {}
+    virtual ~Statement() = default;
+    
+    const std::string& sql() const { return sql_; }
+
+private:
+    std::string sql_;
+};
+
+/**
+ * @brief Least-recently-used prepared statements of one connection, keyed by SQL text
+ *
+ * Not synchronised: a connection is used by one thread at a time.
+ */
+class StatementCache {
+public:
+    explicit StatementCache(size_t capacity = 64) : capacity_(capacity), hits_(0), misses_(0), evictions_(0) {}
+    
+    StatementCache(const StatementCache&) = delete;
+    StatementCache& operator=(const StatementCache&) = delete;
+    
+    /**
+     * @return The statement for sql, now most recently used, or nullptr
+     */
+    std::shared_ptr<Statement> find(const std::string& sql);
+    
+    /**
+     * @brief Add a statement, evicting the least recently used beyond capacity
+     */
+    void insert(std::shared_ptr<Statement> stmt);
+    
+    /**
+     * @brief Drop every statement, e.g. after the driver reconnected
+     */
+    void clear();
+    
+    /**
+     * @brief Change the capacity; 0 disables caching
+     */
+    void set_capacity(size_t capacity);
+    
+    size_t size() const { return index_.size(); }
+    size_t capacity() const { return capacity_; }
+    uint64_t hits() const { return hits_; }
+    uint64_t misses() const { return misses_; }
+    uint64_t evictions() const { return evictions_; }
+
+private:
+    void trim();
+    
+    size_t capacity_;
+    std::list<std::shared_ptr<Statement>> order_;   // Most recently used first
+    std::unordered_map<std::string_view, std::list<std::shared_ptr<Statement>>::iterator> index_;
+    uint64_t hits_, misses_, evictions_;
+};
 
 class Connection {
 public:
@@ -42,31 +304,262 @@ public:
     
     virtual std::string escape(const std::string& str) = 0;
     virtual std::string last_error() const = 0;
+    
+    /**
+     * @brief Compile a query once so it can run many times without being re-parsed
+     *
+     * Drivers with server-side prepared statements override this and the
+     * *_prepared() calls. The defaults keep the SQL text and run it through
+     * execute(), so the calls work with every driver.
+     *
+     * @return nullptr if the database rejected the query
+     */
+    virtual std::shared_ptr<Statement> prepare(const std::string& query) {
+        return std::make_shared<Statement>(query);
+    }
+    
+    virtual ResultSet execute_prepared(Statement& stmt, const std::vector<Value>& params) {
+        return execute(stmt.sql(), params);
+    }
+    
+    virtual int execute_update_prepared(Statement& stmt, const std::vector<Value>& params) {
+        return execute_update(stmt.sql(), params);
+    }
+    
+    /**
+     * @brief This connection's statement for query, prepared on first use
+     *
+     * QueryBuilder::execute() and Model go through here, so each distinct
+     * generated SQL string is prepared once per connection.
+     *
+     * @return nullptr if prepare() failed (not cached)
+     */
+    std::shared_ptr<Statement> statement(const std::string& query);
+    
+    StatementCache& statements() { return statements_; }
+
+private:
+    StatementCache statements_;
 };
 
+/**
+ * @brief Bounded pool of database connections shared by request threads
+ *
+ * With a factory the pool opens min_connections up front and grows on
+ * demand up to max_connections. Threads that find every connection taken
+ * wait in line and are served in arrival order: a returned connection goes
+ * straight to the longest waiter rather than to whichever thread grabs the
+ * mutex first. Without a factory it only lends out connections given to
+ * add().
+ *
+ * Connections that have been idle longer than idle_check_seconds are
+ * validated before they are handed out, and connections older than
+ * max_lifetime_seconds are closed and replaced, so a database failover or
+ * a server-side idle timeout does not surface as a failed request.
+ *
+ * A thread that returns a connection while nobody is waiting parks it in
+ * its own cache of up to thread_cache_size connections and takes it back
+ * on its next borrow with one atomic exchange, without the pool mutex.
+ * Parked connections stay visible to the pool: a thread that finds no
+ * idle connection steals a parked one before opening a new one, and
+ * returns skip the caches while anyone waits, so parking neither grows
+ * the pool nor starves other threads.
+ */
 class ConnectionPool {
 public:
+    /**
+     * @brief Opens a connection to connection_string; returns nullptr on failure
+     */
+    using Factory = std::function<std::shared_ptr<Connection>(const std::string& connection_string)>;
+    
     struct Config {
         std::string connection_string;
         size_t min_connections = 2;
         size_t max_connections = 10;
         int timeout_seconds = 30;
+        int max_lifetime_seconds = 1800;    // 0 keeps connections forever
+        int idle_check_seconds = 30;        // Validate connections idle longer than this; -1 never
+        size_t thread_cache_size = 2;       // Connections a thread parks for its next borrow; 0 disables
+        std::function<bool(Connection&)> health_check;  // Default: is_connected()
+    };
+    
+    /**
+     * @brief Counters since the pool was created
+     */
+    struct Stats {
+        uint64_t fast_acquires;         // Taken from the thread's cache without the mutex
+        uint64_t locked_acquires;
+        uint64_t steals;                // Parked by another thread, taken under the mutex
+        uint64_t fast_releases;         // Parked without the mutex
+        uint64_t lock_acquisitions;
+        uint64_t lock_wait_ns;          // Spent waiting for the pool mutex
+        uint64_t lock_hold_ns;          // Spent holding it, excluding condition waits
+    };
+    
+private:
+    enum State { LEASED, SHARED, PARKED, RETIRED };
+    
+    struct Entry : std::enable_shared_from_this<Entry> {
+        std::shared_ptr<Connection> conn;
+        int64_t created_us = 0;
+        int64_t returned_us = 0;        // Written only by the thread that holds the connection
+        std::atomic<int> state{LEASED};
+    };
+
+public:
+    /**
+     * @brief A connection on loan; returns it to the pool when destroyed
+     *
+     * Move-only. Returning it is O(1): the lease knows its pool entry.
+     *
+     * @code
+     * auto conn = pool.lease(req.deadline());
+     * if (!conn) throw crest::Exception("Database busy", 503);
+     * auto rows = conn->execute("SELECT * FROM users");
+     * @endcode
+     */
+    class Lease {
+    public:
+        Lease() : pool_(nullptr), entry_(nullptr) {}
+        ~Lease() { release(); }
+        
+        Lease(Lease&& other) noexcept : pool_(other.pool_), entry_(other.entry_) {
+            other.pool_ = nullptr;
+            other.entry_ = nullptr;
+        }
+        Lease& operator=(Lease&& other) noexcept {
+            if (this != &other) {
+                release();
+                pool_ = other.pool_;
+                entry_ = other.entry_;
+                other.pool_ = nullptr;
+                other.entry_ = nullptr;
+            }
+            return *this;
+        }
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        
+        explicit operator bool() const { return entry_ != nullptr; }
+        Connection* operator->() const { return entry_->conn.get(); }
+        Connection& operator*() const { return *entry_->conn; }
+        Connection* get() const { return entry_ ? entry_->conn.get() : nullptr; }
+        
+        /**
+         * @brief Return the connection now
+         */
+        void release();
+
+    private:
+        friend class ConnectionPool;
+        Lease(ConnectionPool* pool, Entry* entry) : pool_(pool), entry_(entry) {}
+        
+        ConnectionPool* pool_;
+        Entry* entry_;
     };
     
     explicit ConnectionPool(const Config& config);
+    
+    /**
+     * @brief Pool that opens its own connections, min_connections of them right away
+     */
+    ConnectionPool(const Config& config, Factory factory);
+    
+    /**
+     * @brief Closes the pooled connections; every lease must have been returned
+     */
     ~ConnectionPool();
     
+    ConnectionPool(const ConnectionPool&) = delete;
+    ConnectionPool& operator=(const ConnectionPool&) = delete;
+    
+    /**
+     * @brief Hand an open connection to the pool
+     */
+    void add(std::shared_ptr<Connection> conn);
+    
+    /**
+     * @brief Borrow a connection, waiting up to timeout_seconds for one
+     * @return An empty lease if none became available in time or the factory failed
+     */
+    Lease lease();
+    
+    /**
+     * @brief Borrow a connection, giving up at the earlier of the deadline and timeout_seconds
+     * @param deadline Usually the request's, so abandoned requests stop waiting for a connection
+     */
+    Lease lease(const Deadline& deadline);
+    
+    /**
+     * @brief Take a connection, waiting up to timeout_seconds for one; give it back with release()
+     * @return nullptr if none became available in time
+     */
     std::shared_ptr<Connection> acquire();
+    
+    /**
+     * @brief Take a connection, giving up at the earlier of the deadline and timeout_seconds
+     * @param deadline Usually the request's, so abandoned requests stop waiting for a connection
+     * @return nullptr if none became available in time or the deadline had already passed
+     */
+    std::shared_ptr<Connection> acquire(const Deadline& deadline);
+    
     void release(std::shared_ptr<Connection> conn);
     
+    /**
+     * @brief Validate idle connections, retire old ones and reopen up to min_connections
+     *
+     * Borrowing already does this lazily; call it from a timer (e.g.
+     * app.every()) to keep quiet pools healthy too.
+     */
+    void maintain();
+    
     size_t available_count() const;
     size_t active_count() const;
+    
+    /**
+     * @brief Open connections, idle or leased
+     */
+    size_t size() const;
+    
+    Stats stats() const;
 
 private:
+    struct Waiter {
+        std::condition_variable cv;
+        Entry* entry = nullptr;
+        bool may_open = false;
+    };
+    
+    struct ThreadCache;
+    class TimedLock;
+    
+    Entry* checkout(const Deadline& deadline);
+    void checkin(Entry* entry, bool may_park);
+    Entry* take_parked();
+    bool park(Entry* entry);
+    Entry* steal();
+    Entry* open_entry();
+    bool usable(const Entry& entry, int64_t now_us);
+    bool expired(const Entry& entry, int64_t now_us) const;
+    void retire(Entry* entry);
+    void hand_over(Entry* entry);
+    void pass_on_slot();
+    void warm_up();
+    ThreadCache* local_cache(bool create);
+    
     Config config_;
-    std::vector<std::shared_ptr<Connection>> available_;
-    std::vector<std::shared_ptr<Connection>> active_;
+    Factory factory_;
+    std::unordered_map<Connection*, std::shared_ptr<Entry>> entries_;
+    std::vector<Entry*> idle_;          // SHARED entries, most recently returned last
+    std::deque<Waiter*> waiters_;       // Oldest first
+    size_t opening_;                    // Slots reserved by threads running the factory
+    std::atomic<size_t> active_;
+    std::atomic<size_t> waiting_;       // Borrowers in the locked path; returns skip the caches meanwhile
+    std::shared_ptr<char> token_;       // Thread caches recognise this pool by it
     mutable std::mutex mutex_;
+    
+    mutable std::atomic<uint64_t> fast_acquires_{0}, locked_acquires_{0}, steals_{0}, fast_releases_{0};
+    mutable std::atomic<uint64_t> lock_acquisitions_{0}, lock_wait_ns_{0}, lock_hold_ns_{0};
 };
 
 class QueryBuilder {
@@ -79,6 +572,13 @@ public:
     QueryBuilder& and_where(const std::string& column, const std::string& op, const Value& value);
     QueryBuilder& or_where(const std::string& condition);
     QueryBuilder& or_where(const std::string& column, const std::string& op, const Value& value);
+    
+    /**
+     * @brief Conditions whose value is bound when a Query built from this runs
+     */
+    QueryBuilder& where(const std::string& column, const std::string& op);
+    QueryBuilder& and_where(const std::string& column, const std::string& op);
+    QueryBuilder& or_where(const std::string& column, const std::string& op);
     QueryBuilder& order_by(const std::string& column, bool ascending = true);
     QueryBuilder& limit(int count);
     QueryBuilder& offset(int count);
@@ -93,12 +593,34 @@ public:
     
     QueryBuilder& delete_from(const std::string& table);
     
+    /**
+     * @brief INSERT / UPDATE columns whose values are bound when a Query built from this runs
+     *
+     * They follow the columns given to values() / set(), in the order listed.
+     */
+    QueryBuilder& columns(const std::vector<std::string>& names);
+    
     std::string build() const;
     std::vector<Value> get_params() const;
+    
+    /**
+     * @brief Run the query as a cached prepared statement of conn
+     */
+    ResultSet execute(Connection& conn) const;
+    
+    /**
+     * @brief Run an INSERT, UPDATE or DELETE as a cached prepared statement of conn
+     * @return Rows affected
+     */
+    int execute_update(Connection& conn) const;
 
 private:
+    friend class Query;
+    
     std::string query_;
     std::vector<Value> params_;
+    std::vector<bool> unbound_;         // Per entry of params_: a placeholder to bind later
+    std::vector<std::string> bound_columns_;
     std::string table_;
     std::vector<std::string> columns_;
     std::vector<std::string> conditions_;
@@ -110,6 +632,49 @@ private:
     enum { SELECT, INSERT, UPDATE, DELETE } type_;
 };
 
+/**
+ * @brief A query shape whose SQL is built once; each run only binds values
+ *
+ * Declare it once, e.g. as a static, from a QueryBuilder that leaves the
+ * per-request values as placeholders. The SQL text and the position of
+ * every parameter are worked out then; execute() copies the fixed values,
+ * fills in the arguments and runs the connection's cached prepared
+ * statement for the text.
+ *
+ * @code
+ * static const crest::db::Query find_user(
+ *     crest::db::QueryBuilder().select({"id", "name"}).from("users").where("id", "=").limit(1));
+ *
+ * auto rows = find_user.execute(*conn, {user_id});
+ * @endcode
+ */
+class Query {
+public:
+    Query() = default;
+    explicit Query(const QueryBuilder& shape);
+    
+    const std::string& sql() const { return sql_; }
+    
+    /**
+     * @brief Number of values execute() expects
+     */
+    size_t arity() const { return holes_.size(); }
+    
+    /**
+     * @brief All statement parameters, with args in the placeholders' order
+     * @throws std::invalid_argument if args.size() != arity()
+     */
+    std::vector<Value> bind(const std::vector<Value>& args) const;
+    
+    ResultSet execute(Connection& conn, const std::vector<Value>& args = {}) const;
+    int execute_update(Connection& conn, const std::vector<Value>& args = {}) const;
+
+private:
+    std::string sql_;
+    std::vector<Value> params_;         // Fixed values, placeholders left null
+    std::vector<size_t> holes_;         // Index in params_ of each placeholder
+};
+
 class Model {
 public:
     virtual ~Model() = default;
@@ -0,0 +1,161 @@
+/**
+ * @file deadline.hpp
+ * @brief Request deadlines for Crest framework
+ * @version 0.0.0
+ */
+
+#ifndef CREST_DEADLINE_HPP
+#define CREST_DEADLINE_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <cstdint>
+
+namespace crest {
+
+/**
+ * @brief Point in time after which a request's result is no longer wanted
+ *
+ * Every request carries one (see Request::deadline()), set from the app's
+ * request timeout, the route's timeout and the client's grpc-timeout or
+ * X-Request-Timeout header, whichever ends first. It runs from the moment the
+ * connection was accepted, so time spent queued for a worker counts. Pass it
+ * on to anything that blocks (db::ConnectionPool::acquire, condition
+ * variables, futures) so abandoned requests stop holding resources.
+ *
+ * A default-constructed Deadline never expires.
+ */
+class Deadline {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    Deadline() : at_(Clock::time_point::max()) {}
+    explicit Deadline(Clock::time_point at) : at_(at) {}
+
+    static Deadline never() { return Deadline(); }
+
+    template <typename Rep, typename Period>
+    static Deadline after(std::chrono::duration<Rep, Period> timeout) {
+        return Deadline(Clock::now() + std::chrono::duration_cast<Clock::duration>(timeout));
+    }
+
+    /**
+     * @brief Deadline from microseconds on the steady clock (0 means none)
+     */
+    static Deadline from_us(int64_t steady_us) {
+        if (steady_us <= 0) return Deadline();
+        return Deadline(Clock::time_point(std::chrono::microseconds(steady_us)));
+    }
+
+    /**
+     * @brief Microseconds on the steady clock, 0 when there is no deadline
+     */
+    int64_t to_us() const {
+        if (!is_set()) return 0;
+        return std::chrono::duration_cast<std::chrono::microseconds>(at_.time_since_epoch()).count();
+    }
+
+    static int64_t now_us() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now().time_since_epoch()).count();
+    }
+
+    bool is_set() const { return at_ != Clock::time_point::max(); }
+    bool expired() const { return is_set() && Clock::now() >= at_; }
+    Clock::time_point time_point() const { return at_; }
+
+    /**
+     * @brief Time left, zero once expired and milliseconds::max() without a deadline
+     */
+    std::chrono::milliseconds remaining() const {
+        if (!is_set()) return std::chrono::milliseconds::max();
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(at_ - Clock::now());
+        return left.count() > 0 ? left : std::chrono::milliseconds(0);
+    }
+
+    /**
+     * @brief The earlier of two deadlines
+     */
+    Deadline earliest(const Deadline& other) const { return other.at_ < at_ ? other : *this; }
+
+    /**
+     * @brief Deadline ending at the earlier of this one and now + timeout
+     */
+    template <typename Rep, typename Period>
+    Deadline within(std::chrono::duration<Rep, Period> timeout) const {
+        return earliest(after(timeout));
+    }
+
+    /**
+     * @brief Wait on a condition variable until pred() holds or the deadline passes
+     * @return pred() on return
+     */
+    template <typename Predicate>
+    bool wait(std::condition_variable& cv, std::unique_lock<std::mutex>& lock, Predicate pred) const {
+        if (!is_set()) {
+            cv.wait(lock, pred);
+            return true;
+        }
+        return cv.wait_until(lock, at_, pred);
+    }
+
+    /**
+     * @brief Wait for a std::future / std::shared_future until the deadline
+     * @return true if the result is ready
+     */
+    template <typename Future>
+    bool wait(const Future& future) const {
+        if (!is_set()) {
+            future.wait();
+            return true;
+        }
+        return future.wait_until(at_) == std::future_status::ready;
+    }
+
+    /**
+     * @brief Sleep for a duration, cut short by the deadline
+     * @return true if the full duration elapsed before the deadline
+     */
+    template <typename Rep, typename Period>
+    bool sleep_for(std::chrono::duration<Rep, Period> duration) const {
+        auto until = Clock::now() + std::chrono::duration_cast<Clock::duration>(duration);
+        if (until <= at_) {
+            std::this_thread::sleep_until(until);
+            return true;
+        }
+        std::this_thread::sleep_until(at_);
+        return false;
+    }
+
+    /**
+     * @throws Exception with code 504 if the deadline has passed
+     */
+    void check() const;
+
+    /**
+     * @brief Remaining time as a grpc-timeout header value (e.g. "1500m"), empty without a deadline
+     */
+    std::string grpc_timeout() const;
+
+    /**
+     * @brief Parse a grpc-timeout value ("<digits><H|M|S|m|u|n>")
+     * @return false if malformed
+     */
+    static bool parse_grpc_timeout(const char* value, std::chrono::microseconds& out);
+
+    /**
+     * @brief Parse an X-Request-Timeout value in milliseconds
+     * @return false if malformed
+     */
+    static bool parse_request_timeout(const char* value, std::chrono::microseconds& out);
+
+private:
+    Clock::time_point at_;
+};
+
+} // namespace crest
+
+#endif /* CREST_DEADLINE_HPP */
@@ -25,6 +25,7 @@ typedef struct {
     void* cpp_handler;
     char* request_schema;
     char* response_schema;
+    int timeout_ms;
 } crest_route_entry_t;
 
 struct crest_app {
@@ -42,24 +43,94 @@ struct crest_app {
     int server_socket;
     void* route_mutex;
     void* thread_pool;
+    void* cors;
+    void* scheduler;            /* crest::internal::Scheduler owned by the C++ App, or NULL */
+    int shed_target_ms;
+    int shed_interval_ms;
+    int shed_max_concurrency;
+    int request_timeout_ms;
 };
 
+typedef struct {
+    char* key;
+    char* value;
+} crest_kv_t;
+
+typedef struct {
+    crest_kv_t* items;
+    size_t count;
+    size_t capacity;
+} crest_kv_list_t;
+
 struct crest_request {
     char* method;
     char* path;
     char* body;
     char* query_string;
-    void* headers;
-    void* queries;
+    crest_kv_list_t headers;
+    crest_kv_list_t queries;
+    char remote_addr[46];
+    int64_t deadline_us;
+    crest_kv_list_t cookies;    /* Parsed from Cookie headers on first use */
+    bool cookies_parsed;
 };
 
+/* Work queued by a handler to run once its response has been sent */
+typedef struct {
+    void (*fn)(void* arg);
+    void* arg;
+    void (*cleanup)(void* arg);   /* Always called once, after fn or instead of it; may be NULL */
+} crest_deferred_t;
+
 struct crest_response {
     int status;
     char* body;
-    void* headers;
+    size_t body_length;
+    const char* content_type;
+    crest_kv_list_t headers;
+    char* raw_headers;
+    size_t raw_headers_length;
     bool sent;
+    crest_deferred_t* deferred;
+    size_t deferred_count;
+    size_t deferred_capacity;
+    void* exchange;             /* Server connection state, NULL outside the server */
 };
 
+#ifdef __cplusplus
+extern "C" {
+#endif
 
+/* Key/value lists (headers, query parameters) */
+void crest_kv_add(crest_kv_list_t* list, const char* key, const char* value);
+void crest_kv_set(crest_kv_list_t* list, const char* key, const char* value);
+const char* crest_kv_get(const crest_kv_list_t* list, const char* key, bool ignore_case);
+/* Queue work for after the response is sent; crest_response_free cleans up work never handed off */
+bool crest_response_add_deferred(crest_response_t* res, void (*fn)(void*), void* arg, void (*cleanup)(void*));
+
+/* Cookies of a request, parsing its Cookie headers the first time */
+const crest_kv_list_t* crest_request_cookies(crest_request_t* req);
+void crest_kv_remove(crest_kv_list_t* list, const char* key);
+void crest_kv_free(crest_kv_list_t* list);
+
+/* Request/response lifetime */
+void crest_request_free(crest_request_t* req);
+void crest_response_set_body(crest_response_t* res, const char* data, size_t length);
+/* Append pre-serialized "Key: value\r\n" lines, written verbatim after the header list */
+void crest_response_append_raw_headers(crest_response_t* res, const char* data, size_t length);
+char* crest_response_serialize(const crest_response_t* res, size_t* length);
+void crest_response_free(crest_response_t* res);
+
+/* Routing */
+const char* crest_method_name(crest_method_t method);
+bool crest_route_find(crest_app_t* app, const char* method, const char* path, crest_route_entry_t* out);
+
+/* Deadlines: steady-clock microseconds, 0 when none applies */
+int64_t crest_resolve_deadline(const crest_app_t* app, const crest_route_entry_t* route,
+                               const crest_request_t* req, int64_t accepted_us);
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif /* CREST_APP_INTERNAL_H */
@@ -0,0 +1,96 @@
+/**
+ * @file load_shedder.hpp
+ * @brief Internal adaptive concurrency limit and CoDel queue management
+ */
+
+#ifndef CREST_LOAD_SHEDDER_HPP
+#define CREST_LOAD_SHEDDER_HPP
+
+#include <atomic>
+#include <mutex>
+#include <cstddef>
+#include <cstdint>
+
+namespace crest {
+namespace internal {
+
+/**
+ * @brief Decides which accepted connections reach a handler under overload
+ *
+ * Sits between accept() and the thread pool. admit() caps the number of
+ * connections that are queued or running at an adaptive limit; connections
+ * over it are refused on the accept thread. When a worker picks a connection
+ * up, should_drop() applies CoDel to its queueing delay (sojourn time): once
+ * the delay has stayed above target for a whole interval, connections are
+ * dropped at a rate that grows with the square root of the drop count until
+ * the delay falls back under target. Each drop also cuts the concurrency
+ * limit by 10%; every request served with a short queue raises it by 1/limit,
+ * so the limit settles where the backend keeps up.
+ *
+ * Times are microseconds on a monotonic clock, passed in so tests can drive it.
+ */
+class LoadShedder {
+public:
+    struct Options {
+        int64_t target_us;
+        int64_t interval_us;
+        size_t min_limit;
+        size_t max_limit;
+
+        Options() : target_us(5000), interval_us(100000), min_limit(1), max_limit(1000) {}
+    };
+
+    explicit LoadShedder(const Options& opts = Options());
+
+    LoadShedder(const LoadShedder&) = delete;
+    LoadShedder& operator=(const LoadShedder&) = delete;
+
+    /**
+     * @brief Reserve a slot for a new connection
+     * @return false if the concurrency limit is reached
+     */
+    bool admit();
+
+    /**
+     * @brief CoDel decision for an admitted connection leaving the queue
+     * @param sojourn_us Time the connection spent queued
+     * @param now_us Current time
+     * @return true if it should be answered with 503; its slot is released
+     */
+    bool should_drop(int64_t sojourn_us, int64_t now_us);
+
+    /**
+     * @brief Release the slot of a connection that was served
+     * @param sojourn_us Time it spent queued before a worker took it
+     */
+    void complete(int64_t sojourn_us);
+
+    size_t limit() const { return limit_.load(std::memory_order_relaxed); }
+    size_t in_flight() const { return in_flight_.load(std::memory_order_relaxed); }
+    uint64_t rejected() const { return rejected_.load(std::memory_order_relaxed); }
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    int64_t control_law(int64_t t) const;
+    void decrease_limit();
+
+    Options options_;
+    std::atomic<size_t> limit_;
+    std::atomic<size_t> in_flight_;
+    std::atomic<uint64_t> rejected_;
+    std::atomic<uint64_t> dropped_;
+
+    // CoDel state and the fractional limit, guarded by mutex_
+    std::mutex mutex_;
+    double limit_estimate_;
+    int64_t first_above_time_;
+    int64_t drop_next_;
+    uint32_t drop_count_;
+    uint32_t last_drop_count_;
+    bool dropping_;
+};
+
+} // namespace internal
+} // namespace crest
+
+#endif /* CREST_LOAD_SHEDDER_HPP */
@@ -0,0 +1,121 @@
+/**
+ * @file pipeline.hpp
+ * @brief Internal per-route middleware pipeline
+ */
+
+#ifndef CREST_PIPELINE_HPP
+#define CREST_PIPELINE_HPP
+
+#include "../crest.hpp"
+#include "app_internal.h"
+#include "response_cache.hpp"
+#include <string>
+#include <vector>
+#include <memory>
+
+namespace crest {
+namespace internal {
+
+struct RouteState {
+    Method method;
+    std::string path;
+    Handler handler;
+    std::vector<std::shared_ptr<Middleware>> middleware;
+    bool skip_global = false;
+    
+    // Flattened global -> group -> route chain, rebuilt whenever middleware
+    // is registered so dispatch only walks a prebuilt array.
+    std::vector<Middleware*> chain;
+    
+    // Set by App::cache(); the server answers hits where the chain reaches the handler
+    std::unique_ptr<CachePolicy> cache;
+    
+    void dispatch(Request& req, Response& res) const;
+};
+
+/**
+ * @brief Run a matched route: the C++ pipeline if present, else the C handler
+ */
+void dispatch(const crest_route_entry_t& route, crest_request_t* req, crest_response_t* res);
+
+/**
+ * @brief Run a matched route, calling at_handler where the chain reaches the handler
+ *
+ * The route cache uses it to mark the headers this request's middleware set
+ * and to answer hits behind the middleware. The handler only runs if
+ * at_handler returns true; a middleware that answers itself (e.g. 401 or
+ * 429) never reaches it.
+ */
+void dispatch(const crest_route_entry_t& route, crest_request_t* req, crest_response_t* res,
+              const std::function<bool()>& at_handler);
+
+/**
+ * @brief Answer {"error": message} with status unless a response was already sent
+ */
+void respond_with_error(crest_response_t* res, int status, const char* message);
+
+/**
+ * @brief Caching policy of a matched route, or nullptr
+ */
+inline const CachePolicy* cache_policy(const crest_route_entry_t& route) {
+    return route.cpp_handler ? static_cast<const RouteState*>(route.cpp_handler)->cache.get() : nullptr;
+}
+
+/**
+ * @brief Hand a sent response's after-send work to the background queue
+ *
+ * Work the queue cannot take is dropped with a warning: only its cleanup
+ * runs, and the queue counts it as rejected.
+ */
+void submit_deferred(crest_response_t* res);
+
+/**
+ * @brief Flush the process-wide background queue if it was ever used
+ */
+void flush_background();
+
+/**
+ * @brief Keep a served response's connection open after its handler returns
+ *
+ * Every successful hold needs one release_response(); the last release
+ * sends the response and frees the request. Returns false outside the
+ * server, for responses it did not create.
+ */
+bool hold_response(crest_response_t* res);
+void release_response(crest_response_t* res);
+
+/**
+ * @brief Run a task once a served response is finished, just before it is freed
+ *
+ * For middleware whose next() returned before the handler finished, e.g. a
+ * coroutine handler that suspended. delivered is false if the client never
+ * got this response (nothing was sent, or a deadline 504 went out instead).
+ * Returns false outside the server, where no exchange owns the response.
+ */
+bool when_released(crest_response_t* res, std::function<void(bool delivered)> task);
+
+/**
+ * @brief Run a task on the request pool serving a held response
+ *
+ * Runs it on the calling thread once the server has shut its pool down.
+ */
+void post_to_pool(crest_response_t* res, std::function<void()> task);
+
+/**
+ * @brief Run a short job after delay_ms on the shared async timer wheel's thread
+ */
+Timer run_after(int64_t delay_ms, std::function<void()> job);
+
+/**
+ * @brief Let a coroutine started during this dispatch resume on other threads
+ *
+ * Called once the middleware chain has unwound, so a resumed coroutine never
+ * races middleware still reading the response. Outside the server it runs
+ * the coroutine to completion on the calling thread instead.
+ */
+void settle_async();
+
+} // namespace internal
+} // namespace crest
+
+#endif /* CREST_PIPELINE_HPP */
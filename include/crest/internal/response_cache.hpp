@@ -0,0 +1,134 @@
+/**
+ * @file response_cache.hpp
+ * @brief Internal route micro-cache of serialized responses
+ */
+
+#ifndef CREST_RESPONSE_CACHE_HPP
+#define CREST_RESPONSE_CACHE_HPP
+
+#include "app_internal.h"
+#include "response_capture.hpp"
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace crest {
+namespace internal {
+
+/**
+ * @brief Sharded, memory-bounded store of ready-to-send HTTP responses
+ *
+ * Values are complete serialized responses held by shared_ptr, so a hit is
+ * one lookup and a send() of a buffer that eviction cannot free underneath
+ * it. Each shard keeps an LRU list and a TinyLFU frequency sketch: when a
+ * shard is over its byte budget, a new key is only admitted if it has been
+ * requested more often recently than the entry it would evict, which keeps
+ * one-off URLs from flushing popular ones.
+ *
+ * Entries are fresh until fresh_until, then stale until stale_until. The first
+ * lookup of a stale entry is told to refresh it; everyone else keeps getting
+ * the stale copy until the refresh is stored.
+ */
+class ResponseCache {
+public:
+    using Buffer = std::shared_ptr<const std::string>;
+
+    struct Options {
+        size_t max_bytes;
+        size_t shards;
+
+        Options() : max_bytes(64 * 1024 * 1024), shards(16) {}
+    };
+
+    struct Lookup {
+        Buffer buffer;
+        int status = 0;
+        bool stale = false;
+        bool refresh = false;
+    };
+
+    struct Stats {
+        uint64_t hits;
+        uint64_t stale_hits;
+        uint64_t misses;
+        uint64_t rejected;
+        uint64_t evictions;
+    };
+
+    explicit ResponseCache(const Options& opts = Options());
+    ~ResponseCache();
+
+    ResponseCache(const ResponseCache&) = delete;
+    ResponseCache& operator=(const ResponseCache&) = delete;
+
+    /**
+     * @brief Find a response; refresh is set for exactly one caller per stale period
+     */
+    Lookup get(const std::string& key, int64_t now_us);
+
+    /**
+     * @brief Store a response
+     * @return false if TinyLFU declined to admit it
+     */
+    bool put(const std::string& key, Buffer buffer, int status, int64_t fresh_until_us, int64_t stale_until_us);
+
+    /**
+     * @brief Let another caller retry a refresh that produced nothing storable
+     */
+    void abandon_refresh(const std::string& key);
+
+    void set_max_bytes(size_t max_bytes);
+    void clear();
+
+    size_t size() const;
+    size_t bytes() const;
+    Stats stats() const;
+
+private:
+    struct Shard;
+    Shard& shard_for(uint64_t hash) const;
+
+    Options options_;
+    std::atomic<size_t> shard_budget_;
+    std::unique_ptr<Shard[]> shards_;
+    mutable std::atomic<uint64_t> hits_, stale_hits_, misses_, rejected_, evictions_;
+};
+
+/**
+ * @brief Caching settings of one route
+ */
+struct CachePolicy {
+    ResponseCache* store;
+    int64_t ttl_us;
+    int64_t stale_us;
+    std::vector<std::string> query_keys;
+    std::vector<std::string> header_keys;
+    bool with_middleware = false;
+
+    /**
+     * @brief Method, path and the listed query/header values
+     */
+    std::string key_for(const crest_request_t* req) const;
+
+    /**
+     * @brief 200 responses that set no cookies, allow shared caching and only Vary on keyed headers
+     */
+    bool cacheable(const crest_response_t* res) const;
+
+    /**
+     * @brief Serialize a response without the headers set before the mark
+     *
+     * The mark is taken where the chain reaches the handler: headers from
+     * earlier middleware (rate-limit counters, CORS, ...) describe this
+     * request only, and every hit gets its own from the same middleware.
+     */
+    static std::string storable(const crest_response_t* res, const CapturedResponse::Mark& own);
+};
+
+} // namespace internal
+} // namespace crest
+
+#endif /* CREST_RESPONSE_CACHE_HPP */
@@ -0,0 +1,75 @@
+/**
+ * @file response_capture.hpp
+ * @brief Internal snapshot of a response for replaying to other requests
+ */
+
+#ifndef CREST_RESPONSE_CAPTURE_HPP
+#define CREST_RESPONSE_CAPTURE_HPP
+
+#include "app_internal.h"
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace crest {
+namespace internal {
+
+/**
+ * @brief What a chain added to a response after a mark, replayable onto another response
+ *
+ * Take a Mark before calling next(); afterwards capture() copies the status,
+ * body and the headers the rest of the chain set, leaving out anything that
+ * earlier middleware (CORS, rate-limit headers, ...) added for this request only.
+ */
+struct CapturedResponse {
+    struct Mark {
+        size_t headers;
+        size_t raw_headers;
+    };
+
+    int status = 0;
+    const char* content_type = nullptr;
+    std::string body;
+    std::vector<std::pair<std::string, std::string>> headers;
+    std::string raw_headers;
+
+    static Mark mark(const crest_response_t* res) {
+        return Mark{res->headers.count, res->raw_headers_length};
+    }
+
+    static CapturedResponse capture(const crest_response_t* res, const Mark& since) {
+        CapturedResponse out;
+        out.status = res->status;
+        out.content_type = res->content_type;
+        out.body.assign(res->body ? res->body : "", res->body_length);
+        for (size_t i = since.headers; i < res->headers.count; ++i) {
+            out.headers.emplace_back(res->headers.items[i].key, res->headers.items[i].value);
+        }
+        if (res->raw_headers_length > since.raw_headers) {
+            out.raw_headers.assign(res->raw_headers + since.raw_headers, res->raw_headers_length - since.raw_headers);
+        }
+        return out;
+    }
+
+    void replay(crest_response_t* res) const {
+        for (const auto& [name, value] : headers) {
+            crest_kv_set(&res->headers, name.c_str(), value.c_str());
+        }
+        crest_response_append_raw_headers(res, raw_headers.data(), raw_headers.size());
+        crest_response_set_body(res, body.data(), body.size());
+        res->status = status;
+        res->content_type = content_type;
+        res->sent = true;
+    }
+
+    size_t size() const {
+        size_t total = sizeof(*this) + body.size() + raw_headers.size();
+        for (const auto& [name, value] : headers) total += name.size() + value.size();
+        return total;
+    }
+};
+
+} // namespace internal
+} // namespace crest
+
+#endif /* CREST_RESPONSE_CAPTURE_HPP */
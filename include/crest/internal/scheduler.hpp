@@ -0,0 +1,123 @@
+/**
+ * @file scheduler.hpp
+ * @brief Internal timer wheel behind App::every() and App::after()
+ */
+
+#ifndef CREST_SCHEDULER_HPP
+#define CREST_SCHEDULER_HPP
+
+#include "../crest.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace crest {
+namespace internal {
+
+/**
+ * @brief One scheduled job, shared by the wheel, its runs and Timer handles
+ */
+struct TimerState {
+    std::function<void()> job;
+    int64_t delay_ticks = 0;
+    int64_t interval_ticks = 0;   // 0 for a one-shot timer
+    int64_t jitter_ticks = 0;
+    bool allow_overlap = false;
+
+    // Guarded by the scheduler mutex
+    int64_t base_tick = 0;        // Jitter-free schedule, advanced by interval_ticks
+    int64_t due_tick = 0;
+
+    std::atomic<bool> cancelled{false};
+    std::atomic<bool> finished{false};
+    std::atomic<bool> running{false};
+    std::atomic<uint64_t> runs{0};
+    std::atomic<uint64_t> skipped{0};
+};
+
+/**
+ * @brief Hashed timer wheel that hands due jobs to an executor
+ *
+ * A single thread advances the wheel one tick_ms slot at a time and only
+ * while timers are armed, so an idle scheduler costs nothing. A slot holds
+ * every timer whose due tick maps to it; timers due in a later revolution
+ * are re-filed when their slot comes round, and cancelled ones are dropped
+ * then. Due jobs are passed to the executor outside the lock, so a job may
+ * schedule or cancel timers itself.
+ *
+ * Timers scheduled before start() are armed by it, relative to that moment.
+ * stop() joins the thread and sets the timers that are still live aside
+ * for the next start(); runs already handed to the executor are its to finish.
+ */
+class Scheduler {
+public:
+    using Task = std::function<void()>;
+    using Executor = std::function<void(Task)>;
+
+    struct Options {
+        int tick_ms;
+        size_t slots;
+
+        Options() : tick_ms(10), slots(512) {}
+    };
+
+    explicit Scheduler(const Options& opts = Options());
+
+    /**
+     * @brief Stops the wheel thread if running
+     */
+    ~Scheduler();
+
+    Scheduler(const Scheduler&) = delete;
+    Scheduler& operator=(const Scheduler&) = delete;
+
+    /**
+     * @brief Add a timer
+     * @param delay_ms Time until the first run
+     * @param interval_ms Time between runs; 0 for a one-shot timer
+     */
+    Timer schedule(int delay_ms, int interval_ms, Task job, const TimerOptions& options);
+
+    /**
+     * @brief Arm pending timers and start ticking; ignored if already started
+     */
+    void start(Executor executor);
+
+    /**
+     * @brief Stop ticking; live timers wait for the next start()
+     */
+    void stop();
+
+    /**
+     * @brief Timers not yet cancelled or finished
+     */
+    size_t size() const;
+
+private:
+    void loop();
+    void arm(const std::shared_ptr<TimerState>& timer, int64_t now);
+    void advance(int64_t now, std::vector<std::shared_ptr<TimerState>>& due);
+    int64_t now_tick() const;
+
+    Options options_;
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<std::vector<std::shared_ptr<TimerState>>> wheel_;
+    std::vector<std::shared_ptr<TimerState>> pending_;
+    size_t armed_;
+    int64_t current_tick_;
+    bool stopping_;
+    Executor executor_;
+    std::thread thread_;
+};
+
+} // namespace internal
+} // namespace crest
+
+#endif /* CREST_SCHEDULER_HPP */
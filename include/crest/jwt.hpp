@@ -0,0 +1,160 @@
+/**
+ * @file jwt.hpp
+ * @brief JSON Web Token verification and verified-token caching
+ * @version 0.0.0
+ */
+
+#ifndef CREST_JWT_HPP
+#define CREST_JWT_HPP
+
+#include <string>
+#include <memory>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace crest {
+
+enum class JwtAlgorithm {
+    HS256,
+    RS256,
+    ES256
+};
+
+/**
+ * @brief Registered claims of a verified token plus the raw payload
+ */
+struct JwtClaims {
+    std::string subject;
+    std::string issuer;
+    std::string audience;
+    int64_t expires_at;
+    int64_t not_before;
+    int64_t issued_at;
+    std::string payload;
+
+    JwtClaims() : expires_at(0), not_before(0), issued_at(0) {}
+
+    /**
+     * @brief Top-level claim as text (strings unquoted, other values verbatim)
+     */
+    std::string claim(const std::string& name) const;
+};
+
+/**
+ * @brief Verifies compact JWS tokens against a rotating set of keys
+ *
+ * Keys are looked up by the token's "kid" header; tokens without one are
+ * tried against every key of their algorithm. Keys can be added and removed
+ * while requests are being verified. HS256 is always available; RS256 and
+ * ES256 need Crest built with OpenSSL (`xmake f --openssl=y`).
+ */
+class JwtVerifier {
+public:
+    struct Options {
+        std::string issuer;
+        std::string audience;
+        int leeway_seconds;
+        bool require_exp;
+
+        Options() : issuer(), audience(), leeway_seconds(30), require_exp(true) {}
+    };
+
+    explicit JwtVerifier(const Options& opts = Options());
+    ~JwtVerifier();
+
+    JwtVerifier(const JwtVerifier&) = delete;
+    JwtVerifier& operator=(const JwtVerifier&) = delete;
+
+    static bool supports(JwtAlgorithm algorithm);
+
+    /**
+     * @brief Add or replace an HS256 shared secret
+     */
+    void add_hmac_key(const std::string& kid, const std::string& secret);
+
+    /**
+     * @brief Add or replace an RS256/ES256 public key
+     * @param pem PEM-encoded public key ("-----BEGIN PUBLIC KEY-----")
+     * @throws Exception if the algorithm is unsupported or the key does not parse
+     */
+    void add_public_key(const std::string& kid, JwtAlgorithm algorithm, const std::string& pem);
+
+    /**
+     * @brief Retire a key; cached verifications made with older key sets are dropped
+     */
+    void remove_key(const std::string& kid);
+
+    /**
+     * @brief Check signature, exp/nbf, iss and aud
+     * @param token Compact JWS ("header.payload.signature")
+     * @param claims Filled on success when not null
+     * @param error Reason on failure when not null
+     */
+    bool verify(const std::string& token, JwtClaims* claims = nullptr, std::string* error = nullptr) const;
+
+    /**
+     * @brief Changes whenever the key set changes
+     */
+    uint64_t generation() const { return generation_.load(std::memory_order_acquire); }
+
+private:
+    struct Key;
+
+    Options options_;
+    std::map<std::string, std::shared_ptr<const Key>> keys_;
+    mutable std::shared_mutex keys_mutex_;
+    std::atomic<uint64_t> generation_;
+};
+
+/**
+ * @brief Bounded cache of already-verified tokens
+ *
+ * Entries are keyed by the full token text, hashed to one of several
+ * independently locked shards, and expire at the earlier of the token's exp
+ * and the cache TTL. Each shard evicts its least recently used entry when full.
+ */
+class TokenCache {
+public:
+    struct Options {
+        size_t capacity;
+        size_t shards;
+        int ttl_seconds;
+
+        Options() : capacity(10000), shards(16), ttl_seconds(300) {}
+    };
+
+    explicit TokenCache(const Options& opts = Options());
+    ~TokenCache();
+
+    TokenCache(const TokenCache&) = delete;
+    TokenCache& operator=(const TokenCache&) = delete;
+
+    /**
+     * @brief Whether the token was verified under this key generation and has not expired
+     */
+    bool contains(const std::string& token, uint64_t generation, int64_t now) const;
+
+    /**
+     * @param expires_at Token exp (0 when the token has none)
+     */
+    void insert(const std::string& token, uint64_t generation, int64_t expires_at, int64_t now);
+
+    void clear();
+    size_t size() const;
+
+private:
+    struct Shard;
+    Shard& shard_for(const std::string& token) const;
+
+    Options options_;
+    std::unique_ptr<Shard[]> shards_;
+    size_t shard_capacity_;
+};
+
+} // namespace crest
+
+#endif /* CREST_JWT_HPP */
@@ -8,6 +8,9 @@
 #define CREST_MIDDLEWARE_HPP
 
 #include "crest.hpp"
+#include "compression.hpp"
+#include "rate_limit.hpp"
+#include "jwt.hpp"
 #include <functional>
 #include <vector>
 #include <string>
@@ -15,18 +18,10 @@
 #include <mutex>
 #include <map>
 #include <ctime>
+#include <tuple>
 
 namespace crest {
 
-using NextFunction = std::function<void()>;
-using MiddlewareFunction = std::function<void(Request&, Response&, NextFunction)>;
-
-class Middleware {
-public:
-    virtual ~Middleware() = default;
-    virtual void handle(Request& req, Response& res, NextFunction next) = 0;
-};
-
 class CorsMiddleware : public Middleware {
 public:
     struct Options {
@@ -40,12 +35,39 @@ public:
         Options() : allowed_origins({"*"}), allowed_methods({"GET", "POST", "PUT", "DELETE", "PATCH", "OPTIONS"}), allowed_headers({"*"}), exposed_headers({}), allow_credentials(false), max_age(86400) {}
     };
 
-    explicit CorsMiddleware(const Options& opts = Options()) : options_(opts) {}
+    explicit CorsMiddleware(const Options& opts = Options());
     
     void handle(Request& req, Response& res, NextFunction next) override;
 
+    /**
+     * @brief Serialize the complete response to an OPTIONS preflight
+     *
+     * Used by the server loop to answer preflights for globally registered
+     * CORS before routing. Disallowed origins get a bare 204.
+     *
+     * @param origin Origin request header (may be null)
+     * @param request_headers Access-Control-Request-Headers (may be null)
+     * @param out Receives the raw HTTP response
+     */
+    void preflight(const char* origin, const char* request_headers, std::string& out) const;
+
+    /**
+     * @brief OPTIONS request carrying Access-Control-Request-Method
+     */
+    static bool is_preflight(const crest_request_t* req);
+
 private:
+    bool origin_allowed(const char* origin) const;
+    void append_origin(std::string& out, const char* origin) const;
+    void preflight_headers(const char* origin, const char* request_headers, std::string& out) const;
+
     Options options_;
+    bool any_origin_;
+    std::vector<std::string> origins_;
+    std::string actual_block_;
+    std::string public_block_;
+    std::string preflight_block_;
+    std::string preflight_response_;
 };
 
 class RateLimitMiddleware : public Middleware {
@@ -53,31 +75,76 @@ public:
     struct Options {
         int max_requests;
         int window_seconds;
+        int burst;
+        size_t capacity;
+        bool trust_proxy;
+        std::string shared_memory_name;
         std::string message;
         
-        Options() : max_requests(100), window_seconds(60), message("Too many requests") {}
+        Options() : max_requests(100), window_seconds(60), burst(0), capacity(65536), trust_proxy(false), shared_memory_name(), message("Too many requests") {}
     };
 
-    explicit RateLimitMiddleware(const Options& opts = Options()) : options_(opts) {}
+    explicit RateLimitMiddleware(const Options& opts = Options());
     
     void handle(Request& req, Response& res, NextFunction next) override;
 
+    /**
+     * @brief Key a request is counted under
+     *
+     * The peer address by default. With trust_proxy, the address the nearest
+     * proxy reported in X-Forwarded-For (or X-Real-IP) is used instead.
+     */
+    std::string client_key(Request& req) const;
+
 private:
     Options options_;
-    std::map<std::string, std::pair<int, time_t>> request_counts_;
-    std::mutex mutex_;
+    RateLimiter limiter_;
 };
 
 class AuthMiddleware : public Middleware {
 public:
     using ValidatorFunction = std::function<bool(const std::string&)>;
 
-    explicit AuthMiddleware(ValidatorFunction validator) : validator_(validator) {}
+    struct Options {
+        bool cache;
+        size_t cache_capacity;
+        int cache_ttl_seconds;
+        
+        Options() : cache(false), cache_capacity(10000), cache_ttl_seconds(60) {}
+    };
+
+    /**
+     * @brief Defaults for JWTs: caching on, since exp bounds every entry
+     */
+    static Options jwt_options() {
+        Options opts;
+        opts.cache = true;
+        return opts;
+    }
+
+    /**
+     * @brief Accept tokens the validator approves
+     *
+     * With Options::cache, approvals are reused for cache_ttl_seconds. Nothing
+     * bounds them otherwise, so a revoked token stays accepted until its entry
+     * expires; caching is therefore off unless enabled.
+     */
+    explicit AuthMiddleware(ValidatorFunction validator, const Options& opts = Options());
+    
+    /**
+     * @brief Accept valid JWTs; verifications are cached until the earlier of exp and the TTL
+     */
+    explicit AuthMiddleware(std::shared_ptr<JwtVerifier> verifier, const Options& opts = jwt_options());
     
     void handle(Request& req, Response& res, NextFunction next) override;
 
 private:
+    bool validate(const std::string& token);
+
+    Options options_;
     ValidatorFunction validator_;
+    std::shared_ptr<JwtVerifier> verifier_;
+    std::unique_ptr<TokenCache> cache_;
 };
 
 class LoggingMiddleware : public Middleware {
@@ -85,9 +152,209 @@ public:
     void handle(Request& req, Response& res, NextFunction next) override;
 };
 
+/**
+ * @brief Conditional GET: tags 200 responses and answers If-None-Match with 304
+ *
+ * Responses that already carry an ETag keep it; otherwise the finished body
+ * is hashed. Handlers with a cheap version number should call not_modified()
+ * first so an unchanged resource is never rendered.
+ */
+class EtagMiddleware : public Middleware {
+public:
+    struct Options {
+        bool weak;
+        
+        Options() : weak(false) {}
+    };
+
+    explicit EtagMiddleware(const Options& opts = Options()) : options_(opts) {}
+    
+    void handle(Request& req, Response& res, NextFunction next) override;
+
+private:
+    Options options_;
+};
+
+/**
+ * @brief Collapses concurrent identical GETs into one handler execution
+ *
+ * Register it on the routes that need it. The first request for a key runs
+ * the rest of the chain; requests with the same key that arrive meanwhile
+ * wait and receive a copy of that response. Responses with status >= 500
+ * are not shared: waiters run the handler themselves. Waiters give up with
+ * 504 after timeout_ms.
+ */
+class CoalesceMiddleware : public Middleware {
+public:
+    struct Options {
+        std::vector<std::string> query_keys;
+        std::vector<std::string> header_keys;
+        int timeout_ms;
+        
+        Options() : query_keys(), header_keys(), timeout_ms(5000) {}
+    };
+
+    explicit CoalesceMiddleware(const Options& opts = Options());
+    ~CoalesceMiddleware();
+    
+    void handle(Request& req, Response& res, NextFunction next) override;
+
+    /**
+     * @brief Number of keys with a handler currently running
+     */
+    size_t in_flight() const;
+
+private:
+    struct Flight;
+    std::string key_for(const crest_request_t* req) const;
+
+    Options options_;
+    std::map<std::string, std::shared_ptr<Flight>> flights_;
+    mutable std::mutex mutex_;
+};
+
+/**
+ * @brief Answers retried POST/PUT/PATCH/DELETE requests from the first execution's response
+ *
+ * Requests carrying an Idempotency-Key header run the rest of the chain once;
+ * the response is stored and replayed, with "Idempotent-Replayed: true", to
+ * any later request with the same key for ttl_seconds. A duplicate arriving
+ * while the first is still running waits for it (409 after wait_timeout_ms).
+ * Reusing a key for a different method, path, query string or body is answered with 422.
+ * Responses with status >= 500 are not stored so the client can retry.
+ *
+ * Entries live in independently locked shards that evict their least
+ * recently used completed entry beyond capacity. header_keys (e.g.
+ * "Authorization") scope keys so different clients cannot collide.
+ */
+class IdempotencyMiddleware : public Middleware {
+public:
+    struct Options {
+        std::string header;
+        std::vector<std::string> header_keys;
+        int ttl_seconds;
+        size_t capacity;
+        size_t shards;
+        int wait_timeout_ms;
+        
+        Options() : header("Idempotency-Key"), header_keys(), ttl_seconds(86400), capacity(10000),
+                    shards(16), wait_timeout_ms(30000) {}
+    };
+
+    explicit IdempotencyMiddleware(const Options& opts = Options());
+    ~IdempotencyMiddleware();
+    
+    void handle(Request& req, Response& res, NextFunction next) override;
+
+    /**
+     * @brief Number of stored and in-progress keys
+     */
+    size_t size() const;
+
+private:
+    struct Entry;
+    struct Shard;
+    Shard& shard_for(const std::string& key) const;
+
+    Options options_;
+    std::unique_ptr<Shard[]> shards_;
+    size_t shard_capacity_;
+};
+
+/**
+ * @brief Whether an If-None-Match header matches an entity tag (weak comparison)
+ */
+bool etag_matches(const std::string& if_none_match, const std::string& etag);
+
+/**
+ * @brief Set the ETag from a handler-supplied version and send 304 if the client is current
+ *
+ * @code
+ * app.get("/users", [&](crest::Request& req, crest::Response& res) {
+ *     if (crest::not_modified(req, res, std::to_string(users_version))) return;
+ *     res.json(200, render_users());
+ * });
+ * @endcode
+ *
+ * @return true when a 304 was sent and the handler should return
+ */
+bool not_modified(Request& req, Response& res, const std::string& version);
+
 class CompressionMiddleware : public Middleware {
 public:
+    struct Options {
+        size_t min_size;
+        int level;
+        std::vector<std::string> content_types;
+        bool precompress;
+        size_t max_variant_bytes;
+        size_t max_variant_entries;     // Distinct method/path/query keys kept; least recently used go first
+        size_t max_pending_builds;      // Variant builds queued at once; new ones are skipped beyond this
+        
+        Options() : min_size(1024), level(6), content_types({"text/", "application/json", "application/javascript", "application/xml", "image/svg+xml"}), precompress(false), max_variant_bytes(64 * 1024 * 1024), max_variant_entries(1024), max_pending_builds(16) {}
+    };
+
+    explicit CompressionMiddleware(const Options& opts = Options());
+    ~CompressionMiddleware() override;
+    
     void handle(Request& req, Response& res, NextFunction next) override;
+    
+    /**
+     * @brief Block until queued variant builds have finished (mainly for tests)
+     */
+    void wait_for_variants();
+    
+    /**
+     * @brief Number of keys with stored or queued variants
+     */
+    size_t variant_count() const;
+
+private:
+    struct VariantStore;
+    
+    bool is_compressible(const char* content_type) const;
+    bool serve_variant(Request& req, crest_response_t* raw, Encoding encoding);
+    
+    Options options_;
+    std::unique_ptr<VariantStore> variants_;
+};
+
+/**
+ * @brief Compile-time composition of middleware into a single stage
+ *
+ * Stages are held by value and invoked directly, so the whole chain can be
+ * inlined and registered with App::use() as one middleware:
+ *
+ *     app.use(std::make_shared<crest::MiddlewareChain<crest::CorsMiddleware,
+ *                                                     crest::LoggingMiddleware>>());
+ */
+template <typename... Ms>
+class MiddlewareChain final : public Middleware {
+public:
+    MiddlewareChain() = default;
+    
+    template <typename... Args, typename = std::enable_if_t<sizeof...(Args) == sizeof...(Ms)>>
+    explicit MiddlewareChain(Args&&... args) : stages_(std::forward<Args>(args)...) {}
+    
+    void handle(Request& req, Response& res, NextFunction next) override {
+        step<0>(req, res, next);
+    }
+    
+    template <size_t I>
+    auto& get() { return std::get<I>(stages_); }
+
+private:
+    template <size_t I>
+    void step(Request& req, Response& res, NextFunction& next) {
+        if constexpr (I == sizeof...(Ms)) {
+            next();
+        } else {
+            auto cont = [&] { step<I + 1>(req, res, next); };
+            std::get<I>(stages_).handle(req, res, cont);
+        }
+    }
+    
+    std::tuple<Ms...> stages_;
 };
 
 } // namespace crest
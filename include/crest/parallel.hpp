@@ -0,0 +1,162 @@
+/**
+ * @file parallel.hpp
+ * @brief Data-parallel loops, reductions and sorts for CPU-heavy handlers
+ * @version 0.0.0
+ */
+
+#ifndef CREST_PARALLEL_HPP
+#define CREST_PARALLEL_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace crest {
+
+namespace internal {
+
+/**
+ * @brief Run chunk(0) .. chunk(count - 1) on the compute pool and wait for them
+ *
+ * The calling thread runs chunks itself while it waits, so nested calls
+ * from inside a chunk make progress even when every pool thread is busy.
+ * After a chunk throws, chunks not yet started are skipped and the first
+ * exception is rethrown here.
+ */
+void run_chunks(size_t count, const std::function<void(size_t)>& chunk);
+
+/**
+ * @brief Threads that work on a call: the compute pool plus the caller
+ */
+size_t parallel_width();
+
+// Number of grain-sized chunks for n items; an automatic grain gives each
+// participating thread a few chunks so stealing can even out uneven work
+inline size_t chunk_count(size_t n, size_t grain) {
+    if (n == 0) return 0;
+    if (grain == 0) return std::min(n, parallel_width() * 4);
+    return (n + grain - 1) / grain;
+}
+
+// Bounds of chunk i when n items are split into count chunks
+inline size_t chunk_begin(size_t n, size_t count, size_t i) {
+    return n / count * i + std::min(i, n % count);
+}
+
+} // namespace internal
+
+/**
+ * @brief Call body(i) for every i in [begin, end), spread over the compute pool
+ *
+ * Runs on a shared work-stealing pool sized to the machine rather than on
+ * threads of its own, so concurrent requests that split work do not
+ * oversubscribe the CPU. The calling request thread works too and returns
+ * once every index is done.
+ *
+ * @param grain Indices per chunk; 0 picks one from the pool size
+ * @throws whatever body throws first (the remaining chunks are skipped)
+ *
+ * @code
+ * crest::parallel_for(0, images.size(), [&](size_t i) { thumbnails[i] = scale(images[i]); });
+ * @endcode
+ */
+template <typename F>
+void parallel_for(size_t begin, size_t end, F&& body, size_t grain = 0) {
+    size_t n = end > begin ? end - begin : 0;
+    size_t count = internal::chunk_count(n, grain);
+    if (count <= 1) {
+        for (size_t i = begin; i < end; ++i) body(i);
+        return;
+    }
+    internal::run_chunks(count, [&](size_t c) {
+        size_t last = begin + internal::chunk_begin(n, count, c + 1);
+        for (size_t i = begin + internal::chunk_begin(n, count, c); i < last; ++i) body(i);
+    });
+}
+
+/**
+ * @brief Combine transform(x) for every x in [first, last) with op, in parallel
+ *
+ * op must be associative; chunk results are combined in order, so it need
+ * not be commutative.
+ *
+ * @code
+ * double total = crest::parallel_reduce(orders.begin(), orders.end(), 0.0, std::plus<>(),
+ *                                       [](const Order& o) { return o.amount; });
+ * @endcode
+ */
+template <typename It, typename T, typename Op, typename Transform>
+T parallel_reduce(It first, It last, T init, Op op, Transform transform, size_t grain = 0) {
+    size_t n = (size_t)std::distance(first, last);
+    size_t count = internal::chunk_count(n, grain);
+    if (count <= 1) {
+        for (; first != last; ++first) init = op(std::move(init), transform(*first));
+        return init;
+    }
+
+    std::vector<std::optional<T>> partial(count);
+    internal::run_chunks(count, [&](size_t c) {
+        It it = first + (std::ptrdiff_t)internal::chunk_begin(n, count, c);
+        It end = first + (std::ptrdiff_t)internal::chunk_begin(n, count, c + 1);
+        T acc = transform(*it);
+        for (++it; it != end; ++it) acc = op(std::move(acc), transform(*it));
+        partial[c].emplace(std::move(acc));
+    });
+    for (auto& value : partial) init = op(std::move(init), std::move(*value));
+    return init;
+}
+
+/**
+ * @brief Combine every element of [first, last) with op, in parallel
+ */
+template <typename It, typename T, typename Op = std::plus<>>
+T parallel_reduce(It first, It last, T init, Op op = Op()) {
+    return parallel_reduce(first, last, std::move(init), op, [](const auto& x) -> const auto& { return x; });
+}
+
+/**
+ * @brief Sort [first, last) in parallel; not stable
+ *
+ * Sorts one block per participating thread, then merges the blocks
+ * pairwise. Small ranges are sorted on the calling thread.
+ */
+template <typename It, typename Compare = std::less<>>
+void parallel_sort(It first, It last, Compare comp = Compare()) {
+    const size_t min_block = 4096;
+    size_t n = (size_t)std::distance(first, last);
+    size_t blocks = std::min(internal::parallel_width(), n / min_block);
+    if (blocks <= 1) {
+        std::sort(first, last, comp);
+        return;
+    }
+
+    auto at = [&](size_t block) { return first + (std::ptrdiff_t)internal::chunk_begin(n, blocks, block); };
+    internal::run_chunks(blocks, [&](size_t b) { std::sort(at(b), at(b + 1), comp); });
+    for (size_t width = 1; width < blocks; width *= 2) {
+        size_t pairs = (blocks + 2 * width - 1) / (2 * width);
+        internal::run_chunks(pairs, [&](size_t p) {
+            size_t left = p * 2 * width;
+            size_t mid = std::min(left + width, blocks);
+            size_t right = std::min(left + 2 * width, blocks);
+            if (mid < right) std::inplace_merge(at(left), at(mid), at(right), comp);
+        });
+    }
+}
+
+/**
+ * @brief Set the compute pool's thread count
+ *
+ * The default leaves one hardware thread for the caller. With 0 threads
+ * every call runs on the calling thread.
+ *
+ * @return false if the pool was already created (the value is then ignored)
+ */
+bool configure_parallel(size_t threads);
+
+} // namespace crest
+
+#endif /* CREST_PARALLEL_HPP */
@@ -0,0 +1,106 @@
+/**
+ * @file rate_limit.hpp
+ * @brief Lock-free GCRA rate limiter for Crest framework
+ * @version 0.0.0
+ */
+
+#ifndef CREST_RATE_LIMIT_HPP
+#define CREST_RATE_LIMIT_HPP
+
+#include <string>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+namespace crest {
+
+/**
+ * @brief Per-key rate limiter using the generic cell rate algorithm (GCRA)
+ *
+ * Each key costs one 16-byte slot holding its theoretical arrival time.
+ * Slots live in a fixed-size table of 64-byte, 4-way buckets and are updated
+ * with compare-and-swap, so concurrent requests never take a lock and memory
+ * never grows past capacity. A key whose arrival time has passed carries no
+ * state and its slot is reused first; when a bucket is full of live keys the
+ * one closest to fully replenished is evicted.
+ *
+ * With shared_memory_name set (e.g. "/myapp-ratelimit"), the table lives in a
+ * POSIX shared-memory object instead, so every process on the host that opens
+ * the same name enforces one combined limit. All of them must use the same
+ * limits and capacity; a mismatch throws crest::Exception.
+ */
+class RateLimiter {
+public:
+    struct Options {
+        int max_requests;
+        int window_seconds;
+        int burst;
+        size_t capacity;
+        std::string shared_memory_name;
+
+        Options() : max_requests(100), window_seconds(60), burst(0), capacity(65536), shared_memory_name() {}
+    };
+
+    struct Result {
+        bool allowed;
+        int limit;
+        int remaining;
+        int64_t reset_us;
+        int64_t retry_after_us;
+    };
+
+    /**
+     * @param opts max_requests per window_seconds; burst defaults to max_requests;
+     *             capacity is the number of keys tracked at once; a non-empty
+     *             shared_memory_name maps the table from shared memory
+     * @throws Exception if the shared-memory table cannot be opened or mismatches
+     */
+    explicit RateLimiter(const Options& opts = Options());
+    ~RateLimiter();
+
+    RateLimiter(const RateLimiter&) = delete;
+    RateLimiter& operator=(const RateLimiter&) = delete;
+
+    /**
+     * @brief Count one request for a key
+     */
+    Result acquire(const std::string& key);
+
+    /**
+     * @brief Count one request for a key at an explicit steady-clock time
+     * @param key Client key
+     * @param now_us Microseconds on a monotonic clock
+     */
+    Result acquire(const std::string& key, int64_t now_us);
+
+    /**
+     * @brief Number of keys that currently hold state (O(capacity))
+     */
+    size_t size() const;
+
+    /**
+     * @brief Number of slots in the table
+     */
+    size_t capacity() const;
+
+    /**
+     * @brief Whether the table is in shared memory
+     */
+    bool shared() const;
+
+    /**
+     * @brief Unlink a shared-memory table; processes that have it mapped keep using it
+     */
+    static bool remove_shared(const std::string& name);
+
+private:
+    struct Table;
+    std::unique_ptr<Table> table_;
+    int64_t interval_us_;
+    int64_t span_us_;
+    int limit_;
+};
+
+} // namespace crest
+
+#endif /* CREST_RATE_LIMIT_HPP */
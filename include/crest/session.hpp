@@ -0,0 +1,180 @@
+/**
+ * @file session.hpp
+ * @brief Signed cookies and an in-process session store
+ * @version 0.0.0
+ */
+
+#ifndef CREST_SESSION_HPP
+#define CREST_SESSION_HPP
+
+#include "crest.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+
+namespace crest {
+
+/**
+ * @brief Tamper-evident cookie values: "value.signature" with HMAC-SHA256
+ *
+ * The HMAC inner and outer pad blocks are hashed once at construction and
+ * their SHA-256 state is copied per call, so signing a typical cookie costs
+ * two compression rounds instead of four.
+ */
+class CookieSigner {
+public:
+    /**
+     * @throws Exception if secret is empty
+     */
+    explicit CookieSigner(const std::string& secret);
+    ~CookieSigner();
+
+    CookieSigner(const CookieSigner&) = delete;
+    CookieSigner& operator=(const CookieSigner&) = delete;
+
+    /**
+     * @brief value + "." + base64url(HMAC-SHA256(secret, value))
+     */
+    std::string sign(const std::string& value) const;
+
+    /**
+     * @brief Check the signature and strip it
+     * @return false if the signature is missing or does not match (value is left unchanged)
+     */
+    bool unsign(const std::string& signed_value, std::string& value) const;
+
+private:
+    struct Keys;
+    std::unique_ptr<Keys> keys_;
+};
+
+/**
+ * @brief Sessions kept in process memory, identified by a signed cookie
+ *
+ * Sessions are spread over independently locked shards, so a lookup is one
+ * signature check and one hash probe. Each shard files its sessions in a
+ * timer wheel of tick_ms slots: whenever a shard is touched it advances the
+ * wheel to the current tick and drops the sessions filed there that have
+ * expired. Expiry therefore needs no background thread and costs time
+ * proportional to the sessions that actually expire. With sliding enabled,
+ * reading a session pushes its expiry out by ttl_seconds again.
+ *
+ * Sessions live in this process only: behind a load balancer, route clients
+ * to the same instance or keep using a shared store.
+ *
+ * @code
+ * crest::SessionStore::Options opts;
+ * opts.secret = std::getenv("SESSION_SECRET");
+ * crest::SessionStore sessions(opts);
+ *
+ * app.post("/login", [&](crest::Request& req, crest::Response& res) {
+ *     sessions.start(res, {{"user", "42"}});
+ *     res.json(200, "{}");
+ * });
+ * app.get("/me", [&](crest::Request& req, crest::Response& res) {
+ *     crest::SessionStore::Data session;
+ *     if (!sessions.load(req, session)) return res.json(401, "{}");
+ *     res.json(200, "{\"user\":\"" + session["user"] + "\"}");
+ * });
+ * @endcode
+ */
+class SessionStore {
+public:
+    using Data = std::map<std::string, std::string>;
+
+    struct Options {
+        std::string secret;
+        std::string cookie_name;
+        CookieOptions cookie;
+        int ttl_seconds;
+        bool sliding;
+        size_t shards;
+        int tick_ms;
+        size_t wheel_slots;
+
+        Options()
+            : secret(), cookie_name("sid"), cookie(), ttl_seconds(1800), sliding(true),
+              shards(16), tick_ms(1000), wheel_slots(1024) {}
+    };
+
+    /**
+     * @throws Exception if opts.secret is empty
+     */
+    explicit SessionStore(const Options& opts);
+    ~SessionStore();
+
+    SessionStore(const SessionStore&) = delete;
+    SessionStore& operator=(const SessionStore&) = delete;
+
+    /**
+     * @brief Store a new session under a random 128-bit id
+     * @return The session id (unsigned)
+     */
+    std::string create(Data data = Data());
+
+    /**
+     * @brief Copy of a live session's data
+     * @return false if the id is unknown or expired
+     */
+    bool get(const std::string& id, Data& out);
+
+    /**
+     * @brief Replace a live session's data
+     */
+    bool set(const std::string& id, Data data);
+
+    /**
+     * @brief Change a live session's data in place under its shard lock
+     */
+    bool update(const std::string& id, const std::function<void(Data&)>& fn);
+
+    bool destroy(const std::string& id);
+
+    /**
+     * @brief Advance every shard's wheel now instead of on its next use
+     * @return Number of sessions expired
+     */
+    size_t sweep();
+
+    size_t size() const;
+
+    /**
+     * @brief Verified session id from the request's cookie, or "" if absent or forged
+     */
+    std::string session_id(const Request& req) const;
+
+    /**
+     * @brief Data of the session named by the request's cookie
+     * @param id Receives the session id when found
+     */
+    bool load(const Request& req, Data& out, std::string* id = nullptr);
+
+    /**
+     * @brief Create a session and send its signed cookie
+     * @return The session id
+     */
+    std::string start(Response& res, Data data = Data());
+
+    /**
+     * @brief Destroy the request's session and delete its cookie
+     */
+    void end(const Request& req, Response& res);
+
+private:
+    struct Shard;
+    Shard& shard_for(const std::string& id) const;
+    int64_t now_tick() const;
+    size_t advance(Shard& shard, int64_t now);
+
+    Options options_;
+    CookieSigner signer_;
+    int64_t ttl_ticks_;
+    std::unique_ptr<Shard[]> shards_;
+};
+
+} // namespace crest
+
+#endif /* CREST_SESSION_HPP */
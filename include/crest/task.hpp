@@ -0,0 +1,321 @@
+/**
+ * @file task.hpp
+ * @brief Coroutine handlers: crest::Task and the awaitables they can suspend on
+ * @version 0.0.0
+ */
+
+#ifndef CREST_TASK_HPP
+#define CREST_TASK_HPP
+
+#include "background.hpp"
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace crest {
+
+namespace internal {
+
+class AsyncContext;
+
+/**
+ * @brief Resumes a suspended coroutine route on the request pool
+ *
+ * Taken in await_suspend on the thread running the route; may then be
+ * invoked once from any thread.
+ */
+class Resumer {
+public:
+    /**
+     * @throws Exception if no coroutine route is running on this thread
+     */
+    static Resumer current(std::coroutine_handle<> handle);
+
+    void operator()() const;
+
+private:
+    Resumer(std::shared_ptr<AsyncContext> context, std::coroutine_handle<> handle)
+        : context_(std::move(context)), handle_(handle) {}
+
+    std::shared_ptr<AsyncContext> context_;
+    std::coroutine_handle<> handle_;
+};
+
+/**
+ * @brief Invoke resume after delay_ms on the async timer wheel
+ */
+void resume_after(Resumer resume, int64_t delay_ms);
+
+/**
+ * @brief Run a job on the blocking-call pool
+ * @return false if the pool is full (the job is not run)
+ */
+bool submit_blocking(std::function<void()> job);
+
+template <typename T>
+struct TaskResult {
+    std::optional<T> value;
+    template <typename U>
+    void return_value(U&& v) { value.emplace(std::forward<U>(v)); }
+    T take() { return std::move(*value); }
+};
+
+template <>
+struct TaskResult<void> {
+    void return_void() {}
+    void take() {}
+};
+
+} // namespace internal
+
+/**
+ * @brief Lazily started coroutine returning T
+ *
+ * A route handler returning Task<void> may co_await other tasks and the
+ * awaitables below. While it is suspended its worker thread serves other
+ * requests; it resumes on the request pool once the awaited operation is done.
+ *
+ * @code
+ * app.get("/report", [](crest::Request& req, crest::Response& res) -> crest::Task<void> {
+ *     co_await crest::sleep_for(std::chrono::milliseconds(50));
+ *     std::string rows = co_await crest::run_blocking([] { return db_query(); });
+ *     res.json(200, rows);
+ * });
+ * @endcode
+ */
+template <typename T = void>
+class Task {
+public:
+    struct promise_type : internal::TaskResult<T> {
+        std::coroutine_handle<> continuation;
+        std::exception_ptr error;
+
+        Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+
+        struct FinalAwaiter {
+            bool await_ready() noexcept { return false; }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+                std::coroutine_handle<> next = handle.promise().continuation;
+                return next ? next : std::noop_coroutine();
+            }
+            void await_resume() noexcept {}
+        };
+        FinalAwaiter final_suspend() noexcept { return {}; }
+
+        void unhandled_exception() { error = std::current_exception(); }
+    };
+
+    Task() = default;
+    Task(Task&& other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            if (handle_) handle_.destroy();
+            handle_ = std::exchange(other.handle_, nullptr);
+        }
+        return *this;
+    }
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+    ~Task() {
+        if (handle_) handle_.destroy();
+    }
+
+    bool await_ready() const noexcept { return !handle_; }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        handle_.promise().continuation = awaiting;
+        return handle_;
+    }
+
+    T await_resume() {
+        if (handle_.promise().error) std::rethrow_exception(handle_.promise().error);
+        return handle_.promise().take();
+    }
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+
+    std::coroutine_handle<promise_type> handle_;
+};
+
+/**
+ * @brief Awaitable that suspends for a duration on the async timer wheel (10ms resolution)
+ */
+class SleepAwaiter {
+public:
+    explicit SleepAwaiter(int64_t delay_ms) : delay_ms_(delay_ms) {}
+
+    bool await_ready() const noexcept { return delay_ms_ <= 0; }
+    void await_suspend(std::coroutine_handle<> handle) {
+        internal::resume_after(internal::Resumer::current(handle), delay_ms_);
+    }
+    void await_resume() const noexcept {}
+
+private:
+    int64_t delay_ms_;
+};
+
+template <typename Rep, typename Period>
+SleepAwaiter sleep_for(std::chrono::duration<Rep, Period> duration) {
+    return SleepAwaiter(std::chrono::ceil<std::chrono::milliseconds>(duration).count());
+}
+
+/**
+ * @brief Awaitable that runs a blocking call on the blocking-call pool
+ *
+ * Use it for database drivers, outbound HTTP clients and other APIs that
+ * block: the call occupies a blocking-pool thread while the request's worker
+ * is free. If the blocking pool is full the call runs inline instead.
+ */
+template <typename F>
+class BlockingAwaiter {
+public:
+    using Result = std::invoke_result_t<F&>;
+
+    explicit BlockingAwaiter(F fn) : fn_(std::move(fn)) {}
+
+    bool await_ready() const noexcept { return false; }
+
+    bool await_suspend(std::coroutine_handle<> handle) {
+        internal::Resumer resume = internal::Resumer::current(handle);
+        if (internal::submit_blocking([this, resume] { invoke(); resume(); })) return true;
+        invoke();
+        return false;
+    }
+
+    Result await_resume() {
+        if (error_) std::rethrow_exception(error_);
+        if constexpr (!std::is_void_v<Result>) return std::move(*result_);
+    }
+
+private:
+    void invoke() {
+        try {
+            if constexpr (std::is_void_v<Result>) {
+                fn_();
+            } else {
+                result_.emplace(fn_());
+            }
+        } catch (...) {
+            error_ = std::current_exception();
+        }
+    }
+
+    F fn_;
+    std::conditional_t<std::is_void_v<Result>, bool, std::optional<Result>> result_{};
+    std::exception_ptr error_;
+};
+
+template <typename F>
+BlockingAwaiter<std::decay_t<F>> run_blocking(F&& fn) {
+    return BlockingAwaiter<std::decay_t<F>>(std::forward<F>(fn));
+}
+
+/**
+ * @brief Configure the blocking-call pool (default 16 threads, 10000 queued calls)
+ * @return false if it was already created (the options are then ignored)
+ */
+bool configure_blocking(const BackgroundQueue::Options& opts);
+
+/**
+ * @brief One-shot result that any thread can deliver to an awaiting coroutine
+ *
+ * Bridges callback APIs and external event loops: hand a copy to the
+ * callback, resolve() it there and co_await it in the handler. Only the
+ * first resolve() or fail() counts.
+ *
+ * @code
+ * crest::Completion<std::string> reply;
+ * http_client.get_async(url, [reply](std::string body) mutable { reply.resolve(std::move(body)); });
+ * std::string body = co_await reply;
+ * @endcode
+ */
+template <typename T = void>
+class Completion {
+    using Stored = std::conditional_t<std::is_void_v<T>, bool, T>;
+
+    struct State {
+        std::mutex mutex;
+        std::optional<Stored> value;
+        std::exception_ptr error;
+        std::optional<internal::Resumer> waiter;
+    };
+
+public:
+    Completion() : state_(std::make_shared<State>()) {}
+
+    template <typename U = T, typename = std::enable_if_t<!std::is_void_v<U>>>
+    bool resolve(U value) {
+        return settle([&](State& s) { s.value.emplace(std::move(value)); });
+    }
+
+    template <typename U = T, typename = std::enable_if_t<std::is_void_v<U>>>
+    bool resolve() {
+        return settle([](State& s) { s.value.emplace(true); });
+    }
+
+    bool fail(std::exception_ptr error) {
+        return settle([&](State& s) { s.error = std::move(error); });
+    }
+
+    bool done() const {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        return state_->value || state_->error;
+    }
+
+    class Awaiter {
+    public:
+        explicit Awaiter(std::shared_ptr<State> state) : state_(std::move(state)) {}
+
+        bool await_ready() const {
+            std::lock_guard<std::mutex> lock(state_->mutex);
+            return state_->value || state_->error;
+        }
+
+        bool await_suspend(std::coroutine_handle<> handle) {
+            internal::Resumer resume = internal::Resumer::current(handle);
+            std::lock_guard<std::mutex> lock(state_->mutex);
+            if (state_->value || state_->error) return false;
+            state_->waiter.emplace(std::move(resume));
+            return true;
+        }
+
+        T await_resume() {
+            if (state_->error) std::rethrow_exception(state_->error);
+            if constexpr (!std::is_void_v<T>) return std::move(*state_->value);
+        }
+
+    private:
+        std::shared_ptr<State> state_;
+    };
+
+    Awaiter operator co_await() const { return Awaiter(state_); }
+
+private:
+    template <typename Fn>
+    bool settle(Fn&& fn) {
+        std::optional<internal::Resumer> waiter;
+        {
+            std::lock_guard<std::mutex> lock(state_->mutex);
+            if (state_->value || state_->error) return false;
+            fn(*state_);
+            waiter = std::move(state_->waiter);
+            state_->waiter.reset();
+        }
+        if (waiter) (*waiter)();
+        return true;
+    }
+
+    std::shared_ptr<State> state_;
+};
+
+} // namespace crest
+
+#endif /* CREST_TASK_HPP */
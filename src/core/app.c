@@ -36,6 +36,12 @@ crest_app_t* crest_create(void) {
     app->running = false;
     app->route_mutex = crest_mutex_create();
     app->thread_pool = NULL;
+    app->cors = NULL;
+    app->scheduler = NULL;
+    app->shed_target_ms = 0;
+    app->shed_interval_ms = 100;
+    app->shed_max_concurrency = 1000;
+    app->request_timeout_ms = 0;
     
     return app;
 }
@@ -110,3 +116,14 @@ void crest_set_proxy(crest_app_t* app, const char* proxy_url) {
         app->proxy_url = strdup(proxy_url);
     }
 }
+
+void crest_set_request_timeout(crest_app_t* app, int timeout_ms) {
+    if (app) app->request_timeout_ms = timeout_ms > 0 ? timeout_ms : 0;
+}
+
+void crest_set_load_shedding(crest_app_t* app, int target_ms, int interval_ms, int max_concurrency) {
+    if (!app) return;
+    app->shed_target_ms = target_ms > 0 ? target_ms : 0;
+    if (interval_ms > 0) app->shed_interval_ms = interval_ms;
+    if (max_concurrency > 0) app->shed_max_concurrency = max_concurrency;
+}
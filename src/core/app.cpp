@@ -5,6 +5,10 @@
 
 #include "crest/crest.hpp"
 #include "crest/internal/app_internal.h"
+#include "crest/internal/pipeline.hpp"
+#include "crest/internal/scheduler.hpp"
+#include "crest/middleware.hpp"
+#include <algorithm>
 #include <cstring>
 
 namespace crest {
@@ -34,12 +38,47 @@ std::string Request::header(const std::string& key) const {
     return v ? std::string(v) : "";
 }
 
+std::string Request::remote_addr() const {
+    const char* a = crest_request_get_remote_addr(req_);
+    return a ? std::string(a) : "";
+}
+
+std::string Request::cookie(const std::string& name) const {
+    const char* v = crest_request_get_cookie(req_, name.c_str());
+    return v ? std::string(v) : "";
+}
+
+bool Request::has_cookie(const std::string& name) const {
+    return crest_request_get_cookie(req_, name.c_str()) != nullptr;
+}
+
+std::map<std::string, std::string> Request::cookies() const {
+    std::map<std::string, std::string> result;
+    const crest_kv_list_t* cookies = crest_request_cookies(req_);
+    for (size_t i = 0; i < cookies->count; ++i) {
+        result.emplace(cookies->items[i].key, cookies->items[i].value);
+    }
+    return result;
+}
+
+Deadline Request::deadline() const {
+    return Deadline::from_us(req_->deadline_us);
+}
+
 std::map<std::string, std::string> Request::queries() const {
-    return {};
+    std::map<std::string, std::string> result;
+    for (size_t i = 0; i < req_->queries.count; ++i) {
+        result.emplace(req_->queries.items[i].key, req_->queries.items[i].value);
+    }
+    return result;
 }
 
 std::map<std::string, std::string> Request::headers() const {
-    return {};
+    std::map<std::string, std::string> result;
+    for (size_t i = 0; i < req_->headers.count; ++i) {
+        result.emplace(req_->headers.items[i].key, req_->headers.items[i].value);
+    }
+    return result;
 }
 
 void Response::json(Status status, const std::string& json) {
@@ -70,6 +109,97 @@ void Response::set_header(const std::string& key, const std::string& value) {
     crest_response_set_header(res_, key.c_str(), value.c_str());
 }
 
+namespace {
+
+// RFC 6265 token and cookie-octet rules
+bool is_cookie_name(const std::string& name) {
+    if (name.empty()) return false;
+    for (unsigned char c : name) {
+        if (c <= 0x20 || c >= 0x7f || std::strchr("()<>@,;:\\\"/[]?={}", c)) return false;
+    }
+    return true;
+}
+
+bool is_cookie_value(const std::string& value) {
+    for (unsigned char c : value) {
+        if (c <= 0x20 || c >= 0x7f || c == '"' || c == ',' || c == ';' || c == '\\') return false;
+    }
+    return true;
+}
+
+} // namespace
+
+void Response::set_cookie(const std::string& name, const std::string& value, const CookieOptions& opts) {
+    if (!is_cookie_name(name)) throw Exception("Invalid cookie name: " + name);
+    if (!is_cookie_value(value)) throw Exception("Invalid characters in value of cookie " + name);
+    
+    std::string header = name + "=" + value;
+    if (!opts.path.empty()) header += "; Path=" + opts.path;
+    if (!opts.domain.empty()) header += "; Domain=" + opts.domain;
+    if (opts.max_age_seconds >= 0) header += "; Max-Age=" + std::to_string(opts.max_age_seconds);
+    if (opts.secure) header += "; Secure";
+    if (opts.http_only) header += "; HttpOnly";
+    if (!opts.same_site.empty()) header += "; SameSite=" + opts.same_site;
+    
+    // Unlike other headers, each cookie needs its own Set-Cookie line
+    crest_kv_add(&res_->headers, "Set-Cookie", header.c_str());
+}
+
+void Response::clear_cookie(const std::string& name, const CookieOptions& opts) {
+    CookieOptions expired = opts;
+    expired.max_age_seconds = 0;
+    set_cookie(name, "", expired);
+}
+
+void Response::after_send(std::function<void()> task) {
+    if (!task) return;
+    auto* held = new std::function<void()>(std::move(task));
+    crest_response_add_deferred(
+        res_,
+        [](void* arg) { (*static_cast<std::function<void()>*>(arg))(); },
+        held,
+        [](void* arg) { delete static_cast<std::function<void()>*>(arg); });
+}
+
+int Response::status() const {
+    return res_->status;
+}
+
+std::string Response::body() const {
+    return res_->body ? std::string(res_->body, res_->body_length) : "";
+}
+
+std::string Response::header(const std::string& key) const {
+    const char* v = crest_kv_get(&res_->headers, key.c_str(), true);
+    return v ? std::string(v) : "";
+}
+
+bool Response::sent() const {
+    return res_->sent;
+}
+
+namespace {
+
+class FunctionMiddleware : public Middleware {
+public:
+    explicit FunctionMiddleware(MiddlewareFunction fn) : fn_(std::move(fn)) {}
+    
+    void handle(Request& req, Response& res, NextFunction next) override {
+        fn_(req, res, next);
+    }
+
+private:
+    MiddlewareFunction fn_;
+};
+
+bool matches_prefix(const std::string& path, const std::string& prefix) {
+    if (prefix.empty() || prefix == "/") return true;
+    if (path.compare(0, prefix.size(), prefix) != 0) return false;
+    return path.size() == prefix.size() || prefix.back() == '/' || path[prefix.size()] == '/';
+}
+
+} // namespace
+
 App::App() : app_(crest_create()) {}
 
 App::App(const Config& config) {
@@ -79,6 +209,10 @@ App::App(const Config& config) {
     c_config.version = config.version.c_str();
     c_config.docs_enabled = config.docs_enabled;
     app_ = crest_create_with_config(&c_config);
+    set_request_timeout(config.timeout_seconds * 1000);
+    if (config.load_shedding) {
+        set_load_shedding(true, config.queue_target_ms, config.queue_interval_ms, config.max_connections);
+    }
 }
 
 App::~App() {
@@ -87,7 +221,13 @@ App::~App() {
     }
 }
 
-App::App(App&& other) noexcept : app_(other.app_), handlers_(std::move(other.handlers_)) {
+App::App(App&& other) noexcept
+    : app_(other.app_),
+      middleware_(std::move(other.middleware_)),
+      group_middleware_(std::move(other.group_middleware_)),
+      routes_(std::move(other.routes_)),
+      response_cache_(std::move(other.response_cache_)),
+      scheduler_(std::move(other.scheduler_)) {
     other.app_ = nullptr;
 }
 
@@ -95,7 +235,11 @@ App& App::operator=(App&& other) noexcept {
     if (this != &other) {
         if (app_) crest_destroy(app_);
         app_ = other.app_;
-        handlers_ = std::move(other.handlers_);
+        middleware_ = std::move(other.middleware_);
+        group_middleware_ = std::move(other.group_middleware_);
+        routes_ = std::move(other.routes_);
+        response_cache_ = std::move(other.response_cache_);
+        scheduler_ = std::move(other.scheduler_);
         other.app_ = nullptr;
     }
     return *this;
@@ -104,7 +248,11 @@ App& App::operator=(App&& other) noexcept {
 App& App::route(Method method, const std::string& path, Handler handler, const std::string& description) {
     if (!app_) throw Exception("Invalid app instance");
     
-    Handler* handler_ptr = new Handler(std::move(handler));
+    auto state = std::make_unique<internal::RouteState>();
+    state->method = method;
+    state->path = path;
+    state->handler = std::move(handler);
+    build_chain(*state);
     
     auto c_handler = [](crest_request_t* req, crest_response_t* res) {
         // C handler wrapper - actual handler called via cpp_handler pointer
@@ -114,19 +262,99 @@ App& App::route(Method method, const std::string& path, Handler handler, const s
                             path.c_str(), c_handler, description.c_str());
     
     if (result != 0) {
-        delete handler_ptr;
         throw Exception("Failed to register route: " + path);
     }
     
-    handlers_[handler_ptr] = *handler_ptr;
-    
     if (app_->route_count > 0) {
-        app_->routes[app_->route_count - 1].cpp_handler = handler_ptr;
+        app_->routes[app_->route_count - 1].cpp_handler = state.get();
     }
+    routes_.push_back(std::move(state));
     
     return *this;
 }
 
+App& App::use(std::shared_ptr<Middleware> middleware) {
+    if (!middleware) throw Exception("Invalid middleware");
+    auto* cors = dynamic_cast<CorsMiddleware*>(middleware.get());
+    middleware_.push_back(std::move(middleware));
+    rebuild_or_undo([this] { middleware_.pop_back(); });
+    // Global CORS also answers preflights in the server loop, ahead of routing
+    if (cors) app_->cors = cors;
+    return *this;
+}
+
+App& App::use(MiddlewareFunction middleware) {
+    return use(std::make_shared<FunctionMiddleware>(std::move(middleware)));
+}
+
+App& App::use(const std::string& prefix, std::shared_ptr<Middleware> middleware) {
+    if (!middleware) throw Exception("Invalid middleware");
+    group_middleware_.emplace_back(prefix, std::move(middleware));
+    rebuild_or_undo([this] { group_middleware_.pop_back(); });
+    return *this;
+}
+
+App& App::use(const std::string& prefix, MiddlewareFunction middleware) {
+    return use(prefix, std::make_shared<FunctionMiddleware>(std::move(middleware)));
+}
+
+App& App::use(Method method, const std::string& path, std::shared_ptr<Middleware> middleware) {
+    if (!middleware) throw Exception("Invalid middleware");
+    internal::RouteState* route = find_route(method, path);
+    if (!route) throw Exception("Route not found: " + path, 404);
+    route->middleware.push_back(std::move(middleware));
+    rebuild_or_undo([route] { route->middleware.pop_back(); });
+    return *this;
+}
+
+App& App::use(Method method, const std::string& path, MiddlewareFunction middleware) {
+    return use(method, path, std::make_shared<FunctionMiddleware>(std::move(middleware)));
+}
+
+App& App::skip_global_middleware(Method method, const std::string& path) {
+    internal::RouteState* route = find_route(method, path);
+    if (!route) throw Exception("Route not found: " + path, 404);
+    route->skip_global = true;
+    build_chain(*route);
+    return *this;
+}
+
+internal::RouteState* App::find_route(Method method, const std::string& path) {
+    for (auto& route : routes_) {
+        if (route->method == method && route->path == path) return route.get();
+    }
+    return nullptr;
+}
+
+void App::build_chain(internal::RouteState& route) {
+    std::vector<Middleware*> chain;
+    if (!route.skip_global) {
+        for (const auto& mw : middleware_) chain.push_back(mw.get());
+    }
+    for (const auto& [prefix, mw] : group_middleware_) {
+        if (matches_prefix(route.path, prefix)) chain.push_back(mw.get());
+    }
+    for (const auto& mw : route.middleware) chain.push_back(mw.get());
+    if (!chain.empty() && route.cache && !route.cache->with_middleware) {
+        throw Exception("Route is cached without CacheKey::with_middleware: " + route.path);
+    }
+    route.chain = std::move(chain);
+}
+
+void App::build_chains() {
+    for (auto& route : routes_) build_chain(*route);
+}
+
+void App::rebuild_or_undo(const std::function<void()>& undo) {
+    try {
+        build_chains();
+    } catch (const Exception&) {
+        undo();
+        build_chains();
+        throw;
+    }
+}
+
 App& App::get(const std::string& path, Handler handler, const std::string& description) {
     return route(Method::GET, path, std::move(handler), description);
 }
@@ -160,6 +388,25 @@ void App::stop() {
     if (app_) crest_stop(app_);
 }
 
+Timer App::every(int interval_ms, std::function<void()> job, const TimerOptions& options) {
+    if (!app_) throw Exception("Invalid app instance");
+    if (interval_ms <= 0) throw Exception("Timer interval must be positive");
+    if (!scheduler_) {
+        scheduler_ = std::make_unique<internal::Scheduler>();
+        app_->scheduler = scheduler_.get();
+    }
+    return scheduler_->schedule(interval_ms, interval_ms, std::move(job), options);
+}
+
+Timer App::after(int delay_ms, std::function<void()> job, const TimerOptions& options) {
+    if (!app_) throw Exception("Invalid app instance");
+    if (!scheduler_) {
+        scheduler_ = std::make_unique<internal::Scheduler>();
+        app_->scheduler = scheduler_.get();
+    }
+    return scheduler_->schedule(delay_ms, 0, std::move(job), options);
+}
+
 void App::set_title(const std::string& title) {
     if (app_) crest_set_title(app_, title.c_str());
 }
@@ -176,6 +423,14 @@ void App::set_proxy(const std::string& proxy_url) {
     if (app_) crest_set_proxy(app_, proxy_url.c_str());
 }
 
+void App::set_request_timeout(int timeout_ms) {
+    if (app_) crest_set_request_timeout(app_, timeout_ms);
+}
+
+void App::set_load_shedding(bool enabled, int target_ms, int interval_ms, int max_concurrency) {
+    if (app_) crest_set_load_shedding(app_, enabled ? target_ms : 0, interval_ms, max_concurrency);
+}
+
 App& App::set_request_schema(Method method, const std::string& path, const std::string& schema) {
     if (app_) crest_set_request_schema(app_, static_cast<crest_method_t>(method), path.c_str(), schema.c_str());
     return *this;
@@ -186,4 +441,46 @@ App& App::set_response_schema(Method method, const std::string& path, const std:
     return *this;
 }
 
+App& App::cache(int ttl_ms, const CacheKey& key, int stale_while_revalidate_ms) {
+    if (routes_.empty()) throw Exception("No route to cache");
+    const internal::RouteState& last = *routes_.back();
+    return cache(last.method, last.path, ttl_ms, key, stale_while_revalidate_ms);
+}
+
+App& App::cache(Method method, const std::string& path, int ttl_ms, const CacheKey& key,
+                int stale_while_revalidate_ms) {
+    if (method != Method::GET) throw Exception("Only GET routes can be cached: " + path);
+    internal::RouteState* route = find_route(method, path);
+    if (!route) throw Exception("Route not found: " + path, 404);
+    if (!route->chain.empty() && !key.with_middleware) {
+        throw Exception("Route has middleware; set CacheKey::with_middleware to cache it: " + path);
+    }
+    if (!response_cache_) response_cache_ = std::make_unique<internal::ResponseCache>();
+    
+    auto policy = std::make_unique<internal::CachePolicy>();
+    policy->store = response_cache_.get();
+    policy->ttl_us = (int64_t)std::max(ttl_ms, 0) * 1000;
+    policy->stale_us = (int64_t)std::max(stale_while_revalidate_ms, 0) * 1000;
+    policy->query_keys = key.query;
+    policy->header_keys = key.headers;
+    policy->with_middleware = key.with_middleware;
+    route->cache = std::move(policy);
+    return *this;
+}
+
+void App::set_cache_capacity(size_t max_bytes) {
+    if (!response_cache_) {
+        internal::ResponseCache::Options opts;
+        opts.max_bytes = max_bytes;
+        response_cache_ = std::make_unique<internal::ResponseCache>(opts);
+    } else {
+        response_cache_->set_max_bytes(max_bytes);
+    }
+}
+
+App& App::set_timeout(Method method, const std::string& path, int timeout_ms) {
+    if (app_) crest_set_route_timeout(app_, static_cast<crest_method_t>(method), path.c_str(), timeout_ms);
+    return *this;
+}
+
 } // namespace crest
@@ -0,0 +1,223 @@
+/**
+ * @file async.cpp
+ * @brief Coroutine routes: resumption, the async timer wheel and the blocking-call pool
+ */
+
+#include "crest/task.hpp"
+#include "crest/crest.hpp"
+#include "crest/internal/pipeline.hpp"
+#include "crest/internal/scheduler.hpp"
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+namespace crest {
+
+namespace internal {
+
+/**
+ * @brief State of one coroutine route from its start until its response is done
+ *
+ * Served requests hold their connection open and resume on the request pool.
+ * Anywhere else (e.g. a test dispatching a route directly) the dispatching
+ * thread runs the coroutine's resumptions itself until it completes.
+ */
+class AsyncContext : public std::enable_shared_from_this<AsyncContext> {
+public:
+    AsyncContext(crest_request_t* req, crest_response_t* res)
+        : request(req), response(res), raw_(res), served_(hold_response(res)) {}
+
+    Request request;
+    Response response;
+
+    void resume(std::coroutine_handle<> handle) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            // The dispatch that started the coroutine is still unwinding
+            if (!settled_) {
+                parked_ = handle;
+                return;
+            }
+        }
+        post(handle);
+    }
+
+    void run(std::coroutine_handle<> handle);
+
+    void settle() {
+        std::coroutine_handle<> parked;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            settled_ = true;
+            parked = std::exchange(parked_, nullptr);
+        }
+        if (parked) post(parked);
+        if (!served_) drain();
+    }
+
+    void complete() {
+        if (served_) {
+            // May send and free the response; nothing below touches it
+            release_response(raw_);
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        done_ = true;
+        cv_.notify_all();
+    }
+
+private:
+    void post(std::coroutine_handle<> handle) {
+        if (served_) {
+            auto self = shared_from_this();
+            post_to_pool(raw_, [self, handle] { self->run(handle); });
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        local_.push_back(handle);
+        cv_.notify_all();
+    }
+
+    void drain() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            cv_.wait(lock, [this] { return done_ || !local_.empty(); });
+            if (local_.empty()) return;
+            std::coroutine_handle<> handle = local_.front();
+            local_.pop_front();
+            lock.unlock();
+            run(handle);
+            lock.lock();
+        }
+    }
+
+    crest_response_t* raw_;
+    bool served_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool settled_ = false;
+    bool done_ = false;
+    std::coroutine_handle<> parked_;
+    std::deque<std::coroutine_handle<>> local_;
+};
+
+namespace {
+
+thread_local AsyncContext* current_context = nullptr;
+// Started by the dispatch running on this thread, not yet settled
+thread_local std::shared_ptr<AsyncContext> unsettled;
+
+struct ContextScope {
+    AsyncContext* previous;
+    explicit ContextScope(AsyncContext* context) : previous(current_context) { current_context = context; }
+    ~ContextScope() { current_context = previous; }
+};
+
+// Fire-and-forget coroutine that owns a route's run and completes its response
+struct Detached {
+    struct promise_type {
+        Detached get_return_object() noexcept { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept { std::terminate(); }
+    };
+};
+
+Detached drive(std::shared_ptr<AsyncContext> context, std::shared_ptr<const AsyncHandler> handler) {
+    crest_response_t* raw = context->response.raw();
+    try {
+        co_await (*handler)(context->request, context->response);
+    } catch (const Exception& e) {
+        respond_with_error(raw, e.code(), e.what());
+    } catch (...) {
+        respond_with_error(raw, 500, "Internal Server Error");
+    }
+    context->complete();
+}
+
+Scheduler& async_timers() {
+    static Scheduler timers;
+    static std::once_flag started;
+    // Due resumptions only post to a pool, so they run on the wheel thread
+    std::call_once(started, [] { timers.start([](std::function<void()> job) { job(); }); });
+    return timers;
+}
+
+BackgroundQueue::Options default_blocking_options() {
+    BackgroundQueue::Options opts;
+    opts.threads = 16;
+    opts.capacity = 10000;
+    opts.low_priority = false;
+    opts.flush_timeout_ms = 0;
+    return opts;
+}
+
+std::mutex blocking_mutex;
+std::unique_ptr<BackgroundQueue> blocking_queue;
+BackgroundQueue::Options blocking_options = default_blocking_options();
+
+} // namespace
+
+void AsyncContext::run(std::coroutine_handle<> handle) {
+    ContextScope scope(this);
+    handle.resume();
+}
+
+Resumer Resumer::current(std::coroutine_handle<> handle) {
+    if (!current_context) throw Exception("Awaited outside a coroutine route");
+    return Resumer(current_context->shared_from_this(), handle);
+}
+
+void Resumer::operator()() const {
+    context_->resume(handle_);
+}
+
+Timer run_after(int64_t delay_ms, std::function<void()> job) {
+    int delay = (int)std::min<int64_t>(delay_ms, INT32_MAX);
+    return async_timers().schedule(delay, 0, std::move(job), TimerOptions());
+}
+
+void resume_after(Resumer resume, int64_t delay_ms) {
+    run_after(delay_ms, [resume] { resume(); });
+}
+
+bool submit_blocking(std::function<void()> job) {
+    BackgroundQueue* queue;
+    {
+        std::lock_guard<std::mutex> lock(blocking_mutex);
+        if (!blocking_queue) blocking_queue.reset(new BackgroundQueue(blocking_options));
+        queue = blocking_queue.get();
+    }
+    return queue->submit(std::move(job));
+}
+
+Handler async_entry(AsyncHandler handler) {
+    auto shared = std::make_shared<const AsyncHandler>(std::move(handler));
+    return [shared](Request& req, Response& res) {
+        if (unsettled) settle_async();
+        auto context = std::make_shared<AsyncContext>(req.raw(), res.raw());
+        unsettled = context;
+        ContextScope scope(context.get());
+        drive(context, shared);
+    };
+}
+
+void settle_async() {
+    if (!unsettled) return;
+    std::shared_ptr<AsyncContext> context = std::move(unsettled);
+    unsettled.reset();
+    context->settle();
+}
+
+} // namespace internal
+
+bool configure_blocking(const BackgroundQueue::Options& opts) {
+    std::lock_guard<std::mutex> lock(internal::blocking_mutex);
+    if (internal::blocking_queue) return false;
+    internal::blocking_options = opts;
+    return true;
+}
+
+} // namespace crest
@@ -0,0 +1,234 @@
+/**
+ * @file parallel.cpp
+ * @brief Work-stealing compute pool behind parallel_for, parallel_reduce and parallel_sort
+ */
+
+#include "crest/parallel.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace crest {
+
+namespace internal {
+
+namespace {
+
+/**
+ * @brief One run_chunks() call; lives on the waiting caller's stack
+ *
+ * remaining is only decremented under mutex, so once the caller has seen
+ * it reach zero and taken the mutex no chunk touches the group again.
+ */
+struct Group {
+    const std::function<void(size_t)>* chunk = nullptr;
+    std::atomic<size_t> remaining{0};
+    std::atomic<bool> failed{false};
+    std::mutex mutex;
+    std::condition_variable done_cv;
+    std::exception_ptr error;
+};
+
+struct Chunk {
+    Group* group;
+    size_t index;
+};
+
+/**
+ * @brief Fixed set of threads, each owning a deque of chunks
+ *
+ * A pool thread pushes the chunks of its own (nested) calls onto its deque
+ * and takes them back newest first while the cache is warm; idle threads
+ * steal the oldest chunks from the other deques. Callers from outside the
+ * pool spread their chunks over all deques. Every waiting caller runs chunks
+ * too, so a chunk that waits on nested work never leaves it stranded.
+ */
+class ComputePool {
+public:
+    explicit ComputePool(size_t threads) : queued_(0), next_queue_(0), stopping_(false) {
+        for (size_t i = 0; i < threads; ++i) queues_.emplace_back(new Queue());
+        workers_.reserve(threads);
+        for (size_t i = 0; i < threads; ++i) {
+            workers_.emplace_back([this, i] { worker(i); });
+        }
+    }
+
+    ~ComputePool() {
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex_);
+            stopping_ = true;
+        }
+        wake_cv_.notify_all();
+        for (auto& worker : workers_) worker.join();
+    }
+
+    size_t threads() const { return workers_.size(); }
+
+    void run(size_t count, const std::function<void(size_t)>& chunk) {
+        Group group;
+        group.chunk = &chunk;
+        group.remaining = count;
+
+        size_t self = current_pool == this ? current_index : NO_QUEUE;
+        if (self != NO_QUEUE) {
+            Queue& own = *queues_[self];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            for (size_t i = 0; i < count; ++i) own.chunks.push_back(Chunk{&group, i});
+        } else {
+            size_t start = next_queue_.fetch_add(1);
+            for (size_t q = 0; q < queues_.size(); ++q) {
+                Queue& queue = *queues_[(start + q) % queues_.size()];
+                std::lock_guard<std::mutex> lock(queue.mutex);
+                for (size_t i = q; i < count; i += queues_.size()) queue.chunks.push_back(Chunk{&group, i});
+            }
+        }
+        queued_ += count;
+        {
+            // A worker between its check and its wait cannot miss the wakeup
+            std::lock_guard<std::mutex> lock(sleep_mutex_);
+        }
+        wake_cv_.notify_all();
+
+        // Help while waiting: any chunk counts, not only this call's
+        while (group.remaining > 0) {
+            Chunk next;
+            if (take(self, next)) {
+                execute(next);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(group.mutex);
+            group.done_cv.wait_for(lock, std::chrono::microseconds(200), [&] { return group.remaining == 0; });
+        }
+        std::lock_guard<std::mutex> lock(group.mutex);
+        if (group.error) std::rethrow_exception(group.error);
+    }
+
+private:
+    static constexpr size_t NO_QUEUE = (size_t)-1;
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Chunk> chunks;
+    };
+
+    static thread_local ComputePool* current_pool;
+    static thread_local size_t current_index;
+
+    bool take(size_t self, Chunk& out) {
+        if (self != NO_QUEUE) {
+            Queue& own = *queues_[self];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.chunks.empty()) {
+                out = own.chunks.back();
+                own.chunks.pop_back();
+                --queued_;
+                return true;
+            }
+        }
+        size_t n = queues_.size();
+        size_t start = self != NO_QUEUE ? self + 1 : next_queue_.load();
+        for (size_t q = 0; q < n; ++q) {
+            size_t victim = (start + q) % n;
+            if (victim == self) continue;
+            Queue& queue = *queues_[victim];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (!queue.chunks.empty()) {
+                out = queue.chunks.front();
+                queue.chunks.pop_front();
+                --queued_;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static void execute(const Chunk& chunk) {
+        Group& group = *chunk.group;
+        if (!group.failed) {
+            try {
+                (*group.chunk)(chunk.index);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(group.mutex);
+                if (!group.error) group.error = std::current_exception();
+                group.failed = true;
+            }
+        }
+        std::lock_guard<std::mutex> lock(group.mutex);
+        if (--group.remaining == 0) group.done_cv.notify_all();
+    }
+
+    void worker(size_t index) {
+        current_pool = this;
+        current_index = index;
+        while (true) {
+            Chunk chunk;
+            if (take(index, chunk)) {
+                execute(chunk);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleep_mutex_);
+            wake_cv_.wait(lock, [this] { return stopping_ || queued_ > 0; });
+            if (stopping_ && queued_ == 0) return;
+        }
+    }
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> workers_;
+    std::atomic<size_t> queued_;
+    std::atomic<size_t> next_queue_;
+    std::mutex sleep_mutex_;
+    std::condition_variable wake_cv_;
+    bool stopping_;
+};
+
+thread_local ComputePool* ComputePool::current_pool = nullptr;
+thread_local size_t ComputePool::current_index = ComputePool::NO_QUEUE;
+
+size_t default_threads() {
+    size_t hardware = std::thread::hardware_concurrency();
+    if (hardware == 0) return 3;
+    // The caller is the remaining thread
+    return hardware - 1;
+}
+
+std::mutex pool_mutex;
+std::unique_ptr<ComputePool> compute_pool;
+size_t pool_threads = default_threads();
+
+ComputePool& pool() {
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    if (!compute_pool) compute_pool.reset(new ComputePool(pool_threads));
+    return *compute_pool;
+}
+
+} // namespace
+
+void run_chunks(size_t count, const std::function<void(size_t)>& chunk) {
+    if (count == 0) return;
+    ComputePool& compute = pool();
+    if (count == 1 || compute.threads() == 0) {
+        for (size_t i = 0; i < count; ++i) chunk(i);
+        return;
+    }
+    compute.run(count, chunk);
+}
+
+size_t parallel_width() {
+    return pool().threads() + 1;
+}
+
+} // namespace internal
+
+bool configure_parallel(size_t threads) {
+    std::lock_guard<std::mutex> lock(internal::pool_mutex);
+    if (internal::compute_pool) return false;
+    internal::pool_threads = threads;
+    return true;
+}
+
+} // namespace crest
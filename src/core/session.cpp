@@ -0,0 +1,276 @@
+/**
+ * @file session.cpp
+ * @brief Signed cookies and the sharded, timer-wheel-expired session store
+ */
+
+#include "crest/session.hpp"
+#include "../utils/hash.hpp"
+#include "../utils/sha256.hpp"
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+namespace crest {
+
+namespace {
+
+std::string base64url_encode(const unsigned char* data, size_t length) {
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+    std::string out;
+    out.reserve((length * 4 + 2) / 3);
+    size_t i = 0;
+    for (; i + 3 <= length; i += 3) {
+        uint32_t v = ((uint32_t)data[i] << 16) | ((uint32_t)data[i + 1] << 8) | data[i + 2];
+        out += alphabet[(v >> 18) & 63];
+        out += alphabet[(v >> 12) & 63];
+        out += alphabet[(v >> 6) & 63];
+        out += alphabet[v & 63];
+    }
+    if (i + 1 == length) {
+        uint32_t v = (uint32_t)data[i] << 16;
+        out += alphabet[(v >> 18) & 63];
+        out += alphabet[(v >> 12) & 63];
+    } else if (i + 2 == length) {
+        uint32_t v = ((uint32_t)data[i] << 16) | ((uint32_t)data[i + 1] << 8);
+        out += alphabet[(v >> 18) & 63];
+        out += alphabet[(v >> 12) & 63];
+        out += alphabet[(v >> 6) & 63];
+    }
+    return out;
+}
+
+// Session ids only need to be unguessable; the cookie signature stops forgery
+std::string random_id() {
+    thread_local std::random_device device;
+    unsigned char bytes[16];
+    for (size_t i = 0; i < sizeof(bytes); i += 4) {
+        uint32_t v = device();
+        std::memcpy(bytes + i, &v, 4);
+    }
+    return base64url_encode(bytes, sizeof(bytes));
+}
+
+} // namespace
+
+struct CookieSigner::Keys {
+    Sha256 inner;
+    Sha256 outer;
+};
+
+CookieSigner::CookieSigner(const std::string& secret) : keys_(new Keys) {
+    if (secret.empty()) throw Exception("Cookie signing secret must not be empty");
+
+    unsigned char block[64] = {0};
+    if (secret.size() > sizeof(block)) {
+        Sha256::Digest hashed = Sha256::hash(secret.data(), secret.size());
+        std::memcpy(block, hashed.data(), hashed.size());
+    } else {
+        std::memcpy(block, secret.data(), secret.size());
+    }
+
+    unsigned char ipad[64], opad[64];
+    for (int i = 0; i < 64; ++i) {
+        ipad[i] = block[i] ^ 0x36;
+        opad[i] = block[i] ^ 0x5c;
+    }
+    keys_->inner.update(ipad, sizeof(ipad));
+    keys_->outer.update(opad, sizeof(opad));
+}
+
+CookieSigner::~CookieSigner() = default;
+
+std::string CookieSigner::sign(const std::string& value) const {
+    Sha256 inner = keys_->inner;
+    inner.update(value.data(), value.size());
+    Sha256::Digest inner_digest = inner.finish();
+
+    Sha256 outer = keys_->outer;
+    outer.update(inner_digest.data(), inner_digest.size());
+    Sha256::Digest mac = outer.finish();
+
+    return value + "." + base64url_encode(mac.data(), mac.size());
+}
+
+bool CookieSigner::unsign(const std::string& signed_value, std::string& value) const {
+    size_t dot = signed_value.rfind('.');
+    if (dot == std::string::npos) return false;
+
+    std::string expected = sign(signed_value.substr(0, dot));
+    if (expected.size() != signed_value.size() ||
+        !constant_time_equals(expected.data(), signed_value.data(), expected.size())) {
+        return false;
+    }
+    value = signed_value.substr(0, dot);
+    return true;
+}
+
+struct SessionStore::Shard {
+    struct Entry {
+        Data data;
+        int64_t expires_tick;
+    };
+
+    std::mutex mutex;
+    std::unordered_map<std::string, Entry> sessions;
+    // Ids filed by expires_tick % slots; an id's entry may since have moved
+    // later (sliding expiry) or been destroyed, which the sweep checks
+    std::vector<std::vector<std::string>> wheel;
+    int64_t current_tick = 0;
+};
+
+SessionStore::SessionStore(const Options& opts)
+    : options_(opts), signer_(opts.secret), shards_(new Shard[opts.shards > 0 ? opts.shards : 1]) {
+    if (options_.shards == 0) options_.shards = 1;
+    if (options_.tick_ms <= 0) options_.tick_ms = 1000;
+    if (options_.wheel_slots == 0) options_.wheel_slots = 1;
+    ttl_ticks_ = std::max<int64_t>(1, ((int64_t)options_.ttl_seconds * 1000 + options_.tick_ms - 1) / options_.tick_ms);
+
+    int64_t now = now_tick();
+    for (size_t i = 0; i < options_.shards; ++i) {
+        shards_[i].wheel.resize(options_.wheel_slots);
+        shards_[i].current_tick = now;
+    }
+}
+
+SessionStore::~SessionStore() = default;
+
+SessionStore::Shard& SessionStore::shard_for(const std::string& id) const {
+    return shards_[hash_string(id) % options_.shards];
+}
+
+int64_t SessionStore::now_tick() const {
+    return Deadline::now_us() / ((int64_t)options_.tick_ms * 1000);
+}
+
+size_t SessionStore::advance(Shard& shard, int64_t now) {
+    if (now <= shard.current_tick) return 0;
+
+    // After a gap longer than one revolution every slot is due exactly once
+    int64_t slots = (int64_t)options_.wheel_slots;
+    int64_t steps = std::min(now - shard.current_tick, slots);
+    size_t expired = 0;
+    std::vector<std::string> due;
+    for (int64_t tick = now - steps + 1; tick <= now; ++tick) {
+        due.clear();
+        due.swap(shard.wheel[(size_t)(tick % slots)]);
+        for (auto& id : due) {
+            auto it = shard.sessions.find(id);
+            if (it == shard.sessions.end()) continue;
+            if (it->second.expires_tick <= now) {
+                shard.sessions.erase(it);
+                ++expired;
+            } else {
+                // Not due yet: a later revolution or a sliding refresh
+                shard.wheel[(size_t)(it->second.expires_tick % slots)].push_back(std::move(id));
+            }
+        }
+    }
+    shard.current_tick = now;
+    return expired;
+}
+
+std::string SessionStore::create(Data data) {
+    std::string id = random_id();
+    int64_t now = now_tick();
+    Shard& shard = shard_for(id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    advance(shard, now);
+
+    int64_t expires = now + ttl_ticks_;
+    shard.sessions[id] = Shard::Entry{std::move(data), expires};
+    shard.wheel[(size_t)(expires % (int64_t)options_.wheel_slots)].push_back(id);
+    return id;
+}
+
+bool SessionStore::get(const std::string& id, Data& out) {
+    int64_t now = now_tick();
+    Shard& shard = shard_for(id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    advance(shard, now);
+
+    auto it = shard.sessions.find(id);
+    if (it == shard.sessions.end()) return false;
+    if (it->second.expires_tick <= now) {
+        shard.sessions.erase(it);
+        return false;
+    }
+    // The wheel re-files it when its old slot comes round
+    if (options_.sliding) it->second.expires_tick = now + ttl_ticks_;
+    out = it->second.data;
+    return true;
+}
+
+bool SessionStore::set(const std::string& id, Data data) {
+    return update(id, [&](Data& current) { current = std::move(data); });
+}
+
+bool SessionStore::update(const std::string& id, const std::function<void(Data&)>& fn) {
+    int64_t now = now_tick();
+    Shard& shard = shard_for(id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    advance(shard, now);
+
+    auto it = shard.sessions.find(id);
+    if (it == shard.sessions.end() || it->second.expires_tick <= now) return false;
+    if (options_.sliding) it->second.expires_tick = now + ttl_ticks_;
+    fn(it->second.data);
+    return true;
+}
+
+bool SessionStore::destroy(const std::string& id) {
+    Shard& shard = shard_for(id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.sessions.erase(id) > 0;
+}
+
+size_t SessionStore::sweep() {
+    int64_t now = now_tick();
+    size_t expired = 0;
+    for (size_t i = 0; i < options_.shards; ++i) {
+        std::lock_guard<std::mutex> lock(shards_[i].mutex);
+        expired += advance(shards_[i], now);
+    }
+    return expired;
+}
+
+size_t SessionStore::size() const {
+    size_t total = 0;
+    for (size_t i = 0; i < options_.shards; ++i) {
+        std::lock_guard<std::mutex> lock(shards_[i].mutex);
+        total += shards_[i].sessions.size();
+    }
+    return total;
+}
+
+std::string SessionStore::session_id(const Request& req) const {
+    std::string cookie = req.cookie(options_.cookie_name);
+    std::string id;
+    if (cookie.empty() || !signer_.unsign(cookie, id)) return "";
+    return id;
+}
+
+bool SessionStore::load(const Request& req, Data& out, std::string* id) {
+    std::string session = session_id(req);
+    if (session.empty() || !get(session, out)) return false;
+    if (id) *id = std::move(session);
+    return true;
+}
+
+std::string SessionStore::start(Response& res, Data data) {
+    std::string id = create(std::move(data));
+    CookieOptions cookie = options_.cookie;
+    if (cookie.max_age_seconds < 0 && !options_.sliding) cookie.max_age_seconds = options_.ttl_seconds;
+    res.set_cookie(options_.cookie_name, signer_.sign(id), cookie);
+    return id;
+}
+
+void SessionStore::end(const Request& req, Response& res) {
+    std::string id = session_id(req);
+    if (!id.empty()) destroy(id);
+    res.clear_cookie(options_.cookie_name, options_.cookie);
+}
+
+} // namespace crest
@@ -7,49 +7,739 @@
 #include <sstream>
 #include <mutex>
 #include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+extern "C" {
+    void crest_log_error(const char* msg);
+    void crest_log_warning(const char* msg);
+}
 
 namespace crest {
 namespace db {
 
-ConnectionPool::ConnectionPool(const Config& config) : config_(config) {}
+namespace {
+
+int64_t seconds_to_us(int seconds) {
+    return (int64_t)seconds * 1000000;
+}
+
+uint64_t elapsed_ns(std::chrono::steady_clock::time_point since) {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - since).count();
+}
+
+} // namespace
+
+/**
+ * @brief Connections one thread has parked for a given pool
+ *
+ * Keyed by the pool's token, so caches of destroyed pools are recognised
+ * and dropped. An entry may linger here after another thread took it; the
+ * state exchange in take_parked() tells.
+ */
+struct ConnectionPool::ThreadCache {
+    std::weak_ptr<char> owner;
+    std::vector<std::shared_ptr<Entry>> entries;
+};
+
+/**
+ * @brief The pool mutex, timed for stats()
+ */
+class ConnectionPool::TimedLock {
+public:
+    explicit TimedLock(const ConnectionPool& pool) : pool_(pool), lock_(pool.mutex_, std::defer_lock) {
+        lock();
+    }
+    
+    ~TimedLock() {
+        if (lock_.owns_lock()) unlock();
+    }
+    
+    void lock() {
+        auto start = std::chrono::steady_clock::now();
+        lock_.lock();
+        held_since_ = std::chrono::steady_clock::now();
+        pool_.lock_wait_ns_ += (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(held_since_ - start).count();
+        ++pool_.lock_acquisitions_;
+    }
+    
+    void unlock() {
+        pool_.lock_hold_ns_ += elapsed_ns(held_since_);
+        lock_.unlock();
+    }
+    
+    template <typename Predicate>
+    bool wait(std::condition_variable& cv, const Deadline& deadline, Predicate pred) {
+        pool_.lock_hold_ns_ += elapsed_ns(held_since_);
+        bool ready = deadline.wait(cv, lock_, pred);
+        held_since_ = std::chrono::steady_clock::now();
+        return ready;
+    }
+
+private:
+    const ConnectionPool& pool_;
+    std::unique_lock<std::mutex> lock_;
+    std::chrono::steady_clock::time_point held_since_;
+};
+
+ResultSet::ResultSet(std::initializer_list<Row> rows) : rows_(0) {
+    for (const auto& row : rows) push_back(row);
+}
+
+ResultSet::ResultSet(const std::vector<std::string>& columns) : rows_(0) {
+    for (const auto& name : columns) add_column(name);
+}
+
+size_t ResultSet::add_column(const std::string& name) {
+    size_t index = names_.size();
+    names_.push_back(name);
+    // A repeated name (e.g. from a join) keeps resolving to its first column
+    index_.emplace(name, index);
+    columns_.emplace_back();
+    columns_.back().nulls.assign(rows_, 1);
+    return index;
+}
+
+void ResultSet::append(const std::vector<Value>& values) {
+    if (values.size() != columns_.size()) {
+        throw std::invalid_argument("Row has " + std::to_string(values.size()) + " values for " +
+                                    std::to_string(columns_.size()) + " columns");
+    }
+    for (size_t i = 0; i < values.size(); ++i) set_cell(columns_[i], values[i]);
+    ++rows_;
+}
+
+void ResultSet::push_back(const Row& row) {
+    std::vector<uint8_t> filled(columns_.size(), 0);
+    for (const auto& [name, value] : row) {
+        size_t index = column(name);
+        if (index == npos) {
+            index = add_column(name);
+            filled.push_back(0);
+        }
+        set_cell(columns_[index], value);
+        filled[index] = 1;
+    }
+    for (size_t i = 0; i < columns_.size(); ++i) {
+        if (!filled[i]) set_cell(columns_[i], nullptr);
+    }
+    ++rows_;
+}
+
+void ResultSet::reserve(size_t rows) {
+    for (auto& col : columns_) {
+        col.nulls.reserve(rows);
+        switch (col.type) {
+            case ColumnType::Int: col.ints.reserve(rows); break;
+            case ColumnType::Double: col.doubles.reserve(rows); break;
+            case ColumnType::Bool: col.bools.reserve(rows); break;
+            case ColumnType::String: col.texts.reserve(rows); break;
+            case ColumnType::Mixed: col.mixed.reserve(rows); break;
+            case ColumnType::Null: break;
+        }
+    }
+}
+
+ResultSet::RowView ResultSet::at(size_t row) const {
+    if (row >= rows_) throw std::out_of_range("Row " + std::to_string(row) + " of " + std::to_string(rows_));
+    return RowView(this, row);
+}
+
+size_t ResultSet::column(const std::string& name) const {
+    auto it = index_.find(name);
+    return it == index_.end() ? npos : it->second;
+}
+
+Value ResultSet::value(size_t row, size_t column) const {
+    if (column >= columns_.size() || row >= rows_) throw std::out_of_range("No such cell");
+    const Column& col = columns_[column];
+    if (col.type == ColumnType::Mixed) return col.mixed[row];
+    if (col.nulls[row]) return nullptr;
+    switch (col.type) {
+        case ColumnType::Int: return col.ints[row];
+        case ColumnType::Double: return col.doubles[row];
+        case ColumnType::Bool: return col.bools[row] != 0;
+        case ColumnType::String: return std::string(text(row, column));
+        default: return nullptr;
+    }
+}
+
+bool ResultSet::is_null(size_t row, size_t column) const {
+    return columns_[column].nulls[row] != 0;
+}
+
+std::string_view ResultSet::text(size_t row, size_t column) const {
+    const Column& col = columns_[column];
+    if (col.nulls[row]) return {};
+    if (col.type == ColumnType::String) {
+        const Text& t = col.texts[row];
+        return std::string_view(arena_.data() + t.offset, t.length);
+    }
+    if (col.type == ColumnType::Mixed) {
+        if (const auto* s = std::get_if<std::string>(&col.mixed[row])) return *s;
+    }
+    return {};
+}
+
+const std::vector<int>& ResultSet::ints(size_t column) const {
+    return typed(column, ColumnType::Int).ints;
+}
+
+const std::vector<double>& ResultSet::doubles(size_t column) const {
+    return typed(column, ColumnType::Double).doubles;
+}
+
+const std::vector<uint8_t>& ResultSet::bools(size_t column) const {
+    return typed(column, ColumnType::Bool).bools;
+}
+
+size_t ResultSet::memory_usage() const {
+    size_t bytes = names_.capacity() * sizeof(std::string) + arena_.capacity();
+    for (const auto& name : names_) {
+        if (name.capacity() > 15) bytes += name.capacity() + 1;
+    }
+    // Buckets plus one node per name
+    bytes += index_.bucket_count() * sizeof(void*) +
+             index_.size() * (sizeof(std::pair<const std::string, size_t>) + sizeof(void*));
+    bytes += columns_.capacity() * sizeof(Column);
+    for (const auto& col : columns_) {
+        bytes += col.nulls.capacity() + col.ints.capacity() * sizeof(int) +
+                 col.doubles.capacity() * sizeof(double) + col.bools.capacity() +
+                 col.texts.capacity() * sizeof(Text) + col.mixed.capacity() * sizeof(Value);
+        for (const auto& v : col.mixed) {
+            const auto* s = std::get_if<std::string>(&v);
+            if (s && s->capacity() > 15) bytes += s->capacity() + 1;
+        }
+    }
+    return bytes;
+}
+
+void ResultSet::set_cell(Column& col, const Value& value) {
+    bool null = std::holds_alternative<std::nullptr_t>(value);
+    col.nulls.push_back(null ? 1 : 0);
+    if (col.type == ColumnType::Mixed) {
+        col.mixed.push_back(value);
+        return;
+    }
+    if (null) {
+        // Keep the typed array aligned with the rows
+        switch (col.type) {
+            case ColumnType::Int: col.ints.push_back(0); break;
+            case ColumnType::Double: col.doubles.push_back(0.0); break;
+            case ColumnType::Bool: col.bools.push_back(0); break;
+            case ColumnType::String: col.texts.push_back(Text{0, 0}); break;
+            default: break;
+        }
+        return;
+    }
+    
+    static const ColumnType types[] = {ColumnType::Null, ColumnType::Int, ColumnType::Double,
+                                       ColumnType::String, ColumnType::Bool};
+    ColumnType type = types[value.index()];
+    size_t before = col.nulls.size() - 1;
+    if (col.type == ColumnType::Null) {
+        // First value: the rows so far were all null
+        col.type = type;
+        switch (type) {
+            case ColumnType::Int: col.ints.resize(before); break;
+            case ColumnType::Double: col.doubles.resize(before); break;
+            case ColumnType::Bool: col.bools.resize(before); break;
+            case ColumnType::String: col.texts.resize(before, Text{0, 0}); break;
+            default: break;
+        }
+    } else if (col.type != type) {
+        col.nulls.pop_back();
+        to_mixed(col);
+        col.nulls.push_back(0);
+        col.mixed.push_back(value);
+        return;
+    }
+    
+    switch (type) {
+        case ColumnType::Int: col.ints.push_back(std::get<int>(value)); break;
+        case ColumnType::Double: col.doubles.push_back(std::get<double>(value)); break;
+        case ColumnType::Bool: col.bools.push_back(std::get<bool>(value) ? 1 : 0); break;
+        case ColumnType::String: {
+            const std::string& s = std::get<std::string>(value);
+            if (arena_.size() + s.size() > UINT32_MAX) throw std::length_error("Result set text exceeds 4 GiB");
+            col.texts.push_back(Text{(uint32_t)arena_.size(), (uint32_t)s.size()});
+            arena_.append(s);
+            break;
+        }
+        default: break;
+    }
+}
+
+void ResultSet::to_mixed(Column& col) {
+    std::vector<Value> mixed;
+    mixed.reserve(col.nulls.capacity());
+    for (size_t row = 0; row < col.nulls.size(); ++row) {
+        if (col.nulls[row]) {
+            mixed.emplace_back(nullptr);
+            continue;
+        }
+        switch (col.type) {
+            case ColumnType::Int: mixed.emplace_back(col.ints[row]); break;
+            case ColumnType::Double: mixed.emplace_back(col.doubles[row]); break;
+            case ColumnType::Bool: mixed.emplace_back(col.bools[row] != 0); break;
+            case ColumnType::String:
+                mixed.emplace_back(std::string(arena_.data() + col.texts[row].offset, col.texts[row].length));
+                break;
+            default: mixed.emplace_back(nullptr); break;
+        }
+    }
+    // The column's text stays in the arena unreferenced; mixed columns are rare
+    std::vector<uint8_t> nulls = std::move(col.nulls);
+    col = Column();
+    col.type = ColumnType::Mixed;
+    col.nulls = std::move(nulls);
+    col.mixed = std::move(mixed);
+}
+
+const ResultSet::Column& ResultSet::typed(size_t column, ColumnType type) const {
+    const Column& col = columns_.at(column);
+    if (col.type != type) throw std::logic_error("Column '" + names_[column] + "' has another type");
+    return col;
+}
+
+Value ResultSet::RowView::value(const std::string& column) const {
+    size_t index = set_->column(column);
+    if (index == npos) throw std::out_of_range("No column '" + column + "'");
+    return set_->value(row_, index);
+}
+
+bool ResultSet::RowView::is_null(const std::string& column) const {
+    size_t index = set_->column(column);
+    return index == npos || set_->is_null(row_, index);
+}
+
+std::string_view ResultSet::RowView::text(const std::string& column) const {
+    size_t index = set_->column(column);
+    return index == npos ? std::string_view() : set_->text(row_, index);
+}
+
+Row ResultSet::RowView::to_row() const {
+    Row row;
+    for (size_t i = 0; i < set_->names_.size(); ++i) row.emplace(set_->names_[i], set_->value(row_, i));
+    return row;
+}
+
+std::shared_ptr<Statement> StatementCache::find(const std::string& sql) {
+    auto it = index_.find(sql);
+    if (it == index_.end()) {
+        ++misses_;
+        return nullptr;
+    }
+    ++hits_;
+    order_.splice(order_.begin(), order_, it->second);
+    return *it->second;
+}
+
+void StatementCache::insert(std::shared_ptr<Statement> stmt) {
+    if (!stmt || capacity_ == 0) return;
+    auto it = index_.find(stmt->sql());
+    if (it != index_.end()) {
+        order_.erase(it->second);
+        index_.erase(it);
+    }
+    order_.push_front(std::move(stmt));
+    // Keyed by a view of the statement's own SQL, which lives as long as the entry
+    index_[order_.front()->sql()] = order_.begin();
+    trim();
+}
+
+void StatementCache::clear() {
+    index_.clear();
+    order_.clear();
+}
+
+void StatementCache::set_capacity(size_t capacity) {
+    capacity_ = capacity;
+    trim();
+}
+
+void StatementCache::trim() {
+    while (index_.size() > capacity_) {
+        index_.erase(order_.back()->sql());
+        order_.pop_back();
+        ++evictions_;
+    }
+}
+
+std::shared_ptr<Statement> Connection::statement(const std::string& query) {
+    if (auto cached = statements_.find(query)) return cached;
+    auto stmt = prepare(query);
+    statements_.insert(stmt);
+    return stmt;
+}
+
+ConnectionPool::ConnectionPool(const Config& config)
+    : config_(config), opening_(0), active_(0), waiting_(0), token_(std::make_shared<char>()) {}
+
+ConnectionPool::ConnectionPool(const Config& config, Factory factory)
+    : config_(config), factory_(std::move(factory)), opening_(0), active_(0), waiting_(0),
+      token_(std::make_shared<char>()) {
+    warm_up();
+}
 
 ConnectionPool::~ConnectionPool() {
     std::lock_guard<std::mutex> lock(mutex_);
-    available_.clear();
-    active_.clear();
+    for (auto& pair : entries_) {
+        if (pair.second->state.exchange(RETIRED) != LEASED) pair.second->conn->disconnect();
+    }
+    idle_.clear();
+    entries_.clear();
+}
+
+void ConnectionPool::Lease::release() {
+    if (pool_) pool_->checkin(entry_, true);
+    pool_ = nullptr;
+    entry_ = nullptr;
+}
+
+void ConnectionPool::add(std::shared_ptr<Connection> conn) {
+    if (!conn) return;
+    
+    TimedLock lock(*this);
+    if (entries_.count(conn.get())) return;
+    auto entry = std::make_shared<Entry>();
+    entry->conn = std::move(conn);
+    entry->created_us = entry->returned_us = Deadline::now_us();
+    entries_[entry->conn.get()] = entry;
+    hand_over(entry.get());
+}
+
+ConnectionPool::Lease ConnectionPool::lease() {
+    return lease(Deadline::never());
+}
+
+ConnectionPool::Lease ConnectionPool::lease(const Deadline& deadline) {
+    Entry* entry = checkout(deadline);
+    return entry ? Lease(this, entry) : Lease();
 }
 
 std::shared_ptr<Connection> ConnectionPool::acquire() {
-    std::lock_guard<std::mutex> lock(mutex_);
+    return acquire(Deadline::never());
+}
+
+std::shared_ptr<Connection> ConnectionPool::acquire(const Deadline& deadline) {
+    Entry* entry = checkout(deadline);
+    return entry ? entry->conn : nullptr;
+}
+
+void ConnectionPool::release(std::shared_ptr<Connection> conn) {
+    if (!conn) return;
+    Entry* entry;
+    {
+        TimedLock lock(*this);
+        auto it = entries_.find(conn.get());
+        if (it == entries_.end() || it->second->state != LEASED) return;
+        entry = it->second.get();
+    }
+    checkin(entry, true);
+}
+
+ConnectionPool::Entry* ConnectionPool::checkout(const Deadline& deadline) {
+    // Don't hand a connection to a request nobody is waiting for any more
+    if (deadline.expired()) return nullptr;
     
-    if (!available_.empty()) {
-        auto conn = available_.back();
-        available_.pop_back();
-        active_.push_back(conn);
-        return conn;
+    while (Entry* entry = take_parked()) {
+        if (usable(*entry, Deadline::now_us())) return entry;
+        retire(entry);
     }
     
+    Deadline wait_until = deadline.within(std::chrono::seconds(config_.timeout_seconds > 0 ? config_.timeout_seconds : 0));
+    TimedLock lock(*this);
+    while (true) {
+        // Announced before looking at parked entries; see park()
+        ++waiting_;
+        Entry* entry = nullptr;
+        bool open = false;
+        if (waiters_.empty() && !idle_.empty()) {
+            // Most recently used first: it is the least likely to have gone stale
+            entry = idle_.back();
+            idle_.pop_back();
+            entry->state = LEASED;
+            ++active_;
+        } else if (waiters_.empty() && (entry = steal())) {
+            ++steals_;
+        } else if (waiters_.empty() && factory_ && entries_.size() + opening_ < config_.max_connections) {
+            ++opening_;
+            open = true;
+        } else {
+            Waiter waiter;
+            waiters_.push_back(&waiter);
+            lock.wait(waiter.cv, wait_until, [&waiter] { return waiter.entry || waiter.may_open; });
+            if (!waiter.entry && !waiter.may_open) {
+                waiters_.erase(std::find(waiters_.begin(), waiters_.end(), &waiter));
+                --waiting_;
+                return nullptr;
+            }
+            entry = waiter.entry;
+            open = waiter.may_open;
+        }
+        --waiting_;
+        ++locked_acquires_;
+        lock.unlock();
+        
+        if (open) return open_entry();
+        if (usable(*entry, Deadline::now_us())) return entry;
+        
+        // Drop a dead or worn-out connection; its slot is reused below
+        retire(entry);
+        lock.lock();
+    }
+}
+
+void ConnectionPool::checkin(Entry* entry, bool may_park) {
+    int64_t now = Deadline::now_us();
+    bool keep = entry->conn->is_connected() && !expired(*entry, now);
+    if (!keep) {
+        retire(entry);
+        return;
+    }
+    entry->returned_us = now;
+    if (may_park && park(entry)) return;
+    
+    TimedLock lock(*this);
+    --active_;
+    hand_over(entry);
+}
+
+ConnectionPool::Entry* ConnectionPool::take_parked() {
+    if (config_.thread_cache_size == 0) return nullptr;
+    ThreadCache* cache = local_cache(false);
+    if (!cache) return nullptr;
+    
+    while (!cache->entries.empty()) {
+        std::shared_ptr<Entry> entry = std::move(cache->entries.back());
+        cache->entries.pop_back();
+        // Fails if another thread stole it since
+        int parked = PARKED;
+        if (entry->state.compare_exchange_strong(parked, LEASED)) {
+            ++active_;
+            ++fast_acquires_;
+            return entry.get();
+        }
+    }
     return nullptr;
 }
 
-void ConnectionPool::release(std::shared_ptr<Connection> conn) {
-    std::lock_guard<std::mutex> lock(mutex_);
+bool ConnectionPool::park(Entry* entry) {
+    if (config_.thread_cache_size == 0 || waiting_ > 0) return false;
+    ThreadCache* cache = local_cache(true);
+    if (cache->entries.size() >= config_.thread_cache_size) return false;
+    
+    cache->entries.push_back(entry->shared_from_this());
+    --active_;
+    entry->state = PARKED;
+    
+    // A borrower may have announced itself before seeing the entry parked.
+    // Both sides use sequentially consistent atomics, so one of them sees
+    // the other; take the connection back and hand it over under the lock.
+    if (waiting_ > 0) {
+        int parked = PARKED;
+        if (entry->state.compare_exchange_strong(parked, LEASED)) {
+            ++active_;
+            cache->entries.pop_back();
+            return false;
+        }
+    }
+    ++fast_releases_;
+    return true;
+}
+
+ConnectionPool::Entry* ConnectionPool::steal() {
+    // Only reached when no shared connection is idle; entries_ is at most max_connections long
+    for (auto& pair : entries_) {
+        int parked = PARKED;
+        if (pair.second->state.compare_exchange_strong(parked, LEASED)) {
+            ++active_;
+            return pair.second.get();
+        }
+    }
+    return nullptr;
+}
+
+ConnectionPool::Entry* ConnectionPool::open_entry() {
+    // The caller reserved a slot in opening_
+    std::shared_ptr<Connection> conn;
+    try {
+        conn = factory_(config_.connection_string);
+    } catch (const std::exception& e) {
+        crest_log_error((std::string("Database connection failed: ") + e.what()).c_str());
+    }
+    if (conn && !conn->is_connected()) conn = nullptr;
     
-    auto it = std::find(active_.begin(), active_.end(), conn);
-    if (it != active_.end()) {
-        active_.erase(it);
-        available_.push_back(conn);
+    TimedLock lock(*this);
+    --opening_;
+    if (!conn) {
+        pass_on_slot();
+        return nullptr;
+    }
+    auto entry = std::make_shared<Entry>();
+    entry->conn = std::move(conn);
+    entry->created_us = entry->returned_us = Deadline::now_us();
+    ++active_;
+    entries_[entry->conn.get()] = entry;
+    return entry.get();
+}
+
+bool ConnectionPool::usable(const Entry& entry, int64_t now_us) {
+    if (expired(entry, now_us)) return false;
+    if (config_.idle_check_seconds < 0 || now_us - entry.returned_us < seconds_to_us(config_.idle_check_seconds)) {
+        return true;
+    }
+    try {
+        return config_.health_check ? config_.health_check(*entry.conn) : entry.conn->is_connected();
+    } catch (...) {
+        return false;
     }
 }
 
+bool ConnectionPool::expired(const Entry& entry, int64_t now_us) const {
+    return config_.max_lifetime_seconds > 0 && now_us - entry.created_us >= seconds_to_us(config_.max_lifetime_seconds);
+}
+
+void ConnectionPool::retire(Entry* entry) {
+    // entry must be leased by the caller
+    std::shared_ptr<Connection> closed = entry->conn;
+    {
+        TimedLock lock(*this);
+        --active_;
+        entry->state = RETIRED;
+        entries_.erase(closed.get());
+        pass_on_slot();
+    }
+    closed->disconnect();
+}
+
+void ConnectionPool::hand_over(Entry* entry) {
+    if (waiters_.empty()) {
+        entry->state = SHARED;
+        idle_.push_back(entry);
+        return;
+    }
+    // Straight to the longest waiter, so late arrivals cannot barge ahead
+    Waiter* waiter = waiters_.front();
+    waiters_.pop_front();
+    entry->state = LEASED;
+    ++active_;
+    waiter->entry = entry;
+    waiter->cv.notify_one();
+}
+
+void ConnectionPool::pass_on_slot() {
+    // A slot came free: let the longest waiter open a connection in it
+    if (waiters_.empty() || !factory_ || entries_.size() + opening_ >= config_.max_connections) return;
+    Waiter* waiter = waiters_.front();
+    waiters_.pop_front();
+    ++opening_;
+    waiter->may_open = true;
+    waiter->cv.notify_one();
+}
+
+void ConnectionPool::warm_up() {
+    if (!factory_) return;
+    size_t target = std::min(config_.min_connections, config_.max_connections);
+    while (true) {
+        {
+            TimedLock lock(*this);
+            if (entries_.size() + opening_ >= target) return;
+            ++opening_;
+        }
+        Entry* entry = open_entry();
+        if (!entry) {
+            crest_log_warning("Database pool could not open min_connections; it will retry on demand");
+            return;
+        }
+        checkin(entry, false);
+    }
+}
+
+void ConnectionPool::maintain() {
+    int64_t now = Deadline::now_us();
+    std::vector<Entry*> taken;
+    {
+        TimedLock lock(*this);
+        auto due = [&](const Entry& entry) {
+            return expired(entry, now) || (config_.idle_check_seconds >= 0 &&
+                                           now - entry.returned_us >= seconds_to_us(config_.idle_check_seconds));
+        };
+        // Leased to this call while checked, so nobody else takes them meanwhile
+        for (auto it = idle_.begin(); it != idle_.end();) {
+            if (!due(**it)) {
+                ++it;
+                continue;
+            }
+            (*it)->state = LEASED;
+            ++active_;
+            taken.push_back(*it);
+            it = idle_.erase(it);
+        }
+        // A parked entry is only read once exchanged, as its owner may be returning it
+        for (auto& pair : entries_) {
+            int parked = PARKED;
+            if (!pair.second->state.compare_exchange_strong(parked, LEASED)) continue;
+            if (due(*pair.second)) {
+                ++active_;
+                taken.push_back(pair.second.get());
+            } else {
+                pair.second->state = PARKED;
+            }
+        }
+    }
+    
+    for (Entry* entry : taken) {
+        if (usable(*entry, now)) {
+            checkin(entry, false);
+        } else {
+            retire(entry);
+        }
+    }
+    warm_up();
+}
+
+ConnectionPool::ThreadCache* ConnectionPool::local_cache(bool create) {
+    thread_local std::vector<ThreadCache> caches;
+    caches.erase(std::remove_if(caches.begin(), caches.end(), [](const ThreadCache& cache) { return cache.owner.expired(); }),
+                 caches.end());
+    for (auto& cache : caches) {
+        if (!cache.owner.owner_before(token_) && !token_.owner_before(cache.owner)) return &cache;
+    }
+    if (!create) return nullptr;
+    caches.push_back(ThreadCache{token_, {}});
+    return &caches.back();
+}
+
 size_t ConnectionPool::available_count() const {
-    std::lock_guard<std::mutex> lock(mutex_);
-    return available_.size();
+    TimedLock lock(*this);
+    size_t parked = 0;
+    for (const auto& pair : entries_) {
+        if (pair.second->state == PARKED) ++parked;
+    }
+    return idle_.size() + parked;
 }
 
 size_t ConnectionPool::active_count() const {
-    std::lock_guard<std::mutex> lock(mutex_);
-    return active_.size();
+    return active_;
+}
+
+size_t ConnectionPool::size() const {
+    TimedLock lock(*this);
+    return entries_.size();
+}
+
+ConnectionPool::Stats ConnectionPool::stats() const {
+    Stats stats;
+    stats.fast_acquires = fast_acquires_;
+    stats.locked_acquires = locked_acquires_;
+    stats.steals = steals_;
+    stats.fast_releases = fast_releases_;
+    stats.lock_acquisitions = lock_acquisitions_;
+    stats.lock_wait_ns = lock_wait_ns_;
+    stats.lock_hold_ns = lock_hold_ns_;
+    return stats;
 }
 
 QueryBuilder& QueryBuilder::select(const std::vector<std::string>& columns) {
@@ -71,6 +761,7 @@ QueryBuilder& QueryBuilder::where(const std::string& condition) {
 QueryBuilder& QueryBuilder::where(const std::string& column, const std::string& op, const Value& value) {
     conditions_.push_back(column + " " + op + " ?");
     params_.push_back(value);
+    unbound_.push_back(false);
     return *this;
 }
 
@@ -90,6 +781,7 @@ QueryBuilder& QueryBuilder::and_where(const std::string& column, const std::stri
         conditions_.push_back(column + " " + op + " ?");
     }
     params_.push_back(value);
+    unbound_.push_back(false);
     return *this;
 }
 
@@ -109,6 +801,25 @@ QueryBuilder& QueryBuilder::or_where(const std::string& column, const std::strin
         conditions_.push_back(column + " " + op + " ?");
     }
     params_.push_back(value);
+    unbound_.push_back(false);
+    return *this;
+}
+
+QueryBuilder& QueryBuilder::where(const std::string& column, const std::string& op) {
+    where(column, op, nullptr);
+    unbound_.back() = true;
+    return *this;
+}
+
+QueryBuilder& QueryBuilder::and_where(const std::string& column, const std::string& op) {
+    and_where(column, op, nullptr);
+    unbound_.back() = true;
+    return *this;
+}
+
+QueryBuilder& QueryBuilder::or_where(const std::string& column, const std::string& op) {
+    or_where(column, op, nullptr);
+    unbound_.back() = true;
     return *this;
 }
 
@@ -165,6 +876,11 @@ QueryBuilder& QueryBuilder::delete_from(const std::string& table) {
     return *this;
 }
 
+QueryBuilder& QueryBuilder::columns(const std::vector<std::string>& names) {
+    bound_columns_.insert(bound_columns_.end(), names.begin(), names.end());
+    return *this;
+}
+
 std::string QueryBuilder::build() const {
     std::ostringstream query;
     
@@ -214,16 +930,16 @@ std::string QueryBuilder::build() const {
                     if (i++ > 0) query << ", ";
                     query << pair.first;
                 }
-            }
-            query << ") VALUES (";
-            {
-                size_t i = 0;
-                for (const auto& [key, value] : data_) {
-                    (void)key; (void)value;
+                for (const auto& column : bound_columns_) {
                     if (i++ > 0) query << ", ";
-                    query << "?";
+                    query << column;
                 }
             }
+            query << ") VALUES (";
+            for (size_t i = 0; i < data_.size() + bound_columns_.size(); ++i) {
+                if (i > 0) query << ", ";
+                query << "?";
+            }
             query << ")";
             break;
             
@@ -235,6 +951,10 @@ std::string QueryBuilder::build() const {
                     if (i++ > 0) query << ", ";
                     query << pair.first << " = ?";
                 }
+                for (const auto& column : bound_columns_) {
+                    if (i++ > 0) query << ", ";
+                    query << column << " = ?";
+                }
             }
             
             if (!conditions_.empty()) {
@@ -262,6 +982,18 @@ std::string QueryBuilder::build() const {
     return query.str();
 }
 
+ResultSet QueryBuilder::execute(Connection& conn) const {
+    std::string sql = build();
+    auto stmt = conn.statement(sql);
+    return stmt ? conn.execute_prepared(*stmt, get_params()) : conn.execute(sql, get_params());
+}
+
+int QueryBuilder::execute_update(Connection& conn) const {
+    std::string sql = build();
+    auto stmt = conn.statement(sql);
+    return stmt ? conn.execute_update_prepared(*stmt, get_params()) : conn.execute_update(sql, get_params());
+}
+
 std::vector<Value> QueryBuilder::get_params() const {
     std::vector<Value> all_params;
     
@@ -269,12 +1001,47 @@ std::vector<Value> QueryBuilder::get_params() const {
         for (const auto& pair : data_) {
             all_params.push_back(pair.second);
         }
+        all_params.resize(all_params.size() + bound_columns_.size(), nullptr);
     }
     
     all_params.insert(all_params.end(), params_.begin(), params_.end());
     return all_params;
 }
 
+Query::Query(const QueryBuilder& shape) : sql_(shape.build()), params_(shape.get_params()) {
+    // Same order as get_params(): values()/set() data, bound columns, then conditions
+    size_t next = 0;
+    if (shape.type_ == QueryBuilder::INSERT || shape.type_ == QueryBuilder::UPDATE) {
+        next = shape.data_.size();
+        for (size_t i = 0; i < shape.bound_columns_.size(); ++i) holes_.push_back(next++);
+    }
+    for (size_t i = 0; i < shape.params_.size(); ++i, ++next) {
+        if (shape.unbound_[i]) holes_.push_back(next);
+    }
+}
+
+std::vector<Value> Query::bind(const std::vector<Value>& args) const {
+    if (args.size() != holes_.size()) {
+        throw std::invalid_argument("Query expects " + std::to_string(holes_.size()) + " values, got " +
+                                    std::to_string(args.size()));
+    }
+    std::vector<Value> params = params_;
+    for (size_t i = 0; i < holes_.size(); ++i) params[holes_[i]] = args[i];
+    return params;
+}
+
+ResultSet Query::execute(Connection& conn, const std::vector<Value>& args) const {
+    std::vector<Value> params = bind(args);
+    auto stmt = conn.statement(sql_);
+    return stmt ? conn.execute_prepared(*stmt, params) : conn.execute(sql_, params);
+}
+
+int Query::execute_update(Connection& conn, const std::vector<Value>& args) const {
+    std::vector<Value> params = bind(args);
+    auto stmt = conn.statement(sql_);
+    return stmt ? conn.execute_update_prepared(*stmt, params) : conn.execute_update(sql_, params);
+}
+
 bool Model::save(Connection& conn) {
     auto row = to_row();
     QueryBuilder qb;
@@ -285,7 +1052,7 @@ bool Model::save(Connection& conn) {
         qb.insert_into(table_name()).values(row);
     }
     
-    return conn.execute_update(qb.build(), qb.get_params()) > 0;
+    return qb.execute_update(conn) > 0;
 }
 
 bool Model::remove(Connection& conn) {
@@ -297,20 +1064,20 @@ bool Model::remove(Connection& conn) {
     QueryBuilder qb;
     qb.delete_from(table_name()).where(primary_key(), "=", row[primary_key()]);
     
-    return conn.execute_update(qb.build(), qb.get_params()) > 0;
+    return qb.execute_update(conn) > 0;
 }
 
 ResultSet Model::find_all(Connection& conn, const std::string& table) {
     QueryBuilder qb;
     qb.select({}).from(table);
-    return conn.execute(qb.build());
+    return qb.execute(conn);
 }
 
 Row Model::find_by_id(Connection& conn, const std::string& table, const Value& id) {
     QueryBuilder qb;
     qb.select({}).from(table).where("id", "=", id).limit(1);
-    auto results = conn.execute(qb.build(), qb.get_params());
-    return results.empty() ? Row{} : results[0];
+    auto results = qb.execute(conn);
+    return results.empty() ? Row{} : results[0].to_row();
 }
 
 } // namespace db
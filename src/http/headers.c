@@ -0,0 +1,91 @@
+/**
+ * @file headers.c
+ * @brief Key/value lists for headers and query parameters
+ */
+
+#include "crest/crest.h"
+#include "crest/internal/app_internal.h"
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+extern char* crest_strdup(const char* str);
+
+static bool key_equals(const char* a, const char* b, bool ignore_case) {
+    if (!ignore_case) return strcmp(a, b) == 0;
+    while (*a && *b) {
+        if (tolower((unsigned char)*a) != tolower((unsigned char)*b)) return false;
+        a++;
+        b++;
+    }
+    return *a == *b;
+}
+
+void crest_kv_add(crest_kv_list_t* list, const char* key, const char* value) {
+    if (!list || !key || !value) return;
+
+    if (list->count >= list->capacity) {
+        size_t new_capacity = list->capacity == 0 ? 8 : list->capacity * 2;
+        crest_kv_t* items = (crest_kv_t*)realloc(list->items, new_capacity * sizeof(crest_kv_t));
+        if (!items) return;
+        list->items = items;
+        list->capacity = new_capacity;
+    }
+
+    list->items[list->count].key = crest_strdup(key);
+    list->items[list->count].value = crest_strdup(value);
+    list->count++;
+}
+
+void crest_kv_set(crest_kv_list_t* list, const char* key, const char* value) {
+    if (!list || !key || !value) return;
+
+    for (size_t i = 0; i < list->count; i++) {
+        if (key_equals(list->items[i].key, key, true)) {
+            free(list->items[i].value);
+            list->items[i].value = crest_strdup(value);
+            return;
+        }
+    }
+
+    crest_kv_add(list, key, value);
+}
+
+const char* crest_kv_get(const crest_kv_list_t* list, const char* key, bool ignore_case) {
+    if (!list || !key) return NULL;
+
+    for (size_t i = 0; i < list->count; i++) {
+        if (key_equals(list->items[i].key, key, ignore_case)) {
+            return list->items[i].value;
+        }
+    }
+    return NULL;
+}
+
+void crest_kv_remove(crest_kv_list_t* list, const char* key) {
+    if (!list || !key) return;
+
+    size_t kept = 0;
+    for (size_t i = 0; i < list->count; i++) {
+        if (key_equals(list->items[i].key, key, true)) {
+            free(list->items[i].key);
+            free(list->items[i].value);
+        } else {
+            list->items[kept++] = list->items[i];
+        }
+    }
+    list->count = kept;
+}
+
+void crest_kv_free(crest_kv_list_t* list) {
+    if (!list) return;
+
+    for (size_t i = 0; i < list->count; i++) {
+        free(list->items[i].key);
+        free(list->items[i].value);
+    }
+    free(list->items);
+    list->items = NULL;
+    list->count = 0;
+    list->capacity = 0;
+}
@@ -5,8 +5,12 @@
 
 #include "crest/crest.h"
 #include "crest/internal/app_internal.h"
+#include <ctype.h>
+#include <stdlib.h>
 #include <string.h>
 
+extern char* crest_strdup(const char* str);
+
 const char* crest_request_get_path(crest_request_t* req) {
     return req ? req->path : NULL;
 }
@@ -20,13 +24,97 @@ const char* crest_request_get_body(crest_request_t* req) {
 }
 
 const char* crest_request_get_query(crest_request_t* req, const char* key) {
-    if (!req || !key || !req->queries) return NULL;
-    // Implementation would use a hash map
-    return NULL;
+    if (!req || !key) return NULL;
+    return crest_kv_get(&req->queries, key, false);
 }
 
 const char* crest_request_get_header(crest_request_t* req, const char* key) {
-    if (!req || !key || !req->headers) return NULL;
-    // Implementation would use a hash map
-    return NULL;
+    if (!req || !key) return NULL;
+    return crest_kv_get(&req->headers, key, true);
+}
+
+static bool is_cookie_header(const char* name) {
+    static const char expected[] = "cookie";
+    size_t i = 0;
+    for (; name[i] && i < sizeof(expected) - 1; i++) {
+        if (tolower((unsigned char)name[i]) != expected[i]) return false;
+    }
+    return name[i] == '\0' && i == sizeof(expected) - 1;
+}
+
+static bool is_cookie_space(char c) {
+    return c == ' ' || c == '\t';
+}
+
+/* "a=1; b=2" -> (a, 1), (b, 2); pairs without '=' or with an empty name are skipped */
+static void parse_cookie_header(crest_kv_list_t* cookies, const char* header) {
+    char* buffer = crest_strdup(header);
+    if (!buffer) return;
+
+    char* cursor = buffer;
+    while (*cursor) {
+        char* pair = cursor;
+        char* end = strchr(pair, ';');
+        if (end) {
+            *end = '\0';
+            cursor = end + 1;
+        } else {
+            cursor = pair + strlen(pair);
+        }
+
+        char* eq = strchr(pair, '=');
+        if (!eq) continue;
+        *eq = '\0';
+        char* name = pair;
+        char* value = eq + 1;
+
+        while (is_cookie_space(*name)) name++;
+        char* name_end = name + strlen(name);
+        while (name_end > name && is_cookie_space(name_end[-1])) *--name_end = '\0';
+        while (is_cookie_space(*value)) value++;
+        char* value_end = value + strlen(value);
+        while (value_end > value && is_cookie_space(value_end[-1])) *--value_end = '\0';
+        if (value_end - value >= 2 && value[0] == '"' && value_end[-1] == '"') {
+            value_end[-1] = '\0';
+            value++;
+        }
+
+        if (*name) crest_kv_add(cookies, name, value);
+    }
+    free(buffer);
+}
+
+const crest_kv_list_t* crest_request_cookies(crest_request_t* req) {
+    if (!req->cookies_parsed) {
+        req->cookies_parsed = true;
+        for (size_t i = 0; i < req->headers.count; i++) {
+            if (is_cookie_header(req->headers.items[i].key)) {
+                parse_cookie_header(&req->cookies, req->headers.items[i].value);
+            }
+        }
+    }
+    return &req->cookies;
+}
+
+const char* crest_request_get_cookie(crest_request_t* req, const char* name) {
+    if (!req || !name) return NULL;
+    /* The first occurrence wins: browsers send the most specific path first */
+    return crest_kv_get(crest_request_cookies(req), name, false);
+}
+
+const char* crest_request_get_remote_addr(crest_request_t* req) {
+    return req ? req->remote_addr : NULL;
+}
+
+void crest_request_free(crest_request_t* req) {
+    if (!req) return;
+
+    free(req->method);
+    free(req->path);
+    free(req->body);
+    free(req->query_string);
+    crest_kv_free(&req->headers);
+    crest_kv_free(&req->queries);
+    crest_kv_free(&req->cookies);
+    req->cookies_parsed = false;
 }
@@ -8,62 +8,192 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <ctype.h>
 
-void crest_response_json(crest_response_t* res, int status, const char* json) {
+static const char* status_text(int status) {
+    switch (status) {
+        case 200: return "OK";
+        case 201: return "Created";
+        case 202: return "Accepted";
+        case 204: return "No Content";
+        case 301: return "Moved Permanently";
+        case 302: return "Found";
+        case 304: return "Not Modified";
+        case 400: return "Bad Request";
+        case 401: return "Unauthorized";
+        case 403: return "Forbidden";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 409: return "Conflict";
+        case 422: return "Unprocessable Entity";
+        case 429: return "Too Many Requests";
+        case 500: return "Internal Server Error";
+        case 501: return "Not Implemented";
+        case 503: return "Service Unavailable";
+        case 504: return "Gateway Timeout";
+        default: return "OK";
+    }
+}
+
+/* Headers the serializer writes itself; user copies are ignored */
+static bool is_framed_header(const char* key) {
+    static const char* framed[] = { "Content-Type", "Content-Length", "Connection" };
+    for (size_t i = 0; i < sizeof(framed) / sizeof(framed[0]); i++) {
+        const char* a = key;
+        const char* b = framed[i];
+        while (*a && *b && tolower((unsigned char)*a) == tolower((unsigned char)*b)) {
+            a++;
+            b++;
+        }
+        if (*a == '\0' && *b == '\0') return true;
+    }
+    return false;
+}
+
+static void send_payload(crest_response_t* res, int status, const char* content_type, const char* payload) {
     if (!res || res->sent) return;
-    
+
     res->status = status;
-    free(res->body);
-    
-    size_t len = strlen(json) + 256;
-    res->body = (char*)malloc(len);
-    snprintf(res->body, len,
-        "HTTP/1.1 %d OK\r\n"
-        "Content-Type: application/json\r\n"
-        "Content-Length: %zu\r\n"
-        "Connection: close\r\n"
-        "\r\n%s", status, strlen(json), json);
-    
+    res->content_type = content_type;
+    crest_response_set_body(res, payload, payload ? strlen(payload) : 0);
     res->sent = true;
 }
 
+void crest_response_json(crest_response_t* res, int status, const char* json) {
+    send_payload(res, status, "application/json", json);
+}
+
 void crest_response_text(crest_response_t* res, int status, const char* text) {
-    if (!res || res->sent) return;
-    
-    res->status = status;
-    free(res->body);
-    
-    size_t len = strlen(text) + 256;
-    res->body = (char*)malloc(len);
-    snprintf(res->body, len,
-        "HTTP/1.1 %d OK\r\n"
-        "Content-Type: text/plain\r\n"
-        "Content-Length: %zu\r\n"
-        "Connection: close\r\n"
-        "\r\n%s", status, strlen(text), text);
-    
-    res->sent = true;
+    send_payload(res, status, "text/plain", text);
 }
 
 void crest_response_html(crest_response_t* res, int status, const char* html) {
-    if (!res || res->sent) return;
-    
-    res->status = status;
-    free(res->body);
-    
-    size_t len = strlen(html) + 256;
-    res->body = (char*)malloc(len);
-    snprintf(res->body, len,
-        "HTTP/1.1 %d OK\r\n"
-        "Content-Type: text/html; charset=utf-8\r\n"
-        "Content-Length: %zu\r\n"
-        "Connection: close\r\n"
-        "\r\n%s", status, strlen(html), html);
-    
-    res->sent = true;
+    send_payload(res, status, "text/html; charset=utf-8", html);
 }
 
 void crest_response_set_header(crest_response_t* res, const char* key, const char* value) {
     if (!res || !key || !value) return;
-    // Implementation would use a hash map
+    crest_kv_set(&res->headers, key, value);
+}
+
+void crest_response_set_body(crest_response_t* res, const char* data, size_t length) {
+    if (!res) return;
+
+    char* body = (char*)malloc(length + 1);
+    if (!body) return;
+    if (length > 0) memcpy(body, data, length);
+    body[length] = '\0';
+
+    free(res->body);
+    res->body = body;
+    res->body_length = length;
+}
+
+void crest_response_append_raw_headers(crest_response_t* res, const char* data, size_t length) {
+    if (!res || !data || length == 0) return;
+
+    char* block = (char*)realloc(res->raw_headers, res->raw_headers_length + length);
+    if (!block) return;
+    memcpy(block + res->raw_headers_length, data, length);
+    res->raw_headers = block;
+    res->raw_headers_length += length;
+}
+
+char* crest_response_serialize(const crest_response_t* res, size_t* length) {
+    if (!res || !length) return NULL;
+
+    const char* content_type = crest_kv_get(&res->headers, "Content-Type", true);
+    if (!content_type) content_type = res->content_type ? res->content_type : "text/plain";
+
+    size_t header_size = 256 + strlen(content_type) + res->raw_headers_length;
+    for (size_t i = 0; i < res->headers.count; i++) {
+        header_size += strlen(res->headers.items[i].key) + strlen(res->headers.items[i].value) + 4;
+    }
+
+    char* out = (char*)malloc(header_size + res->body_length + 1);
+    if (!out) return NULL;
+
+    /* 1xx, 204 and 304 responses carry no body and no framing for one */
+    bool bodiless = (res->status >= 100 && res->status < 200) || res->status == 204 || res->status == 304;
+
+    int written;
+    if (bodiless) {
+        written = snprintf(out, header_size, "HTTP/1.1 %d %s\r\n", res->status, status_text(res->status));
+    } else {
+        written = snprintf(out, header_size,
+            "HTTP/1.1 %d %s\r\n"
+            "Content-Type: %s\r\n"
+            "Content-Length: %zu\r\n",
+            res->status, status_text(res->status), content_type, res->body_length);
+    }
+    size_t pos = written > 0 ? (size_t)written : 0;
+
+    for (size_t i = 0; i < res->headers.count; i++) {
+        const crest_kv_t* h = &res->headers.items[i];
+        if (is_framed_header(h->key)) continue;
+        written = snprintf(out + pos, header_size - pos, "%s: %s\r\n", h->key, h->value);
+        if (written > 0) pos += (size_t)written;
+    }
+
+    if (res->raw_headers_length > 0) {
+        memcpy(out + pos, res->raw_headers, res->raw_headers_length);
+        pos += res->raw_headers_length;
+    }
+
+    written = snprintf(out + pos, header_size - pos, "Connection: close\r\n\r\n");
+    if (written > 0) pos += (size_t)written;
+
+    if (!bodiless && res->body_length > 0) {
+        memcpy(out + pos, res->body, res->body_length);
+        pos += res->body_length;
+    }
+    out[pos] = '\0';
+
+    *length = pos;
+    return out;
+}
+
+bool crest_response_add_deferred(crest_response_t* res, void (*fn)(void*), void* arg, void (*cleanup)(void*)) {
+    if (!res || !fn) {
+        if (cleanup) cleanup(arg);
+        return false;
+    }
+
+    if (res->deferred_count >= res->deferred_capacity) {
+        size_t new_capacity = res->deferred_capacity == 0 ? 4 : res->deferred_capacity * 2;
+        crest_deferred_t* items = (crest_deferred_t*)realloc(res->deferred, new_capacity * sizeof(crest_deferred_t));
+        if (!items) {
+            if (cleanup) cleanup(arg);
+            return false;
+        }
+        res->deferred = items;
+        res->deferred_capacity = new_capacity;
+    }
+
+    res->deferred[res->deferred_count].fn = fn;
+    res->deferred[res->deferred_count].arg = arg;
+    res->deferred[res->deferred_count].cleanup = cleanup;
+    res->deferred_count++;
+    return true;
+}
+
+void crest_response_free(crest_response_t* res) {
+    if (!res) return;
+
+    /* Deferred work that was never handed to the background queue is dropped */
+    for (size_t i = 0; i < res->deferred_count; i++) {
+        if (res->deferred[i].cleanup) res->deferred[i].cleanup(res->deferred[i].arg);
+    }
+    free(res->deferred);
+    res->deferred = NULL;
+    res->deferred_count = 0;
+    res->deferred_capacity = 0;
+
+    free(res->body);
+    res->body = NULL;
+    res->body_length = 0;
+    free(res->raw_headers);
+    res->raw_headers = NULL;
+    res->raw_headers_length = 0;
+    crest_kv_free(&res->headers);
 }
@@ -0,0 +1,142 @@
+/**
+ * @file coalesce.cpp
+ * @brief Request coalescing (singleflight) middleware
+ */
+
+#include "crest/middleware.hpp"
+#include "crest/internal/app_internal.h"
+#include "crest/internal/pipeline.hpp"
+#include "crest/internal/response_capture.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+
+namespace crest {
+
+using internal::CapturedResponse;
+
+struct CoalesceMiddleware::Flight {
+    std::mutex mutex;
+    std::condition_variable done_cv;
+    bool done = false;
+    // What the leader's chain added to its response, shared read-only with waiters
+    std::shared_ptr<const CapturedResponse> result;
+};
+
+CoalesceMiddleware::CoalesceMiddleware(const Options& opts) : options_(opts) {}
+
+CoalesceMiddleware::~CoalesceMiddleware() = default;
+
+std::string CoalesceMiddleware::key_for(const crest_request_t* req) const {
+    std::string key = req->method;
+    key += ' ';
+    key += req->path;
+    // Unit separators keep "a=b" + "c" distinct from "a=bc"
+    for (const auto& name : options_.query_keys) {
+        const char* value = crest_kv_get(&req->queries, name.c_str(), false);
+        key += '\x1f';
+        if (value) key += value;
+    }
+    for (const auto& name : options_.header_keys) {
+        const char* value = crest_kv_get(&req->headers, name.c_str(), true);
+        key += '\x1e';
+        if (value) key += value;
+    }
+    return key;
+}
+
+size_t CoalesceMiddleware::in_flight() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return flights_.size();
+}
+
+void CoalesceMiddleware::handle(Request& req, Response& res, NextFunction next) {
+    crest_request_t* raw_req = req.raw();
+    if (!raw_req->method || (strcmp(raw_req->method, "GET") != 0 && strcmp(raw_req->method, "HEAD") != 0)) {
+        next();
+        return;
+    }
+
+    std::string key = key_for(raw_req);
+    std::shared_ptr<Flight> flight;
+    bool leader = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = flights_.find(key);
+        if (it == flights_.end()) {
+            flight = std::make_shared<Flight>();
+            flights_.emplace(key, flight);
+            leader = true;
+        } else {
+            flight = it->second;
+        }
+    }
+
+    crest_response_t* raw = res.raw();
+
+    if (leader) {
+        // Remove the flight and wake waiters
+        auto land = [this, key, flight](std::shared_ptr<const CapturedResponse> result) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                flights_.erase(key);
+            }
+            {
+                std::lock_guard<std::mutex> lock(flight->mutex);
+                flight->result = std::move(result);
+                flight->done = true;
+            }
+            flight->done_cv.notify_all();
+        };
+
+        // Lands the flight even if the handler throws, unless the response finishes later
+        struct Finish {
+            const decltype(land)& fn;
+            bool handed_off = false;
+            ~Finish() {
+                if (!handed_off) fn(nullptr);
+            }
+        } finish{land};
+
+        CapturedResponse::Mark mark = CapturedResponse::mark(raw);
+
+        next();
+
+        if (raw->sent) {
+            finish.handed_off = true;
+            land(raw->status < 500 ? std::make_shared<const CapturedResponse>(CapturedResponse::capture(raw, mark)) : nullptr);
+            return;
+        }
+        // A suspended coroutine handler responds after next() returns; waiters
+        // share that response once it is finished
+        finish.handed_off = internal::when_released(raw, [land, raw, mark](bool delivered) {
+            land(delivered && raw->status < 500
+                     ? std::make_shared<const CapturedResponse>(CapturedResponse::capture(raw, mark))
+                     : nullptr);
+        });
+        return;
+    }
+
+    std::shared_ptr<const CapturedResponse> result;
+    {
+        std::unique_lock<std::mutex> lock(flight->mutex);
+        bool finished = flight->done_cv.wait_for(lock, std::chrono::milliseconds(options_.timeout_ms),
+                                                 [&] { return flight->done; });
+        if (!finished) {
+            lock.unlock();
+            res.json(504, "{\"error\":\"Timed out waiting for an identical request\"}");
+            return;
+        }
+        result = flight->result;
+    }
+
+    if (!result) {
+        // The leader failed; failures are not shared, so try on our own
+        next();
+        return;
+    }
+
+    result->replay(raw);
+}
+
+} // namespace crest
@@ -0,0 +1,489 @@
+/**
+ * @file compression.cpp
+ * @brief gzip/deflate compression backed by zlib, brotli backed by libbrotli
+ */
+
+#include "crest/compression.hpp"
+#include "crest/middleware.hpp"
+#include "crest/internal/app_internal.h"
+#include "../utils/thread_pool.hpp"
+#include "../utils/hash.hpp"
+#include <atomic>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <shared_mutex>
+#include <future>
+#include <unordered_map>
+
+#ifdef CREST_HAS_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef CREST_HAS_BROTLI
+#include <brotli/encode.h>
+#endif
+
+namespace crest {
+
+const char* encoding_name(Encoding encoding) {
+    switch (encoding) {
+        case Encoding::GZIP: return "gzip";
+        case Encoding::DEFLATE: return "deflate";
+        case Encoding::BROTLI: return "br";
+        default: return "identity";
+    }
+}
+
+Encoding negotiate_encoding(const std::string& accept_encoding) {
+    // Server preference when the client weights several encodings equally
+    static const Encoding preference[] = { Encoding::BROTLI, Encoding::GZIP, Encoding::DEFLATE };
+    auto rank = [](Encoding e) {
+        for (size_t i = 0; i < 3; ++i) {
+            if (preference[i] == e) return i;
+        }
+        return (size_t)3;
+    };
+
+    Encoding best = Encoding::IDENTITY;
+    double best_q = 0.0;
+    auto consider = [&](Encoding candidate, double q) {
+        if (q <= 0.0 || !Compressor::supports(candidate)) return;
+        if (q > best_q || (q == best_q && rank(candidate) < rank(best))) {
+            best = candidate;
+            best_q = q;
+        }
+    };
+
+    size_t pos = 0;
+    while (pos < accept_encoding.size()) {
+        size_t end = accept_encoding.find(',', pos);
+        if (end == std::string::npos) end = accept_encoding.size();
+
+        std::string token = accept_encoding.substr(pos, end - pos);
+        pos = end + 1;
+
+        double q = 1.0;
+        size_t semi = token.find(';');
+        if (semi != std::string::npos) {
+            size_t qpos = token.find("q=", semi);
+            if (qpos != std::string::npos) q = std::atof(token.c_str() + qpos + 2);
+            token.resize(semi);
+        }
+
+        size_t first = token.find_first_not_of(" \t");
+        size_t last = token.find_last_not_of(" \t");
+        if (first == std::string::npos) continue;
+        token = token.substr(first, last - first + 1);
+        for (auto& c : token) c = (char)std::tolower((unsigned char)c);
+
+        if (token == "*") {
+            for (Encoding candidate : preference) consider(candidate, q);
+        } else if (token == "br") {
+            consider(Encoding::BROTLI, q);
+        } else if (token == "gzip" || token == "x-gzip") {
+            consider(Encoding::GZIP, q);
+        } else if (token == "deflate") {
+            consider(Encoding::DEFLATE, q);
+        }
+    }
+
+    return best;
+}
+
+struct Compressor::State {
+#ifdef CREST_HAS_ZLIB
+    z_stream zlib{};
+#endif
+#ifdef CREST_HAS_BROTLI
+    BrotliEncoderState* brotli = nullptr;
+#endif
+    bool ready = false;
+};
+
+#ifdef CREST_HAS_ZLIB
+static bool run_deflate(z_stream& stream, const char* data, size_t length, int flush, std::string& out) {
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    stream.avail_in = static_cast<uInt>(length);
+
+    int rc;
+    do {
+        size_t used = out.size();
+        size_t chunk = deflateBound(&stream, stream.avail_in) + 64;
+        out.resize(used + chunk);
+        stream.next_out = reinterpret_cast<Bytef*>(&out[used]);
+        stream.avail_out = static_cast<uInt>(chunk);
+
+        rc = deflate(&stream, flush);
+        out.resize(used + chunk - stream.avail_out);
+
+        if (rc == Z_STREAM_ERROR) return false;
+    } while (stream.avail_out == 0 || (flush == Z_FINISH && rc != Z_STREAM_END));
+
+    return true;
+}
+#endif
+
+#ifdef CREST_HAS_BROTLI
+static BrotliEncoderState* create_brotli(int level) {
+    BrotliEncoderState* state = BrotliEncoderCreateInstance(nullptr, nullptr, nullptr);
+    if (state) {
+        BrotliEncoderSetParameter(state, BROTLI_PARAM_QUALITY, (uint32_t)level);
+        BrotliEncoderSetParameter(state, BROTLI_PARAM_MODE, BROTLI_MODE_TEXT);
+    }
+    return state;
+}
+
+static bool run_brotli(BrotliEncoderState* state, const char* data, size_t length,
+                       BrotliEncoderOperation op, std::string& out) {
+    size_t avail_in = length;
+    const uint8_t* next_in = reinterpret_cast<const uint8_t*>(data);
+
+    do {
+        size_t used = out.size();
+        size_t chunk = BrotliEncoderMaxCompressedSize(avail_in) + 1024;
+        out.resize(used + chunk);
+        size_t avail_out = chunk;
+        uint8_t* next_out = reinterpret_cast<uint8_t*>(&out[used]);
+
+        if (!BrotliEncoderCompressStream(state, op, &avail_in, &next_in, &avail_out, &next_out, nullptr)) {
+            out.resize(used);
+            return false;
+        }
+        out.resize(used + chunk - avail_out);
+    } while (avail_in > 0 || BrotliEncoderHasMoreOutput(state) ||
+             (op == BROTLI_OPERATION_FINISH && !BrotliEncoderIsFinished(state)));
+
+    return true;
+}
+#endif
+
+Compressor::Compressor(Encoding encoding, int level)
+    : state_(std::make_unique<State>()), encoding_(encoding), level_(level) {
+    switch (encoding) {
+#ifdef CREST_HAS_ZLIB
+        case Encoding::GZIP:
+        case Encoding::DEFLATE: {
+            // windowBits + 16 selects the gzip wrapper, plain windowBits the zlib one
+            int window_bits = encoding == Encoding::GZIP ? 15 + 16 : 15;
+            state_->ready = deflateInit2(&state_->zlib, level, Z_DEFLATED, window_bits, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+            break;
+        }
+#endif
+#ifdef CREST_HAS_BROTLI
+        case Encoding::BROTLI:
+            state_->brotli = create_brotli(level);
+            state_->ready = state_->brotli != nullptr;
+            break;
+#endif
+        default:
+            break;
+    }
+}
+
+Compressor::~Compressor() {
+    if (!state_->ready) return;
+#ifdef CREST_HAS_ZLIB
+    if (encoding_ == Encoding::GZIP || encoding_ == Encoding::DEFLATE) deflateEnd(&state_->zlib);
+#endif
+#ifdef CREST_HAS_BROTLI
+    if (encoding_ == Encoding::BROTLI) BrotliEncoderDestroyInstance(state_->brotli);
+#endif
+}
+
+bool Compressor::available() {
+    return supports(Encoding::GZIP);
+}
+
+bool Compressor::supports(Encoding encoding) {
+    switch (encoding) {
+#ifdef CREST_HAS_ZLIB
+        case Encoding::GZIP:
+        case Encoding::DEFLATE:
+            return true;
+#endif
+#ifdef CREST_HAS_BROTLI
+        case Encoding::BROTLI:
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+bool Compressor::write(const char* data, size_t length, std::string& out, bool flush) {
+    if (!state_->ready) return false;
+#ifdef CREST_HAS_ZLIB
+    if (encoding_ != Encoding::BROTLI) {
+        return run_deflate(state_->zlib, data, length, flush ? Z_SYNC_FLUSH : Z_NO_FLUSH, out);
+    }
+#endif
+#ifdef CREST_HAS_BROTLI
+    if (encoding_ == Encoding::BROTLI) {
+        return run_brotli(state_->brotli, data, length,
+                          flush ? BROTLI_OPERATION_FLUSH : BROTLI_OPERATION_PROCESS, out);
+    }
+#endif
+    (void)data; (void)length; (void)out; (void)flush;
+    return false;
+}
+
+bool Compressor::finish(std::string& out) {
+    if (!state_->ready) return false;
+#ifdef CREST_HAS_ZLIB
+    if (encoding_ != Encoding::BROTLI) {
+        return run_deflate(state_->zlib, nullptr, 0, Z_FINISH, out);
+    }
+#endif
+#ifdef CREST_HAS_BROTLI
+    if (encoding_ == Encoding::BROTLI) {
+        return run_brotli(state_->brotli, nullptr, 0, BROTLI_OPERATION_FINISH, out);
+    }
+#endif
+    (void)out;
+    return false;
+}
+
+void Compressor::reset() {
+    if (!state_->ready) return;
+#ifdef CREST_HAS_ZLIB
+    if (encoding_ != Encoding::BROTLI) deflateReset(&state_->zlib);
+#endif
+#ifdef CREST_HAS_BROTLI
+    // Brotli has no reset; a finished encoder has to be replaced
+    if (encoding_ == Encoding::BROTLI) {
+        BrotliEncoderDestroyInstance(state_->brotli);
+        state_->brotli = create_brotli(level_);
+        state_->ready = state_->brotli != nullptr;
+    }
+#endif
+}
+
+bool Compressor::compress(const char* data, size_t length, std::string& out) {
+    if (!state_->ready) return false;
+    reset();
+    bool ok = write(data, length, out) && finish(out);
+    reset();
+    return ok;
+}
+
+Compressor& Compressor::local(Encoding encoding, int level) {
+    thread_local std::vector<std::unique_ptr<Compressor>> compressors;
+
+    for (auto& compressor : compressors) {
+        if (compressor->encoding_ == encoding && compressor->level_ == level) {
+            return *compressor;
+        }
+    }
+
+    compressors.push_back(std::make_unique<Compressor>(encoding, level));
+    return *compressors.back();
+}
+
+struct CompressionMiddleware::VariantStore {
+    struct Variants {
+        uint64_t tag = 0;
+        bool ready = false;
+        size_t bytes = 0;
+        std::shared_ptr<const std::string> variants[4];
+    };
+    
+    struct Entry {
+        Variants data;
+        // Epoch of the last hit; hits only read the clock, so the shared
+        // lock stays enough on the hot path
+        std::atomic<uint64_t> last_used{0};
+    };
+    
+    // Drop the least recently used key; called with mutex held exclusively
+    void evict_one() {
+        auto victim = entries.end();
+        uint64_t oldest = UINT64_MAX;
+        for (auto it = entries.begin(); it != entries.end(); ++it) {
+            uint64_t used = it->second.last_used.load(std::memory_order_relaxed);
+            if (used < oldest) {
+                oldest = used;
+                victim = it;
+            }
+        }
+        if (victim == entries.end()) return;
+        bytes -= victim->second.data.bytes;
+        entries.erase(victim);
+    }
+    
+    mutable std::shared_mutex mutex;
+    std::unordered_map<std::string, Entry> entries;
+    size_t bytes = 0;
+    size_t pending = 0;
+    // Advances whenever a key is added
+    std::atomic<uint64_t> clock{1};
+    
+    // Declared last so pending builds finish before the entries go away
+    ThreadPool builder{1};
+};
+
+CompressionMiddleware::CompressionMiddleware(const Options& opts)
+    : options_(opts), variants_(opts.precompress ? std::make_unique<VariantStore>() : nullptr) {}
+
+CompressionMiddleware::~CompressionMiddleware() = default;
+
+bool CompressionMiddleware::is_compressible(const char* content_type) const {
+    if (!content_type) return false;
+    for (const auto& allowed : options_.content_types) {
+        if (strncmp(content_type, allowed.c_str(), allowed.size()) == 0) return true;
+    }
+    return false;
+}
+
+// A strong ETag would promise byte-identical bodies across encodings
+static void weaken_etag(crest_response_t* raw) {
+    const char* etag = crest_kv_get(&raw->headers, "ETag", true);
+    if (etag && strncmp(etag, "W/", 2) != 0) {
+        crest_response_set_header(raw, "ETag", ("W/" + std::string(etag)).c_str());
+    }
+}
+
+bool CompressionMiddleware::serve_variant(Request& req, crest_response_t* raw, Encoding encoding) {
+    if (raw->status != 200) return false;
+    const char* cache_control = crest_kv_get(&raw->headers, "Cache-Control", true);
+    if (cache_control && (strstr(cache_control, "no-store") || strstr(cache_control, "private"))) return false;
+    
+    // Handlers that set an ETag spare us hashing the body
+    const char* etag = crest_kv_get(&raw->headers, "ETag", true);
+    uint64_t tag = etag ? hash_bytes(etag, strlen(etag), 1) : hash_bytes(raw->body, raw->body_length);
+    // Bodies may vary by query string, so it is part of the key
+    std::string key = req.method() + " " + req.path();
+    const char* query = req.raw()->query_string;
+    if (query && *query) key.append("?").append(query);
+    
+    VariantStore& store = *variants_;
+    {
+        std::shared_lock<std::shared_mutex> lock(store.mutex);
+        auto it = store.entries.find(key);
+        if (it != store.entries.end() && it->second.data.tag == tag) {
+            uint64_t now = store.clock.load(std::memory_order_relaxed);
+            if (it->second.last_used.load(std::memory_order_relaxed) != now) {
+                it->second.last_used.store(now, std::memory_order_relaxed);
+            }
+            if (!it->second.data.ready) return false;
+            if (encoding == Encoding::IDENTITY) return true;
+            
+            const auto& variant = it->second.data.variants[static_cast<int>(encoding)];
+            if (!variant) return false;
+            crest_response_set_body(raw, variant->data(), variant->size());
+            crest_response_set_header(raw, "Content-Encoding", encoding_name(encoding));
+            weaken_etag(raw);
+            return true;
+        }
+    }
+    
+    // First sighting of this route/tag: build the variants off the hot path
+    {
+        std::unique_lock<std::shared_mutex> lock(store.mutex);
+        auto it = store.entries.find(key);
+        if (it != store.entries.end() && it->second.data.tag == tag) return false;  // Another request already queued it
+        // A full queue skips the build; a later request for the key tries again
+        if (store.pending >= options_.max_pending_builds) return false;
+        if (it == store.entries.end()) {
+            if (options_.max_variant_entries == 0) return false;
+            if (store.entries.size() >= options_.max_variant_entries) store.evict_one();
+            it = store.entries.try_emplace(key).first;
+        }
+        store.bytes -= it->second.data.bytes;
+        it->second.data = VariantStore::Variants{};
+        it->second.data.tag = tag;
+        // Hits from now on stamp a later epoch than this insertion
+        it->second.last_used.store(store.clock.fetch_add(1, std::memory_order_relaxed), std::memory_order_relaxed);
+        ++store.pending;
+    }
+    
+    auto body = std::make_shared<const std::string>(raw->body, raw->body_length);
+    store.builder.enqueue([this, key, tag, body]() {
+        VariantStore& store = *variants_;
+        VariantStore::Variants built;
+        built.tag = tag;
+        built.ready = true;
+        built.variants[static_cast<int>(Encoding::IDENTITY)] = body;
+        built.bytes = body->size();
+        
+        // Built once per tag, so spend the CPU on the best ratio
+        const std::pair<Encoding, int> targets[] = { {Encoding::BROTLI, 11}, {Encoding::GZIP, 9}, {Encoding::DEFLATE, 9} };
+        for (const auto& [encoding, level] : targets) {
+            if (!Compressor::supports(encoding)) continue;
+            std::string out;
+            Compressor compressor(encoding, level);
+            if (compressor.compress(body->data(), body->size(), out) && out.size() < body->size()) {
+                built.bytes += out.size();
+                built.variants[static_cast<int>(encoding)] = std::make_shared<const std::string>(std::move(out));
+            }
+        }
+        
+        std::unique_lock<std::shared_mutex> lock(store.mutex);
+        --store.pending;
+        auto it = store.entries.find(key);
+        if (it == store.entries.end() || it->second.data.tag != tag) return;
+        if (store.bytes + built.bytes > options_.max_variant_bytes) {
+            // Over budget: remember the tag so we don't rebuild, keep compressing inline
+            it->second.data.ready = true;
+            return;
+        }
+        store.bytes += built.bytes;
+        it->second.data = std::move(built);
+    });
+    
+    return false;
+}
+
+void CompressionMiddleware::wait_for_variants() {
+    if (!variants_) return;
+    // The builder has one worker, so a marker task runs after everything queued before it
+    std::promise<void> done;
+    variants_->builder.enqueue([&done]() { done.set_value(); });
+    done.get_future().wait();
+}
+
+size_t CompressionMiddleware::variant_count() const {
+    if (!variants_) return 0;
+    std::shared_lock<std::shared_mutex> lock(variants_->mutex);
+    return variants_->entries.size();
+}
+
+void CompressionMiddleware::handle(Request& req, Response& res, NextFunction next) {
+    next();
+    
+    crest_response_t* raw = res.raw();
+    if (!Compressor::available() || !raw->sent || raw->body_length < options_.min_size) return;
+    if (raw->status == 204 || raw->status == 304) return;
+    if (crest_kv_get(&raw->headers, "Content-Encoding", true)) return;
+    
+    const char* content_type = crest_kv_get(&raw->headers, "Content-Type", true);
+    if (!is_compressible(content_type ? content_type : raw->content_type)) return;
+    
+    // The representation depends on Accept-Encoding whether or not we compress
+    const char* vary = crest_kv_get(&raw->headers, "Vary", true);
+    if (!vary) {
+        crest_response_set_header(raw, "Vary", "Accept-Encoding");
+    } else if (!strstr(vary, "Accept-Encoding")) {
+        crest_response_set_header(raw, "Vary", (std::string(vary) + ", Accept-Encoding").c_str());
+    }
+    
+    Encoding encoding = negotiate_encoding(req.header("Accept-Encoding"));
+    if (variants_ && serve_variant(req, raw, encoding)) return;
+    if (encoding == Encoding::IDENTITY) return;
+    
+    // Reused per thread: capacity survives between requests
+    thread_local std::string buffer;
+    buffer.clear();
+    
+    Compressor& compressor = Compressor::local(encoding, options_.level);
+    if (!compressor.compress(raw->body, raw->body_length, buffer)) return;
+    if (buffer.size() >= raw->body_length) return;
+    
+    crest_response_set_body(raw, buffer.data(), buffer.size());
+    crest_response_set_header(raw, "Content-Encoding", encoding_name(encoding));
+    weaken_etag(raw);
+}
+
+} // namespace crest
@@ -0,0 +1,221 @@
+/**
+ * @file idempotency.cpp
+ * @brief Idempotency-Key response store middleware
+ */
+
+#include "crest/middleware.hpp"
+#include "crest/internal/app_internal.h"
+#include "crest/internal/pipeline.hpp"
+#include "crest/internal/response_capture.hpp"
+#include "../utils/hash.hpp"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <list>
+#include <unordered_map>
+
+namespace crest {
+
+using internal::CapturedResponse;
+
+namespace {
+
+int64_t steady_now_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool is_safe_method(const char* method) {
+    return !method || strcmp(method, "GET") == 0 || strcmp(method, "HEAD") == 0 || strcmp(method, "OPTIONS") == 0;
+}
+
+} // namespace
+
+struct IdempotencyMiddleware::Entry {
+    uint64_t fingerprint;
+    bool done = false;
+    bool abandoned = false;
+    int64_t expires_ms = 0;
+    std::shared_ptr<const CapturedResponse> response;
+    std::condition_variable done_cv;
+    std::list<std::string>::iterator lru;
+};
+
+struct IdempotencyMiddleware::Shard {
+    std::mutex mutex;
+    std::list<std::string> lru;
+    std::unordered_map<std::string, std::shared_ptr<Entry>> entries;
+
+    void erase(const std::string& key) {
+        auto it = entries.find(key);
+        if (it == entries.end()) return;
+        lru.erase(it->second->lru);
+        entries.erase(it);
+    }
+
+    // Completed entries only: an in-progress one has waiters relying on it
+    void evict_to(size_t capacity) {
+        auto it = lru.end();
+        while (entries.size() > capacity && it != lru.begin()) {
+            --it;
+            auto entry = entries.find(*it);
+            if (entry != entries.end() && entry->second->done) {
+                auto victim = it++;
+                entries.erase(entry);
+                lru.erase(victim);
+            }
+        }
+    }
+};
+
+IdempotencyMiddleware::IdempotencyMiddleware(const Options& opts)
+    : options_(opts), shards_(new Shard[opts.shards > 0 ? opts.shards : 1]) {
+    if (options_.shards == 0) options_.shards = 1;
+    shard_capacity_ = std::max<size_t>(1, options_.capacity / options_.shards);
+}
+
+IdempotencyMiddleware::~IdempotencyMiddleware() = default;
+
+IdempotencyMiddleware::Shard& IdempotencyMiddleware::shard_for(const std::string& key) const {
+    return shards_[hash_string(key) % options_.shards];
+}
+
+size_t IdempotencyMiddleware::size() const {
+    size_t total = 0;
+    for (size_t i = 0; i < options_.shards; ++i) {
+        std::lock_guard<std::mutex> lock(shards_[i].mutex);
+        total += shards_[i].entries.size();
+    }
+    return total;
+}
+
+void IdempotencyMiddleware::handle(Request& req, Response& res, NextFunction next) {
+    crest_request_t* raw_req = req.raw();
+    const char* idempotency_key = crest_kv_get(&raw_req->headers, options_.header.c_str(), true);
+    if (is_safe_method(raw_req->method) || !idempotency_key || !*idempotency_key) {
+        next();
+        return;
+    }
+    if (strlen(idempotency_key) > 255) {
+        res.json(400, "{\"error\":\"Idempotency-Key is too long\"}");
+        return;
+    }
+
+    // Scope the client's key; unit separators keep the parts from running together
+    std::string key = idempotency_key;
+    for (const auto& name : options_.header_keys) {
+        const char* value = crest_kv_get(&raw_req->headers, name.c_str(), true);
+        key += '\x1e';
+        if (value) key += value;
+    }
+
+    // The same key must keep meaning the same request
+    std::string request_line = raw_req->method;
+    request_line += ' ';
+    request_line += raw_req->path ? raw_req->path : "";
+    if (raw_req->query_string) {
+        request_line += '?';
+        request_line += raw_req->query_string;
+    }
+    uint64_t fingerprint = hash_string(request_line);
+    if (raw_req->body) fingerprint = hash_bytes(raw_req->body, strlen(raw_req->body), fingerprint);
+
+    Shard& shard = shard_for(key);
+    crest_response_t* raw = res.raw();
+    std::shared_ptr<Entry> entry;
+    std::shared_ptr<const CapturedResponse> stored;
+    {
+        std::unique_lock<std::mutex> lock(shard.mutex);
+        auto wait_until = std::chrono::steady_clock::now() + std::chrono::milliseconds(options_.wait_timeout_ms);
+        while (true) {
+            auto it = shard.entries.find(key);
+            if (it != shard.entries.end() && it->second->done && it->second->expires_ms <= steady_now_ms()) {
+                shard.erase(key);
+                it = shard.entries.end();
+            }
+
+            if (it == shard.entries.end()) {
+                entry = std::make_shared<Entry>();
+                entry->fingerprint = fingerprint;
+                shard.lru.push_front(key);
+                entry->lru = shard.lru.begin();
+                shard.entries.emplace(key, entry);
+                shard.evict_to(shard_capacity_);
+                break;
+            }
+
+            std::shared_ptr<Entry> existing = it->second;
+            if (existing->fingerprint != fingerprint) {
+                lock.unlock();
+                res.json(422, "{\"error\":\"Idempotency-Key was already used for a different request\"}");
+                return;
+            }
+            if (existing->done) {
+                shard.lru.splice(shard.lru.begin(), shard.lru, existing->lru);
+                stored = existing->response;
+                break;
+            }
+
+            // A duplicate of a request that is still running waits for its outcome
+            bool settled = existing->done_cv.wait_until(lock, wait_until,
+                                                        [&] { return existing->done || existing->abandoned; });
+            if (!settled) {
+                lock.unlock();
+                res.json(409, "{\"error\":\"A request with this Idempotency-Key is still in progress\"}");
+                return;
+            }
+            // Done: replay it on the next pass. Abandoned: try to run it ourselves
+        }
+    }
+
+    if (stored) {
+        stored->replay(raw);
+        crest_kv_set(&raw->headers, "Idempotent-Replayed", "true");
+        return;
+    }
+
+    // Store the outcome and wake duplicates
+    auto settle = [this, owner = &shard, key, entry](std::shared_ptr<const CapturedResponse> response) {
+        {
+            std::lock_guard<std::mutex> lock(owner->mutex);
+            if (response) {
+                entry->response = std::move(response);
+                entry->expires_ms = steady_now_ms() + (int64_t)options_.ttl_seconds * 1000;
+                entry->done = true;
+            } else {
+                // Failures are not stored, so a retry runs the request again
+                auto it = owner->entries.find(key);
+                if (it != owner->entries.end() && it->second == entry) owner->erase(key);
+                entry->abandoned = true;
+            }
+        }
+        entry->done_cv.notify_all();
+    };
+
+    // Settles even if the handler throws, unless the response finishes later
+    struct Finish {
+        const decltype(settle)& fn;
+        bool handed_off = false;
+        ~Finish() {
+            if (!handed_off) fn(nullptr);
+        }
+    } finish{settle};
+
+    CapturedResponse::Mark mark = CapturedResponse::mark(raw);
+    next();
+    if (raw->sent) {
+        finish.handed_off = true;
+        settle(raw->status < 500 ? std::make_shared<const CapturedResponse>(CapturedResponse::capture(raw, mark)) : nullptr);
+        return;
+    }
+    // A suspended coroutine handler responds after next() returns; duplicates
+    // keep waiting for that response instead of running the request again
+    finish.handed_off = internal::when_released(raw, [settle, raw, mark](bool delivered) {
+        settle(delivered && raw->status < 500
+                   ? std::make_shared<const CapturedResponse>(CapturedResponse::capture(raw, mark))
+                   : nullptr);
+    });
+}
+
+} // namespace crest
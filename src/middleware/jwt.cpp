@@ -0,0 +1,513 @@
+/**
+ * @file jwt.cpp
+ * @brief JWT verification and verified-token cache
+ */
+
+#include "crest/jwt.hpp"
+#include "crest/crest.hpp"
+#include "../utils/hash.hpp"
+#include "../utils/sha256.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <list>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <ctime>
+
+#ifdef CREST_HAS_OPENSSL
+#include <openssl/bio.h>
+#include <openssl/bn.h>
+#include <openssl/ecdsa.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#endif
+
+namespace crest {
+
+namespace {
+
+bool base64url_decode(std::string_view in, std::string& out) {
+    static const signed char table[256] = {
+        -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+        -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,62,-1,62,-1,63,52,53,54,55,56,57,58,59,60,61,-1,-1,-1,-1,-1,-1,
+        -1, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9,10,11,12,13,14,15,16,17,18,19,20,21,22,23,24,25,-1,-1,-1,-1,63,
+        -1,26,27,28,29,30,31,32,33,34,35,36,37,38,39,40,41,42,43,44,45,46,47,48,49,50,51,-1,-1,-1,-1,-1,
+        -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+        -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+        -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+        -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1
+    };
+
+    while (!in.empty() && in.back() == '=') in.remove_suffix(1);
+    if (in.size() % 4 == 1) return false;
+
+    out.clear();
+    out.reserve(in.size() * 3 / 4);
+    uint32_t acc = 0;
+    int bits = 0;
+    for (unsigned char c : in) {
+        int v = table[c];
+        if (v < 0) return false;
+        acc = (acc << 6) | (uint32_t)v;
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            out.push_back((char)((acc >> bits) & 0xff));
+        }
+    }
+    return true;
+}
+
+void skip_ws(const std::string& s, size_t& i) {
+    while (i < s.size() && (s[i] == ' ' || s[i] == '\t' || s[i] == '\n' || s[i] == '\r')) ++i;
+}
+
+void append_utf8(std::string& out, uint32_t cp) {
+    if (cp < 0x80) {
+        out.push_back((char)cp);
+    } else if (cp < 0x800) {
+        out.push_back((char)(0xc0 | (cp >> 6)));
+        out.push_back((char)(0x80 | (cp & 0x3f)));
+    } else {
+        out.push_back((char)(0xe0 | (cp >> 12)));
+        out.push_back((char)(0x80 | ((cp >> 6) & 0x3f)));
+        out.push_back((char)(0x80 | (cp & 0x3f)));
+    }
+}
+
+// Parses a JSON string starting at s[i] == '"'
+bool parse_string(const std::string& s, size_t& i, std::string& out) {
+    out.clear();
+    ++i;
+    while (i < s.size()) {
+        char c = s[i++];
+        if (c == '"') return true;
+        if (c != '\\') {
+            out.push_back(c);
+            continue;
+        }
+        if (i >= s.size()) return false;
+        char e = s[i++];
+        switch (e) {
+            case '"': out.push_back('"'); break;
+            case '\\': out.push_back('\\'); break;
+            case '/': out.push_back('/'); break;
+            case 'b': out.push_back('\b'); break;
+            case 'f': out.push_back('\f'); break;
+            case 'n': out.push_back('\n'); break;
+            case 'r': out.push_back('\r'); break;
+            case 't': out.push_back('\t'); break;
+            case 'u': {
+                if (i + 4 > s.size()) return false;
+                uint32_t cp = 0;
+                for (int n = 0; n < 4; ++n) {
+                    char h = s[i++];
+                    int v = (h >= '0' && h <= '9') ? h - '0' :
+                            (h >= 'a' && h <= 'f') ? h - 'a' + 10 :
+                            (h >= 'A' && h <= 'F') ? h - 'A' + 10 : -1;
+                    if (v < 0) return false;
+                    cp = (cp << 4) | (uint32_t)v;
+                }
+                append_utf8(out, cp);
+                break;
+            }
+            default: return false;
+        }
+    }
+    return false;
+}
+
+// Skips any JSON value, leaving i just past it
+bool skip_value(const std::string& s, size_t& i) {
+    skip_ws(s, i);
+    if (i >= s.size()) return false;
+    if (s[i] == '"') {
+        std::string ignored;
+        return parse_string(s, i, ignored);
+    }
+    if (s[i] == '{' || s[i] == '[') {
+        int depth = 0;
+        while (i < s.size()) {
+            char c = s[i];
+            if (c == '"') {
+                std::string ignored;
+                if (!parse_string(s, i, ignored)) return false;
+                continue;
+            }
+            if (c == '{' || c == '[') ++depth;
+            if (c == '}' || c == ']') {
+                if (--depth == 0) {
+                    ++i;
+                    return true;
+                }
+            }
+            ++i;
+        }
+        return false;
+    }
+    while (i < s.size() && s[i] != ',' && s[i] != '}' && s[i] != ']' && s[i] != ' ' && s[i] != '\n') ++i;
+    return true;
+}
+
+// Collects the top-level members of a JSON object: strings decoded, other values verbatim
+bool parse_object(const std::string& s, std::map<std::string, std::string>& members) {
+    size_t i = 0;
+    skip_ws(s, i);
+    if (i >= s.size() || s[i] != '{') return false;
+    ++i;
+
+    std::string key;
+    for (;;) {
+        skip_ws(s, i);
+        if (i < s.size() && s[i] == '}') return true;
+        if (i >= s.size() || s[i] != '"' || !parse_string(s, i, key)) return false;
+        skip_ws(s, i);
+        if (i >= s.size() || s[i] != ':') return false;
+        ++i;
+        skip_ws(s, i);
+
+        std::string value;
+        if (i < s.size() && s[i] == '"') {
+            if (!parse_string(s, i, value)) return false;
+        } else {
+            size_t start = i;
+            if (!skip_value(s, i)) return false;
+            value = s.substr(start, i - start);
+        }
+        members[key] = value;
+
+        skip_ws(s, i);
+        if (i < s.size() && s[i] == ',') {
+            ++i;
+            continue;
+        }
+        return i < s.size() && s[i] == '}';
+    }
+}
+
+// A NumericDate as a whole number of seconds that fits in int64_t
+bool parse_number(const std::string& value, int64_t& out) {
+    size_t digits = (!value.empty() && value[0] == '-') ? 1 : 0;
+    if (digits == value.size()) return false;
+    for (size_t i = digits; i < value.size(); ++i) {
+        if (value[i] < '0' || value[i] > '9') return false;
+    }
+    errno = 0;
+    long long parsed = std::strtoll(value.c_str(), nullptr, 10);
+    if (errno == ERANGE) return false;
+    out = (int64_t)parsed;
+    return true;
+}
+
+// "aud" may be one string or an array of strings
+bool audience_matches(const std::string& raw, const std::string& expected) {
+    if (raw.empty() || raw[0] != '[') return raw == expected;
+    size_t i = 1;
+    std::string item;
+    while (i < raw.size()) {
+        skip_ws(raw, i);
+        if (i < raw.size() && raw[i] == '"') {
+            if (!parse_string(raw, i, item)) return false;
+            if (item == expected) return true;
+        } else {
+            ++i;
+        }
+    }
+    return false;
+}
+
+const char* algorithm_name(JwtAlgorithm algorithm) {
+    switch (algorithm) {
+        case JwtAlgorithm::HS256: return "HS256";
+        case JwtAlgorithm::RS256: return "RS256";
+        case JwtAlgorithm::ES256: return "ES256";
+    }
+    return "";
+}
+
+bool parse_algorithm(const std::string& name, JwtAlgorithm& out) {
+    if (name == "HS256") out = JwtAlgorithm::HS256;
+    else if (name == "RS256") out = JwtAlgorithm::RS256;
+    else if (name == "ES256") out = JwtAlgorithm::ES256;
+    else return false;
+    return true;
+}
+
+} // namespace
+
+std::string JwtClaims::claim(const std::string& name) const {
+    std::map<std::string, std::string> members;
+    if (!parse_object(payload, members)) return "";
+    auto it = members.find(name);
+    return it == members.end() ? "" : it->second;
+}
+
+struct JwtVerifier::Key {
+    JwtAlgorithm algorithm;
+    std::string secret;
+#ifdef CREST_HAS_OPENSSL
+    EVP_PKEY* pkey = nullptr;
+    ~Key() { if (pkey) EVP_PKEY_free(pkey); }
+#endif
+
+    bool verify(const std::string& input, const std::string& signature) const {
+        if (algorithm == JwtAlgorithm::HS256) {
+            Sha256::Digest mac = hmac_sha256(secret, input.data(), input.size());
+            return signature.size() == mac.size() &&
+                   constant_time_equals(signature.data(), mac.data(), mac.size());
+        }
+#ifdef CREST_HAS_OPENSSL
+        std::string der;
+        const unsigned char* sig = reinterpret_cast<const unsigned char*>(signature.data());
+        size_t sig_len = signature.size();
+
+        if (algorithm == JwtAlgorithm::ES256) {
+            // JWS carries ES256 signatures as raw r || s; OpenSSL wants DER
+            if (signature.size() != 64) return false;
+            ECDSA_SIG* ec = ECDSA_SIG_new();
+            BIGNUM* r = BN_bin2bn(sig, 32, nullptr);
+            BIGNUM* s = BN_bin2bn(sig + 32, 32, nullptr);
+            ECDSA_SIG_set0(ec, r, s);
+            int len = i2d_ECDSA_SIG(ec, nullptr);
+            der.resize(len > 0 ? (size_t)len : 0);
+            unsigned char* p = reinterpret_cast<unsigned char*>(&der[0]);
+            i2d_ECDSA_SIG(ec, &p);
+            ECDSA_SIG_free(ec);
+            sig = reinterpret_cast<const unsigned char*>(der.data());
+            sig_len = der.size();
+        }
+
+        EVP_MD_CTX* ctx = EVP_MD_CTX_new();
+        bool ok = EVP_DigestVerifyInit(ctx, nullptr, EVP_sha256(), nullptr, pkey) == 1 &&
+                  EVP_DigestVerify(ctx, sig, sig_len,
+                                   reinterpret_cast<const unsigned char*>(input.data()), input.size()) == 1;
+        EVP_MD_CTX_free(ctx);
+        return ok;
+#else
+        return false;
+#endif
+    }
+};
+
+JwtVerifier::JwtVerifier(const Options& opts) : options_(opts), generation_(1) {}
+
+JwtVerifier::~JwtVerifier() = default;
+
+bool JwtVerifier::supports(JwtAlgorithm algorithm) {
+#ifdef CREST_HAS_OPENSSL
+    (void)algorithm;
+    return true;
+#else
+    return algorithm == JwtAlgorithm::HS256;
+#endif
+}
+
+void JwtVerifier::add_hmac_key(const std::string& kid, const std::string& secret) {
+    auto key = std::make_shared<Key>();
+    key->algorithm = JwtAlgorithm::HS256;
+    key->secret = secret;
+
+    std::unique_lock<std::shared_mutex> lock(keys_mutex_);
+    keys_[kid] = std::move(key);
+    generation_.fetch_add(1, std::memory_order_acq_rel);
+}
+
+void JwtVerifier::add_public_key(const std::string& kid, JwtAlgorithm algorithm, const std::string& pem) {
+    if (algorithm == JwtAlgorithm::HS256 || !supports(algorithm)) {
+        throw Exception(std::string("Unsupported public key algorithm: ") + algorithm_name(algorithm));
+    }
+
+    auto key = std::make_shared<Key>();
+    key->algorithm = algorithm;
+#ifdef CREST_HAS_OPENSSL
+    BIO* bio = BIO_new_mem_buf(pem.data(), (int)pem.size());
+    key->pkey = PEM_read_bio_PUBKEY(bio, nullptr, nullptr, nullptr);
+    BIO_free(bio);
+
+    int expected = algorithm == JwtAlgorithm::RS256 ? EVP_PKEY_RSA : EVP_PKEY_EC;
+    if (!key->pkey || EVP_PKEY_base_id(key->pkey) != expected) {
+        throw Exception("Invalid " + std::string(algorithm_name(algorithm)) + " public key for kid " + kid);
+    }
+#else
+    (void)pem;
+#endif
+
+    std::unique_lock<std::shared_mutex> lock(keys_mutex_);
+    keys_[kid] = std::move(key);
+    generation_.fetch_add(1, std::memory_order_acq_rel);
+}
+
+void JwtVerifier::remove_key(const std::string& kid) {
+    std::unique_lock<std::shared_mutex> lock(keys_mutex_);
+    keys_.erase(kid);
+    generation_.fetch_add(1, std::memory_order_acq_rel);
+}
+
+bool JwtVerifier::verify(const std::string& token, JwtClaims* claims, std::string* error) const {
+    auto fail = [error](const char* reason) {
+        if (error) *error = reason;
+        return false;
+    };
+
+    size_t first = token.find('.');
+    size_t second = first == std::string::npos ? std::string::npos : token.find('.', first + 1);
+    if (second == std::string::npos || token.find('.', second + 1) != std::string::npos) {
+        return fail("malformed token");
+    }
+
+    std::string header_json, payload_json, signature;
+    std::string_view view(token);
+    if (!base64url_decode(view.substr(0, first), header_json) ||
+        !base64url_decode(view.substr(first + 1, second - first - 1), payload_json) ||
+        !base64url_decode(view.substr(second + 1), signature)) {
+        return fail("malformed token");
+    }
+
+    std::map<std::string, std::string> header;
+    if (!parse_object(header_json, header)) return fail("malformed header");
+
+    JwtAlgorithm algorithm;
+    if (!parse_algorithm(header["alg"], algorithm)) return fail("unsupported algorithm");
+
+    // Snapshot the candidate keys so rotation never blocks on a slow verification
+    std::vector<std::shared_ptr<const Key>> candidates;
+    {
+        std::shared_lock<std::shared_mutex> lock(keys_mutex_);
+        auto kid = header.find("kid");
+        if (kid != header.end()) {
+            auto it = keys_.find(kid->second);
+            if (it != keys_.end()) candidates.push_back(it->second);
+        } else {
+            for (const auto& entry : keys_) candidates.push_back(entry.second);
+        }
+    }
+
+    std::string signing_input = token.substr(0, second);
+    bool verified = false;
+    for (const auto& key : candidates) {
+        // The key decides the algorithm; a token cannot downgrade RS256 to HS256
+        if (key->algorithm == algorithm && key->verify(signing_input, signature)) {
+            verified = true;
+            break;
+        }
+    }
+    if (!verified) return fail("invalid signature");
+
+    std::map<std::string, std::string> payload;
+    if (!parse_object(payload_json, payload)) return fail("malformed payload");
+
+    JwtClaims parsed;
+    // A time claim that is present but unreadable must not count as absent
+    auto exp = payload.find("exp");
+    if (exp != payload.end() && !parse_number(exp->second, parsed.expires_at)) return fail("malformed exp");
+    auto nbf = payload.find("nbf");
+    if (nbf != payload.end() && !parse_number(nbf->second, parsed.not_before)) return fail("malformed nbf");
+    parse_number(payload["iat"], parsed.issued_at);
+    parsed.subject = payload["sub"];
+    parsed.issuer = payload["iss"];
+    parsed.audience = payload["aud"];
+
+    int64_t now = (int64_t)std::time(nullptr);
+    // The leeway is applied to now, which cannot overflow for any claim value
+    if (exp == payload.end() && options_.require_exp) return fail("missing exp");
+    if (exp != payload.end() && now - options_.leeway_seconds > parsed.expires_at) return fail("token expired");
+    if (nbf != payload.end() && now + options_.leeway_seconds < parsed.not_before) return fail("token not yet valid");
+    if (!options_.issuer.empty() && parsed.issuer != options_.issuer) return fail("issuer mismatch");
+    if (!options_.audience.empty() && !audience_matches(parsed.audience, options_.audience)) {
+        return fail("audience mismatch");
+    }
+
+    if (claims) {
+        parsed.payload = std::move(payload_json);
+        *claims = std::move(parsed);
+    }
+    return true;
+}
+
+struct TokenCache::Shard {
+    struct Entry {
+        std::string token;
+        uint64_t generation;
+        int64_t expires_at;
+    };
+
+    std::mutex mutex;
+    std::list<Entry> lru;
+    std::unordered_map<std::string_view, std::list<Entry>::iterator> index;
+};
+
+TokenCache::TokenCache(const Options& opts)
+    : options_(opts), shards_(new Shard[opts.shards > 0 ? opts.shards : 1]) {
+    if (options_.shards == 0) options_.shards = 1;
+    shard_capacity_ = std::max<size_t>(1, options_.capacity / options_.shards);
+}
+
+TokenCache::~TokenCache() = default;
+
+TokenCache::Shard& TokenCache::shard_for(const std::string& token) const {
+    return shards_[hash_string(token) % options_.shards];
+}
+
+bool TokenCache::contains(const std::string& token, uint64_t generation, int64_t now) const {
+    Shard& shard = shard_for(token);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto it = shard.index.find(token);
+    if (it == shard.index.end()) return false;
+
+    auto entry = it->second;
+    if (entry->generation != generation || entry->expires_at <= now) {
+        shard.index.erase(it);
+        shard.lru.erase(entry);
+        return false;
+    }
+
+    shard.lru.splice(shard.lru.begin(), shard.lru, entry);
+    return true;
+}
+
+void TokenCache::insert(const std::string& token, uint64_t generation, int64_t expires_at, int64_t now) {
+    int64_t deadline = now + options_.ttl_seconds;
+    if (expires_at != 0 && expires_at < deadline) deadline = expires_at;
+    if (deadline <= now) return;
+
+    Shard& shard = shard_for(token);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto it = shard.index.find(token);
+    if (it != shard.index.end()) {
+        it->second->generation = generation;
+        it->second->expires_at = deadline;
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+        return;
+    }
+
+    if (shard.lru.size() >= shard_capacity_) {
+        shard.index.erase(shard.lru.back().token);
+        shard.lru.pop_back();
+    }
+
+    shard.lru.push_front(Shard::Entry{token, generation, deadline});
+    shard.index.emplace(shard.lru.front().token, shard.lru.begin());
+}
+
+void TokenCache::clear() {
+    for (size_t i = 0; i < options_.shards; ++i) {
+        std::lock_guard<std::mutex> lock(shards_[i].mutex);
+        shards_[i].index.clear();
+        shards_[i].lru.clear();
+    }
+}
+
+size_t TokenCache::size() const {
+    size_t total = 0;
+    for (size_t i = 0; i < options_.shards; ++i) {
+        std::lock_guard<std::mutex> lock(shards_[i].mutex);
+        total += shards_[i].lru.size();
+    }
+    return total;
+}
+
+} // namespace crest
@@ -4,93 +4,225 @@
  */
 
 #include "crest/middleware.hpp"
+#include "crest/internal/app_internal.h"
+#include "../utils/hash.hpp"
 #include <chrono>
 #include <sstream>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
 
 namespace crest {
 
-void CorsMiddleware::handle(Request& req, Response& res, NextFunction next) {
-    std::string origin = req.header("Origin");
-    
-    if (options_.allowed_origins[0] == "*" || 
-        std::find(options_.allowed_origins.begin(), options_.allowed_origins.end(), origin) != options_.allowed_origins.end()) {
-        res.set_header("Access-Control-Allow-Origin", origin.empty() ? "*" : origin);
+static std::string join(const std::vector<std::string>& items) {
+    std::string out;
+    for (size_t i = 0; i < items.size(); ++i) {
+        if (i > 0) out += ", ";
+        out += items[i];
     }
-    
-    std::ostringstream methods;
-    for (size_t i = 0; i < options_.allowed_methods.size(); ++i) {
-        if (i > 0) methods << ", ";
-        methods << options_.allowed_methods[i];
+    return out;
+}
+
+bool CorsMiddleware::is_preflight(const crest_request_t* req) {
+    return req && req->method && strcmp(req->method, "OPTIONS") == 0 &&
+           crest_kv_get(&req->headers, "Access-Control-Request-Method", true) != nullptr;
+}
+
+CorsMiddleware::CorsMiddleware(const Options& opts) : options_(opts), any_origin_(false) {
+    for (const auto& origin : options_.allowed_origins) {
+        if (origin == "*") any_origin_ = true;
+        else origins_.push_back(origin);
     }
-    res.set_header("Access-Control-Allow-Methods", methods.str());
     
-    if (options_.allowed_headers[0] == "*") {
-        res.set_header("Access-Control-Allow-Headers", "*");
-    } else {
-        std::ostringstream headers;
-        for (size_t i = 0; i < options_.allowed_headers.size(); ++i) {
-            if (i > 0) headers << ", ";
-            headers << options_.allowed_headers[i];
-        }
-        res.set_header("Access-Control-Allow-Headers", headers.str());
+    // Everything except a credentialed or listed origin is known up front
+    if (options_.allow_credentials) {
+        actual_block_ += "Access-Control-Allow-Credentials: true\r\n";
     }
-    
     if (!options_.exposed_headers.empty()) {
-        std::ostringstream exposed;
-        for (size_t i = 0; i < options_.exposed_headers.size(); ++i) {
-            if (i > 0) exposed << ", ";
-            exposed << options_.exposed_headers[i];
-        }
-        res.set_header("Access-Control-Expose-Headers", exposed.str());
+        actual_block_ += "Access-Control-Expose-Headers: " + join(options_.exposed_headers) + "\r\n";
     }
     
+    preflight_block_ = "Access-Control-Allow-Methods: " + join(options_.allowed_methods) + "\r\n";
+    bool echo_headers = !options_.allowed_headers.empty() && options_.allowed_headers[0] == "*" && options_.allow_credentials;
+    if (!echo_headers && !options_.allowed_headers.empty()) {
+        preflight_block_ += "Access-Control-Allow-Headers: " + join(options_.allowed_headers) + "\r\n";
+    }
     if (options_.allow_credentials) {
-        res.set_header("Access-Control-Allow-Credentials", "true");
+        preflight_block_ += "Access-Control-Allow-Credentials: true\r\n";
     }
+    preflight_block_ += "Access-Control-Max-Age: " + std::to_string(options_.max_age) + "\r\n";
     
-    res.set_header("Access-Control-Max-Age", std::to_string(options_.max_age));
+    // A public, credential-free policy answers every request with the same bytes
+    if (any_origin_ && !options_.allow_credentials) {
+        public_block_ = "Access-Control-Allow-Origin: *\r\n" + actual_block_;
+        preflight_response_ = "HTTP/1.1 204 No Content\r\n"
+                              "Access-Control-Allow-Origin: *\r\n" + preflight_block_ +
+                              "Connection: close\r\n\r\n";
+    }
+}
+
+bool CorsMiddleware::origin_allowed(const char* origin) const {
+    // Without an Origin a credentialed policy has nothing to echo, and "*" is forbidden
+    if (!origin || !*origin) return any_origin_ && !options_.allow_credentials;
+    if (any_origin_) return true;
+    return std::find(origins_.begin(), origins_.end(), origin) != origins_.end();
+}
+
+void CorsMiddleware::append_origin(std::string& out, const char* origin) const {
+    if (any_origin_ && !options_.allow_credentials) {
+        out += "Access-Control-Allow-Origin: *\r\n";
+        return;
+    }
+    // Credentials forbid "*", so echo the origin and keep caches keyed on it
+    out += "Access-Control-Allow-Origin: ";
+    out += origin;
+    out += "\r\nVary: Origin\r\n";
+}
+
+void CorsMiddleware::preflight_headers(const char* origin, const char* request_headers, std::string& out) const {
+    if (!origin_allowed(origin)) return;
     
-    if (req.method() == "OPTIONS") {
-        res.text(204, "");
+    append_origin(out, origin);
+    out += preflight_block_;
+    if (options_.allow_credentials && !options_.allowed_headers.empty() && options_.allowed_headers[0] == "*" &&
+        request_headers && *request_headers) {
+        out += "Access-Control-Allow-Headers: ";
+        out += request_headers;
+        out += "\r\n";
+    }
+}
+
+void CorsMiddleware::preflight(const char* origin, const char* request_headers, std::string& out) const {
+    if (!preflight_response_.empty()) {
+        out = preflight_response_;
         return;
     }
     
-    next();
+    out = "HTTP/1.1 204 No Content\r\n";
+    preflight_headers(origin, request_headers, out);
+    out += "Connection: close\r\n\r\n";
 }
 
-void RateLimitMiddleware::handle(Request& req, Response& res, NextFunction next) {
-    std::string client_ip = req.header("X-Forwarded-For");
-    if (client_ip.empty()) {
-        client_ip = req.header("X-Real-IP");
+void CorsMiddleware::handle(Request& req, Response& res, NextFunction next) {
+    crest_request_t* raw_req = req.raw();
+    crest_response_t* raw_res = res.raw();
+    const char* origin = crest_kv_get(&raw_req->headers, "Origin", true);
+    
+    // Preflights reach the chain only when CORS is scoped to a group or route
+    if (is_preflight(raw_req)) {
+        std::string block;
+        preflight_headers(origin, crest_kv_get(&raw_req->headers, "Access-Control-Request-Headers", true), block);
+        crest_response_append_raw_headers(raw_res, block.data(), block.size());
+        res.text(204, "");
+        return;
     }
-    if (client_ip.empty()) {
-        client_ip = "unknown";
+    
+    if (!public_block_.empty()) {
+        crest_response_append_raw_headers(raw_res, public_block_.data(), public_block_.size());
+    } else if (origin_allowed(origin)) {
+        std::string block;
+        block.reserve(64 + actual_block_.size());
+        append_origin(block, origin);
+        block += actual_block_;
+        crest_response_append_raw_headers(raw_res, block.data(), block.size());
     }
     
-    std::lock_guard<std::mutex> lock(mutex_);
+    next();
+}
+
+static RateLimiter::Options limiter_options(const RateLimitMiddleware::Options& opts) {
+    RateLimiter::Options limiter;
+    limiter.max_requests = opts.max_requests;
+    limiter.window_seconds = opts.window_seconds;
+    limiter.burst = opts.burst;
+    limiter.capacity = opts.capacity;
+    limiter.shared_memory_name = opts.shared_memory_name;
+    return limiter;
+}
+
+RateLimitMiddleware::RateLimitMiddleware(const Options& opts)
+    : options_(opts), limiter_(limiter_options(opts)) {}
+
+static std::string trim(const std::string& s) {
+    size_t begin = s.find_first_not_of(" \t");
+    if (begin == std::string::npos) return "";
+    size_t end = s.find_last_not_of(" \t");
+    return s.substr(begin, end - begin + 1);
+}
+
+std::string RateLimitMiddleware::client_key(Request& req) const {
+    if (options_.trust_proxy) {
+        // The last hop is the one our proxy appended; earlier entries are client-controlled
+        std::string forwarded = req.header("X-Forwarded-For");
+        if (!forwarded.empty()) {
+            size_t comma = forwarded.rfind(',');
+            std::string last = trim(comma == std::string::npos ? forwarded : forwarded.substr(comma + 1));
+            if (!last.empty()) return last;
+        }
+        std::string real_ip = trim(req.header("X-Real-IP"));
+        if (!real_ip.empty()) return real_ip;
+    }
     
-    auto now = std::time(nullptr);
-    auto& entry = request_counts_[client_ip];
+    std::string peer = req.remote_addr();
+    return peer.empty() ? "unknown" : peer;
+}
+
+void RateLimitMiddleware::handle(Request& req, Response& res, NextFunction next) {
+    RateLimiter::Result result = limiter_.acquire(client_key(req));
     
-    if (now - entry.second >= options_.window_seconds) {
-        entry.first = 0;
-        entry.second = now;
-    }
+    auto to_seconds = [](int64_t us) { return (us + 999999) / 1000000; };
     
-    entry.first++;
+    res.set_header("X-RateLimit-Limit", std::to_string(result.limit));
+    res.set_header("X-RateLimit-Remaining", std::to_string(result.remaining));
+    res.set_header("X-RateLimit-Reset", std::to_string(std::time(nullptr) + to_seconds(result.reset_us)));
     
-    if (entry.first > options_.max_requests) {
+    if (!result.allowed) {
+        res.set_header("Retry-After", std::to_string(to_seconds(result.retry_after_us)));
         res.json(429, "{\"error\":\"" + options_.message + "\"}");
         return;
     }
     
-    res.set_header("X-RateLimit-Limit", std::to_string(options_.max_requests));
-    res.set_header("X-RateLimit-Remaining", std::to_string(options_.max_requests - entry.first));
-    res.set_header("X-RateLimit-Reset", std::to_string(entry.second + options_.window_seconds));
-    
     next();
 }
 
+static std::unique_ptr<TokenCache> make_token_cache(const AuthMiddleware::Options& opts) {
+    if (!opts.cache) return nullptr;
+    TokenCache::Options cache_opts;
+    cache_opts.capacity = opts.cache_capacity;
+    cache_opts.ttl_seconds = opts.cache_ttl_seconds;
+    return std::unique_ptr<TokenCache>(new TokenCache(cache_opts));
+}
+
+AuthMiddleware::AuthMiddleware(ValidatorFunction validator, const Options& opts)
+    : options_(opts), validator_(std::move(validator)), cache_(make_token_cache(opts)) {}
+
+AuthMiddleware::AuthMiddleware(std::shared_ptr<JwtVerifier> verifier, const Options& opts)
+    : options_(opts), verifier_(std::move(verifier)), cache_(make_token_cache(opts)) {
+    if (!verifier_) throw Exception("Invalid JWT verifier");
+}
+
+bool AuthMiddleware::validate(const std::string& token) {
+    int64_t now = (int64_t)std::time(nullptr);
+    uint64_t generation = verifier_ ? verifier_->generation() : 0;
+    
+    if (cache_ && cache_->contains(token, generation, now)) {
+        return true;
+    }
+    
+    int64_t expires_at = 0;
+    if (verifier_) {
+        JwtClaims claims;
+        if (!verifier_->verify(token, &claims)) return false;
+        expires_at = claims.expires_at;
+    } else if (!validator_ || !validator_(token)) {
+        return false;
+    }
+    
+    if (cache_) cache_->insert(token, generation, expires_at, now);
+    return true;
+}
+
 void AuthMiddleware::handle(Request& req, Response& res, NextFunction next) {
     std::string auth_header = req.header("Authorization");
     
@@ -106,7 +238,7 @@ void AuthMiddleware::handle(Request& req, Response& res, NextFunction next) {
         token = auth_header;
     }
     
-    if (!validator_(token)) {
+    if (!validate(token)) {
         res.json(403, "{\"error\":\"Invalid or expired token\"}");
         return;
     }
@@ -123,17 +255,85 @@ void LoggingMiddleware::handle(Request& req, Response& res, NextFunction next) {
     auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
     
     // Log format: METHOD PATH - STATUS (duration ms)
-    printf("[%s] %s - %dms\n", req.method().c_str(), req.path().c_str(), (int)duration.count());
+    printf("[%s] %s - %d (%dms)\n", req.method().c_str(), req.path().c_str(), res.status(), (int)duration.count());
 }
 
-void CompressionMiddleware::handle(Request& req, Response& res, NextFunction next) {
-    std::string accept_encoding = req.header("Accept-Encoding");
+bool etag_matches(const std::string& if_none_match, const std::string& etag) {
+    if (if_none_match.empty() || etag.empty()) return false;
+    
+    auto opaque = [](const char* begin, const char* end) {
+        if (end - begin >= 2 && begin[0] == 'W' && begin[1] == '/') begin += 2;
+        return std::string(begin, end);
+    };
+    std::string target = opaque(etag.data(), etag.data() + etag.size());
     
-    if (accept_encoding.find("gzip") != std::string::npos) {
-        res.set_header("Content-Encoding", "gzip");
+    const char* p = if_none_match.c_str();
+    while (*p) {
+        while (*p == ' ' || *p == '\t' || *p == ',') ++p;
+        if (!*p) break;
+        if (*p == '*') return true;
+        
+        const char* begin = p;
+        if (p[0] == 'W' && p[1] == '/') p += 2;
+        if (*p == '"') {
+            const char* close = strchr(p + 1, '"');
+            p = close ? close + 1 : p + strlen(p);
+        } else {
+            while (*p && *p != ',') ++p;
+        }
+        if (opaque(begin, p) == target) return true;
     }
+    return false;
+}
+
+static bool is_conditional_method(const crest_request_t* req) {
+    return req->method && (strcmp(req->method, "GET") == 0 || strcmp(req->method, "HEAD") == 0);
+}
+
+static void send_not_modified(crest_response_t* raw) {
+    raw->status = 304;
+    raw->content_type = nullptr;
+    crest_response_set_body(raw, "", 0);
+    raw->sent = true;
+}
+
+bool not_modified(Request& req, Response& res, const std::string& version) {
+    std::string etag = "\"" + version + "\"";
+    res.set_header("ETag", etag);
+    
+    crest_request_t* raw_req = req.raw();
+    if (!is_conditional_method(raw_req)) return false;
     
+    const char* if_none_match = crest_kv_get(&raw_req->headers, "If-None-Match", true);
+    if (!if_none_match || !etag_matches(if_none_match, etag)) return false;
+    
+    send_not_modified(res.raw());
+    return true;
+}
+
+void EtagMiddleware::handle(Request& req, Response& res, NextFunction next) {
     next();
+    
+    crest_request_t* raw_req = req.raw();
+    crest_response_t* raw = res.raw();
+    if (!raw->sent || raw->status != 200 || !is_conditional_method(raw_req)) return;
+    
+    const char* existing = crest_kv_get(&raw->headers, "ETag", true);
+    std::string etag;
+    if (existing) {
+        etag = existing;
+    } else {
+        char tag[24];
+        snprintf(tag, sizeof(tag), "%s\"%016llx\"", options_.weak ? "W/" : "",
+                 (unsigned long long)hash_bytes(raw->body, raw->body_length));
+        etag = tag;
+        crest_response_set_header(raw, "ETag", etag.c_str());
+    }
+    
+    const char* if_none_match = crest_kv_get(&raw_req->headers, "If-None-Match", true);
+    if (if_none_match && etag_matches(if_none_match, etag)) {
+        send_not_modified(raw);
+    }
 }
 
 } // namespace crest
@@ -0,0 +1,85 @@
+/**
+ * @file pipeline.cpp
+ * @brief Middleware chain execution
+ */
+
+#include "crest/internal/pipeline.hpp"
+
+namespace crest {
+namespace internal {
+
+namespace {
+
+struct Cursor {
+    const RouteState* route;
+    const Handler* handler;
+    size_t index;
+    Request& req;
+    Response& res;
+    
+    void operator()() const {
+        if (index < route->chain.size()) {
+            Cursor next{route, handler, index + 1, req, res};
+            route->chain[index]->handle(req, res, next);
+        } else {
+            (*handler)(req, res);
+        }
+    }
+};
+
+} // namespace
+
+void respond_with_error(crest_response_t* res, int status, const char* message) {
+    if (res->sent) return;
+    std::string body = "{\"error\":\"";
+    for (const char* p = message; *p; ++p) {
+        if (*p == '"' || *p == '\\') body += '\\';
+        if ((unsigned char)*p >= 0x20) body += *p;
+    }
+    body += "\"}";
+    crest_response_json(res, status, body.c_str());
+}
+
+void RouteState::dispatch(Request& req, Response& res) const {
+    Cursor{this, &handler, 0, req, res}();
+}
+
+// Runs the chain with handler (the route's own when null) at its end
+static void run_route(const RouteState* state, const Handler* handler, crest_request_t* req, crest_response_t* res) {
+    // A coroutine handler may resume elsewhere only once the chain has unwound
+    struct Settle {
+        ~Settle() { settle_async(); }
+    } settle;
+    Request cpp_req(req);
+    Response cpp_res(res);
+    try {
+        Cursor{state, handler ? handler : &state->handler, 0, cpp_req, cpp_res}();
+    } catch (const Exception& e) {
+        // e.g. Deadline::check(); answer with the exception's status unless already responded
+        respond_with_error(res, e.code(), e.what());
+    }
+}
+
+void dispatch(const crest_route_entry_t& route, crest_request_t* req, crest_response_t* res) {
+    if (route.cpp_handler) {
+        run_route(static_cast<const RouteState*>(route.cpp_handler), nullptr, req, res);
+    } else if (route.handler) {
+        route.handler(req, res);
+    }
+}
+
+void dispatch(const crest_route_entry_t& route, crest_request_t* req, crest_response_t* res,
+              const std::function<bool()>& at_handler) {
+    if (route.cpp_handler) {
+        const auto* state = static_cast<const RouteState*>(route.cpp_handler);
+        const Handler gated = [state, &at_handler](Request& cpp_req, Response& cpp_res) {
+            if (at_handler()) state->handler(cpp_req, cpp_res);
+        };
+        run_route(state, &gated, req, res);
+    } else if (route.handler && at_handler()) {
+        route.handler(req, res);
+    }
+}
+
+} // namespace internal
+} // namespace crest
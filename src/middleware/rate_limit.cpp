@@ -0,0 +1,271 @@
+/**
+ * @file rate_limit.cpp
+ * @brief Lock-free GCRA rate limiter
+ */
+
+#include "crest/rate_limit.hpp"
+#include "crest/crest.hpp"
+#include "../utils/hash.hpp"
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <thread>
+
+#if !defined(_WIN32) && !defined(_WIN64) && !defined(CREST_WINDOWS)
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+    #define CREST_HAS_SHM 1
+#endif
+
+namespace crest {
+
+namespace {
+
+constexpr size_t kWays = 4;
+
+struct Slot {
+    std::atomic<uint64_t> key;    // 0 = empty
+    std::atomic<int64_t> tat;     // Theoretical arrival time, microseconds
+};
+
+struct alignas(64) Bucket {
+    Slot slots[kWays];
+};
+
+// Slots may be mapped into several processes, so the atomics must not fall back to locks
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "64-bit atomics must be lock-free");
+static_assert(std::atomic<int64_t>::is_always_lock_free, "64-bit atomics must be lock-free");
+
+constexpr uint64_t kShmMagic = 0x43524c4d54763031ull;  // "CRLMTv01"
+constexpr uint64_t kShmInitializing = 1;
+
+// First cache line of a shared table; buckets follow it
+struct alignas(64) ShmHeader {
+    std::atomic<uint64_t> magic;
+    std::atomic<uint64_t> bucket_count;
+    std::atomic<int64_t> interval_us;
+    std::atomic<int64_t> span_us;
+};
+
+int64_t steady_now_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+size_t round_up_pow2(size_t n) {
+    size_t p = 1;
+    while (p < n) p <<= 1;
+    return p;
+}
+
+} // namespace
+
+struct RateLimiter::Table {
+    Bucket* buckets = nullptr;
+    size_t mask = 0;
+    std::unique_ptr<Bucket[]> owned;
+    void* mapping = nullptr;
+    size_t mapping_size = 0;
+
+    explicit Table(size_t bucket_count) {
+        owned.reset(new Bucket[bucket_count]);
+        for (size_t i = 0; i < bucket_count; ++i) {
+            for (Slot& slot : owned[i].slots) {
+                slot.key.store(0, std::memory_order_relaxed);
+                slot.tat.store(0, std::memory_order_relaxed);
+            }
+        }
+        buckets = owned.get();
+        mask = bucket_count - 1;
+    }
+
+    // Maps (creating if needed) a table shared by every process that opens the same name
+    Table(const std::string& name, size_t bucket_count, int64_t interval_us, int64_t span_us) {
+#ifdef CREST_HAS_SHM
+        mapping_size = sizeof(ShmHeader) + bucket_count * sizeof(Bucket);
+
+        int fd = shm_open(name.c_str(), O_RDWR | O_CREAT, 0600);
+        if (fd < 0) {
+            throw Exception("shm_open(" + name + ") failed: " + std::strerror(errno));
+        }
+
+        // ftruncate zero-fills, and all-zero slots are an empty table, so no
+        // process has to initialize buckets; the first one to size it wins
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size == 0 && ftruncate(fd, (off_t)mapping_size) != 0) {
+            int err = errno;
+            close(fd);
+            throw Exception("ftruncate(" + name + ") failed: " + std::strerror(err));
+        }
+        if (fstat(fd, &st) != 0 || (size_t)st.st_size != mapping_size) {
+            close(fd);
+            throw Exception("Shared rate limit table " + name + " exists with a different capacity");
+        }
+
+        mapping = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (mapping == MAP_FAILED) {
+            mapping = nullptr;
+            throw Exception("mmap(" + name + ") failed: " + std::strerror(errno));
+        }
+
+        ShmHeader* header = static_cast<ShmHeader*>(mapping);
+        uint64_t expected = 0;
+        if (header->magic.compare_exchange_strong(expected, kShmInitializing, std::memory_order_acq_rel)) {
+            // Publish the limits before the magic so other processes can validate them
+            header->bucket_count.store(bucket_count, std::memory_order_relaxed);
+            header->interval_us.store(interval_us, std::memory_order_relaxed);
+            header->span_us.store(span_us, std::memory_order_relaxed);
+            header->magic.store(kShmMagic, std::memory_order_release);
+        }
+        while (header->magic.load(std::memory_order_acquire) != kShmMagic) {
+            std::this_thread::yield();
+        }
+
+        if (header->bucket_count.load(std::memory_order_relaxed) != bucket_count ||
+            header->interval_us.load(std::memory_order_relaxed) != interval_us ||
+            header->span_us.load(std::memory_order_relaxed) != span_us) {
+            munmap(mapping, mapping_size);
+            mapping = nullptr;
+            throw Exception("Shared rate limit table " + name + " was created with different limits");
+        }
+
+        buckets = reinterpret_cast<Bucket*>(static_cast<char*>(mapping) + sizeof(ShmHeader));
+        mask = bucket_count - 1;
+#else
+        (void)bucket_count; (void)interval_us; (void)span_us;
+        throw Exception("Shared-memory rate limiting is not supported on this platform: " + name);
+#endif
+    }
+
+    ~Table() {
+#ifdef CREST_HAS_SHM
+        if (mapping) munmap(mapping, mapping_size);
+#endif
+    }
+
+    // Finds the key's slot or claims one for it
+    Slot& slot_for(uint64_t key, int64_t now) {
+        Bucket& bucket = buckets[(key ^ (key >> 32)) & mask];
+
+        for (;;) {
+            Slot* victim = nullptr;
+            uint64_t victim_key = 0;
+            int64_t victim_tat = 0;
+
+            for (Slot& slot : bucket.slots) {
+                uint64_t k = slot.key.load(std::memory_order_acquire);
+                if (k == key) return slot;
+
+                int64_t t = slot.tat.load(std::memory_order_relaxed);
+                // Empty and replenished slots hold no state, so prefer them;
+                // otherwise evict the key closest to replenishing
+                int64_t rank = (k == 0 || t <= now) ? INT64_MIN : t;
+                if (!victim || rank < victim_tat) {
+                    victim = &slot;
+                    victim_key = k;
+                    victim_tat = rank;
+                }
+            }
+
+            int64_t old_tat = victim->tat.load(std::memory_order_relaxed);
+            if (victim->key.compare_exchange_strong(victim_key, key, std::memory_order_acq_rel)) {
+                if (old_tat > now) {
+                    // Evicted a live key; start the new owner fresh unless it already charged
+                    victim->tat.compare_exchange_strong(old_tat, 0, std::memory_order_acq_rel);
+                }
+                return *victim;
+            }
+            // Another thread claimed the slot first; rescan in case it was for this key
+        }
+    }
+};
+
+RateLimiter::RateLimiter(const Options& opts) {
+    int max_requests = std::max(1, opts.max_requests);
+    int64_t window_us = (int64_t)std::max(1, opts.window_seconds) * 1000000;
+    limit_ = opts.burst > 0 ? opts.burst : max_requests;
+    interval_us_ = std::max<int64_t>(1, window_us / max_requests);
+    span_us_ = interval_us_ * limit_;
+
+    size_t bucket_count = round_up_pow2(std::max<size_t>(1, (opts.capacity + kWays - 1) / kWays));
+    if (opts.shared_memory_name.empty()) {
+        table_.reset(new Table(bucket_count));
+    } else {
+        table_.reset(new Table(opts.shared_memory_name, bucket_count, interval_us_, span_us_));
+    }
+}
+
+RateLimiter::~RateLimiter() = default;
+
+bool RateLimiter::remove_shared(const std::string& name) {
+#ifdef CREST_HAS_SHM
+    return shm_unlink(name.c_str()) == 0;
+#else
+    (void)name;
+    return false;
+#endif
+}
+
+bool RateLimiter::shared() const {
+    return table_->mapping != nullptr;
+}
+
+RateLimiter::Result RateLimiter::acquire(const std::string& key) {
+    return acquire(key, steady_now_us());
+}
+
+RateLimiter::Result RateLimiter::acquire(const std::string& key, int64_t now_us) {
+    uint64_t hash = hash_string(key);
+    if (hash == 0) hash = 1;
+
+    Slot& slot = table_->slot_for(hash, now_us);
+
+    Result result;
+    result.limit = limit_;
+
+    int64_t tat = slot.tat.load(std::memory_order_relaxed);
+    for (;;) {
+        int64_t new_tat = std::max(tat, now_us) + interval_us_;
+
+        if (new_tat - now_us > span_us_) {
+            result.allowed = false;
+            result.remaining = 0;
+            result.reset_us = tat - now_us;
+            result.retry_after_us = new_tat - now_us - span_us_;
+            return result;
+        }
+
+        if (slot.tat.compare_exchange_weak(tat, new_tat, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+            result.allowed = true;
+            result.remaining = (int)((span_us_ - (new_tat - now_us)) / interval_us_);
+            result.reset_us = new_tat - now_us;
+            result.retry_after_us = 0;
+            return result;
+        }
+    }
+}
+
+size_t RateLimiter::size() const {
+    int64_t now = steady_now_us();
+    size_t live = 0;
+    for (size_t i = 0; i <= table_->mask; ++i) {
+        for (const Slot& slot : table_->buckets[i].slots) {
+            if (slot.key.load(std::memory_order_relaxed) != 0 &&
+                slot.tat.load(std::memory_order_relaxed) > now) {
+                ++live;
+            }
+        }
+    }
+    return live;
+}
+
+size_t RateLimiter::capacity() const {
+    return (table_->mask + 1) * kWays;
+}
+
+} // namespace crest
@@ -47,6 +47,7 @@ int crest_route(crest_app_t* app, crest_method_t method, const char* path,
     entry->cpp_handler = nullptr;
     entry->request_schema = nullptr;
     entry->response_schema = nullptr;
+    entry->timeout_ms = 0;
     
     app->route_count++;
     return 0;
@@ -80,4 +81,46 @@ void crest_set_response_schema(crest_app_t* app, crest_method_t method, const ch
     }
 }
 
+void crest_set_route_timeout(crest_app_t* app, crest_method_t method, const char* path, int timeout_ms) {
+    if (!app || !path) return;
+    
+    std::lock_guard<std::mutex> lock(*static_cast<std::mutex*>(app->route_mutex));
+    
+    for (size_t i = 0; i < app->route_count; i++) {
+        if (app->routes[i].method == method && strcmp(app->routes[i].path, path) == 0) {
+            app->routes[i].timeout_ms = timeout_ms > 0 ? timeout_ms : 0;
+            return;
+        }
+    }
+}
+
+const char* crest_method_name(crest_method_t method) {
+    switch (method) {
+        case CREST_GET: return "GET";
+        case CREST_POST: return "POST";
+        case CREST_PUT: return "PUT";
+        case CREST_DELETE: return "DELETE";
+        case CREST_PATCH: return "PATCH";
+        case CREST_HEAD: return "HEAD";
+        case CREST_OPTIONS: return "OPTIONS";
+        default: return "";
+    }
+}
+
+bool crest_route_find(crest_app_t* app, const char* method, const char* path, crest_route_entry_t* out) {
+    if (!app || !method || !path || !out) return false;
+    
+    // Copy the entry out so the handler runs without holding the route lock
+    std::lock_guard<std::mutex> lock(*static_cast<std::mutex*>(app->route_mutex));
+    
+    for (size_t i = 0; i < app->route_count; i++) {
+        if (strcmp(method, crest_method_name(app->routes[i].method)) == 0 &&
+            strcmp(path, app->routes[i].path) == 0) {
+            *out = app->routes[i];
+            return true;
+        }
+    }
+    return false;
+}
+
 } // extern "C"
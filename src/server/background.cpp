@@ -0,0 +1,187 @@
+/**
+ * @file background.cpp
+ * @brief Background task queue and after-send work
+ */
+
+#include "crest/background.hpp"
+#include "crest/internal/app_internal.h"
+#include "crest/internal/pipeline.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#if defined(_WIN32) || defined(_WIN64) || defined(CREST_WINDOWS)
+    #include <windows.h>
+#elif defined(__linux__)
+    #include <sys/resource.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+
+extern "C" {
+    void crest_log_error(const char* msg);
+    void crest_log_warning(const char* msg);
+}
+
+namespace crest {
+
+namespace {
+
+void lower_thread_priority() {
+#if defined(_WIN32) || defined(_WIN64) || defined(CREST_WINDOWS)
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+#elif defined(__linux__)
+    // On Linux the nice value is per thread
+    setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), 10);
+#endif
+}
+
+std::mutex global_mutex;
+std::unique_ptr<BackgroundQueue> global_queue;
+BackgroundQueue::Options global_options;
+
+} // namespace
+
+BackgroundQueue::BackgroundQueue(const Options& opts)
+    : options_(opts), active_(0), stopping_(false), completed_(0), failed_(0), rejected_(0), discarded_(0) {
+    if (options_.threads == 0) options_.threads = 1;
+    workers_.reserve(options_.threads);
+    for (size_t i = 0; i < options_.threads; ++i) {
+        workers_.emplace_back([this] { worker(); });
+    }
+}
+
+BackgroundQueue::~BackgroundQueue() {
+    flush();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+        discarded_ += queue_.size();
+        queue_.clear();
+    }
+    work_cv_.notify_all();
+    for (auto& worker : workers_) {
+        if (worker.joinable()) worker.join();
+    }
+}
+
+bool BackgroundQueue::submit(Task task) {
+    if (!task) return false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_ || queue_.size() >= options_.capacity) {
+            ++rejected_;
+            return false;
+        }
+        queue_.push_back(std::move(task));
+    }
+    work_cv_.notify_one();
+    return true;
+}
+
+bool BackgroundQueue::flush(int timeout_ms) {
+    if (timeout_ms < 0) timeout_ms = options_.flush_timeout_ms;
+    std::unique_lock<std::mutex> lock(mutex_);
+    return idle_cv_.wait_for(lock, std::chrono::milliseconds(timeout_ms),
+                             [this] { return queue_.empty() && active_ == 0; });
+}
+
+BackgroundQueue::Stats BackgroundQueue::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return Stats{queue_.size(), completed_, failed_, rejected_, discarded_};
+}
+
+void BackgroundQueue::worker() {
+    if (options_.low_priority) lower_thread_priority();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        work_cv_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+        if (queue_.empty()) return;
+
+        Task task = std::move(queue_.front());
+        queue_.pop_front();
+        ++active_;
+        lock.unlock();
+
+        bool ok = true;
+        try {
+            task();
+        } catch (const std::exception& e) {
+            ok = false;
+            char msg[256];
+            snprintf(msg, sizeof(msg), "Background task failed: %s", e.what());
+            crest_log_error(msg);
+        } catch (...) {
+            ok = false;
+            crest_log_error("Background task failed");
+        }
+        task = nullptr;
+
+        lock.lock();
+        --active_;
+        ++(ok ? completed_ : failed_);
+        if (queue_.empty() && active_ == 0) idle_cv_.notify_all();
+    }
+}
+
+BackgroundQueue& background() {
+    std::lock_guard<std::mutex> lock(global_mutex);
+    if (!global_queue) global_queue.reset(new BackgroundQueue(global_options));
+    return *global_queue;
+}
+
+bool configure_background(const BackgroundQueue::Options& opts) {
+    std::lock_guard<std::mutex> lock(global_mutex);
+    if (global_queue) return false;
+    global_options = opts;
+    return true;
+}
+
+namespace internal {
+
+void submit_deferred(crest_response_t* res) {
+    if (!res || res->deferred_count == 0) return;
+
+    BackgroundQueue& queue = background();
+    size_t dropped = 0;
+    for (size_t i = 0; i < res->deferred_count; ++i) {
+        crest_deferred_t work = res->deferred[i];
+        auto run = [work]() {
+            // Cleanup runs even if fn throws
+            struct Cleanup {
+                const crest_deferred_t& work;
+                ~Cleanup() { if (work.cleanup) work.cleanup(work.arg); }
+            } cleanup{work};
+            work.fn(work.arg);
+        };
+        // A full queue means overload; running the work here would put it
+        // back on the request path, so it is dropped (counted as rejected)
+        if (!queue.submit(run)) {
+            if (work.cleanup) work.cleanup(work.arg);
+            ++dropped;
+        }
+    }
+    // Ownership of every arg has moved to the queue or been released
+    res->deferred_count = 0;
+    if (dropped > 0) {
+        char msg[128];
+        snprintf(msg, sizeof(msg), "Background queue full: dropped %zu after-send task(s)", dropped);
+        crest_log_warning(msg);
+    }
+}
+
+void flush_background() {
+    BackgroundQueue* queue;
+    {
+        std::lock_guard<std::mutex> lock(global_mutex);
+        queue = global_queue.get();
+    }
+    if (queue && !queue->flush()) {
+        crest_log_warning("Background tasks still pending at shutdown");
+    }
+}
+
+} // namespace internal
+
+} // namespace crest
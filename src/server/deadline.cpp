@@ -0,0 +1,115 @@
+/**
+ * @file deadline.cpp
+ * @brief Request deadline resolution and timeout header parsing
+ */
+
+#include "crest/deadline.hpp"
+#include "crest/crest.hpp"
+#include "crest/internal/app_internal.h"
+#include <cstdio>
+
+namespace crest {
+
+void Deadline::check() const {
+    if (expired()) {
+        throw Exception("Deadline exceeded", 504);
+    }
+}
+
+std::string Deadline::grpc_timeout() const {
+    if (!is_set()) return std::string();
+    // grpc-timeout allows at most 8 digits; fall back to coarser units as needed
+    long long ms = (long long)remaining().count();
+    char buf[16];
+    if (ms < 100000000LL) {
+        snprintf(buf, sizeof(buf), "%lldm", ms);
+    } else if (ms / 1000 < 100000000LL) {
+        snprintf(buf, sizeof(buf), "%lldS", ms / 1000);
+    } else {
+        snprintf(buf, sizeof(buf), "%lldH", ms / 3600000LL);
+    }
+    return buf;
+}
+
+bool Deadline::parse_grpc_timeout(const char* value, std::chrono::microseconds& out) {
+    if (!value) return false;
+    long long amount = 0;
+    int digits = 0;
+    const char* p = value;
+    while (*p >= '0' && *p <= '9') {
+        if (++digits > 8) return false;
+        amount = amount * 10 + (*p - '0');
+        ++p;
+    }
+    if (digits == 0 || p[0] == '\0' || p[1] != '\0') return false;
+
+    switch (*p) {
+        case 'H': out = std::chrono::hours(amount); break;
+        case 'M': out = std::chrono::minutes(amount); break;
+        case 'S': out = std::chrono::seconds(amount); break;
+        case 'm': out = std::chrono::milliseconds(amount); break;
+        case 'u': out = std::chrono::microseconds(amount); break;
+        case 'n': out = std::chrono::microseconds(amount / 1000); break;
+        default: return false;
+    }
+    return true;
+}
+
+bool Deadline::parse_request_timeout(const char* value, std::chrono::microseconds& out) {
+    if (!value) return false;
+    while (*value == ' ') ++value;
+    long long ms = 0;
+    int digits = 0;
+    for (; *value >= '0' && *value <= '9'; ++value) {
+        if (++digits > 10) return false;
+        ms = ms * 10 + (*value - '0');
+    }
+    while (*value == ' ') ++value;
+    if (digits == 0 || *value != '\0') return false;
+    out = std::chrono::milliseconds(ms);
+    return true;
+}
+
+} // namespace crest
+
+extern "C" {
+
+int64_t crest_resolve_deadline(const crest_app_t* app, const crest_route_entry_t* route,
+                               const crest_request_t* req, int64_t accepted_us) {
+    bool has_timeout = false;
+    int64_t timeout_us = 0;
+    int timeout_ms = (route && route->timeout_ms > 0) ? route->timeout_ms : (app ? app->request_timeout_ms : 0);
+    if (timeout_ms > 0) {
+        has_timeout = true;
+        timeout_us = (int64_t)timeout_ms * 1000;
+    }
+
+    // A client may ask for less time than the server allows, never more
+    if (req) {
+        std::chrono::microseconds client(0);
+        const char* grpc = crest_kv_get(&req->headers, "grpc-timeout", true);
+        const char* plain = crest_kv_get(&req->headers, "X-Request-Timeout", true);
+        if ((grpc && crest::Deadline::parse_grpc_timeout(grpc, client)) ||
+            (plain && crest::Deadline::parse_request_timeout(plain, client))) {
+            if (!has_timeout || (int64_t)client.count() < timeout_us) {
+                has_timeout = true;
+                timeout_us = (int64_t)client.count();
+            }
+        }
+    }
+
+    if (!has_timeout) return 0;
+    int64_t deadline = accepted_us + timeout_us;
+    return deadline > 0 ? deadline : 1;
+}
+
+int64_t crest_request_get_remaining_ms(crest_request_t* req) {
+    if (!req || req->deadline_us == 0) return -1;
+    return (int64_t)crest::Deadline::from_us(req->deadline_us).remaining().count();
+}
+
+bool crest_request_deadline_exceeded(crest_request_t* req) {
+    return req && crest::Deadline::from_us(req->deadline_us).expired();
+}
+
+} // extern "C"
@@ -0,0 +1,106 @@
+/**
+ * @file load_shedder.cpp
+ * @brief Adaptive concurrency limit and CoDel queue management
+ */
+
+#include "crest/internal/load_shedder.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace crest {
+namespace internal {
+
+LoadShedder::LoadShedder(const Options& opts)
+    : options_(opts),
+      limit_(0),
+      in_flight_(0),
+      rejected_(0),
+      dropped_(0),
+      limit_estimate_(0),
+      first_above_time_(0),
+      drop_next_(0),
+      drop_count_(0),
+      last_drop_count_(0),
+      dropping_(false) {
+    if (options_.min_limit == 0) options_.min_limit = 1;
+    if (options_.max_limit < options_.min_limit) options_.max_limit = options_.min_limit;
+    if (options_.interval_us <= 0) options_.interval_us = 100000;
+    // Start at the configured ceiling; drops walk it down to what the backend sustains
+    limit_estimate_ = (double)options_.max_limit;
+    limit_.store(options_.max_limit, std::memory_order_relaxed);
+}
+
+bool LoadShedder::admit() {
+    size_t current = in_flight_.load(std::memory_order_relaxed);
+    do {
+        if (current >= limit_.load(std::memory_order_relaxed)) {
+            rejected_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+    } while (!in_flight_.compare_exchange_weak(current, current + 1, std::memory_order_relaxed));
+    return true;
+}
+
+int64_t LoadShedder::control_law(int64_t t) const {
+    return t + (int64_t)((double)options_.interval_us / std::sqrt((double)drop_count_));
+}
+
+void LoadShedder::decrease_limit() {
+    limit_estimate_ = std::max((double)options_.min_limit, limit_estimate_ * 0.9);
+    limit_.store((size_t)limit_estimate_, std::memory_order_relaxed);
+}
+
+bool LoadShedder::should_drop(int64_t sojourn_us, int64_t now_us) {
+    bool drop = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        // RFC 8289: only a delay that persists for a full interval counts as a standing queue
+        bool ok_to_drop = false;
+        if (sojourn_us < options_.target_us) {
+            first_above_time_ = 0;
+        } else if (first_above_time_ == 0) {
+            first_above_time_ = now_us + options_.interval_us;
+        } else if (now_us >= first_above_time_) {
+            ok_to_drop = true;
+        }
+
+        if (dropping_) {
+            if (!ok_to_drop) {
+                dropping_ = false;
+            } else if (now_us >= drop_next_) {
+                drop = true;
+                ++drop_count_;
+                drop_next_ = control_law(drop_next_);
+            }
+        } else if (ok_to_drop) {
+            drop = true;
+            dropping_ = true;
+            // Resume near the previous drop rate if the queue came back quickly
+            uint32_t delta = drop_count_ - last_drop_count_;
+            drop_count_ = (delta > 1 && now_us - drop_next_ < 16 * options_.interval_us) ? delta : 1;
+            drop_next_ = control_law(now_us);
+            last_drop_count_ = drop_count_;
+        }
+
+        if (drop) decrease_limit();
+    }
+
+    if (drop) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        in_flight_.fetch_sub(1, std::memory_order_relaxed);
+    }
+    return drop;
+}
+
+void LoadShedder::complete(int64_t sojourn_us) {
+    if (sojourn_us < options_.target_us && limit_.load(std::memory_order_relaxed) < options_.max_limit) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        limit_estimate_ = std::min((double)options_.max_limit, limit_estimate_ + 1.0 / limit_estimate_);
+        limit_.store((size_t)limit_estimate_, std::memory_order_relaxed);
+    }
+    in_flight_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+} // namespace internal
+} // namespace crest
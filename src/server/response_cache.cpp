@@ -0,0 +1,284 @@
+/**
+ * @file response_cache.cpp
+ * @brief Route micro-cache with TinyLFU admission and stale-while-revalidate
+ */
+
+#include "crest/internal/response_cache.hpp"
+#include "../utils/hash.hpp"
+#include "../utils/frequency_sketch.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <list>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+
+namespace crest {
+namespace internal {
+
+namespace {
+
+// Bookkeeping per entry beyond key and buffer (list node, map slot, control block)
+constexpr size_t kEntryOverhead = 160;
+
+bool equals_ignore_case(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (std::tolower((unsigned char)a[i]) != std::tolower((unsigned char)b[i])) return false;
+    }
+    return true;
+}
+
+std::string_view trim(std::string_view s) {
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t' || s.back() == '\r')) s.remove_suffix(1);
+    return s;
+}
+
+// Calls fn(name, value) for the header list and the raw header block
+template <typename Fn>
+void for_each_header(const crest_response_t* res, Fn fn) {
+    for (size_t i = 0; i < res->headers.count; ++i) {
+        fn(std::string_view(res->headers.items[i].key), std::string_view(res->headers.items[i].value));
+    }
+    std::string_view raw(res->raw_headers ? res->raw_headers : "", res->raw_headers_length);
+    while (!raw.empty()) {
+        size_t end = raw.find("\r\n");
+        std::string_view line = raw.substr(0, end);
+        raw = end == std::string_view::npos ? std::string_view() : raw.substr(end + 2);
+        size_t colon = line.find(':');
+        if (colon != std::string_view::npos) fn(trim(line.substr(0, colon)), trim(line.substr(colon + 1)));
+    }
+}
+
+} // namespace
+
+struct ResponseCache::Shard {
+    struct Entry {
+        std::string key;
+        Buffer buffer;
+        int status;
+        int64_t fresh_until;
+        int64_t stale_until;
+        size_t cost;
+        bool refreshing;
+    };
+
+    std::mutex mutex;
+    std::list<Entry> lru;
+    std::unordered_map<std::string_view, std::list<Entry>::iterator> index;
+    FrequencySketch sketch;
+    size_t bytes = 0;
+
+    Shard() : sketch(4096) {}
+
+    void erase(std::list<Entry>::iterator it) {
+        bytes -= it->cost;
+        index.erase(it->key);
+        lru.erase(it);
+    }
+};
+
+ResponseCache::ResponseCache(const Options& opts)
+    : options_(opts), shard_budget_(0), shards_(new Shard[opts.shards > 0 ? opts.shards : 1]),
+      hits_(0), stale_hits_(0), misses_(0), rejected_(0), evictions_(0) {
+    if (options_.shards == 0) options_.shards = 1;
+    set_max_bytes(options_.max_bytes);
+}
+
+ResponseCache::~ResponseCache() = default;
+
+ResponseCache::Shard& ResponseCache::shard_for(uint64_t hash) const {
+    return shards_[hash % options_.shards];
+}
+
+void ResponseCache::set_max_bytes(size_t max_bytes) {
+    options_.max_bytes = max_bytes;
+    shard_budget_.store(std::max<size_t>(1, max_bytes / options_.shards), std::memory_order_relaxed);
+}
+
+ResponseCache::Lookup ResponseCache::get(const std::string& key, int64_t now_us) {
+    uint64_t hash = hash_string(key);
+    Shard& shard = shard_for(hash);
+    Lookup result;
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.sketch.increment(hash);
+
+    auto found = shard.index.find(key);
+    if (found == shard.index.end()) {
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return result;
+    }
+
+    auto entry = found->second;
+    if (now_us >= entry->stale_until) {
+        shard.erase(entry);
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return result;
+    }
+
+    shard.lru.splice(shard.lru.begin(), shard.lru, entry);
+    result.buffer = entry->buffer;
+    result.status = entry->status;
+    if (now_us < entry->fresh_until) {
+        hits_.fetch_add(1, std::memory_order_relaxed);
+        return result;
+    }
+
+    stale_hits_.fetch_add(1, std::memory_order_relaxed);
+    result.stale = true;
+    if (!entry->refreshing) {
+        entry->refreshing = true;
+        result.refresh = true;
+    }
+    return result;
+}
+
+bool ResponseCache::put(const std::string& key, Buffer buffer, int status, int64_t fresh_until_us, int64_t stale_until_us) {
+    if (!buffer) return false;
+    size_t cost = key.size() + buffer->size() + kEntryOverhead;
+    size_t budget = shard_budget_.load(std::memory_order_relaxed);
+    if (cost > budget) {
+        rejected_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    uint64_t hash = hash_string(key);
+    Shard& shard = shard_for(hash);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto found = shard.index.find(key);
+    bool replacing = found != shard.index.end();
+    if (replacing) {
+        // A refresh of a key that is already cached is always admitted
+        shard.erase(found->second);
+    } else {
+        // TinyLFU: displace residents only with a key that is requested more often
+        uint8_t candidate = shard.sketch.estimate(hash);
+        while (shard.bytes + cost > budget && !shard.lru.empty()) {
+            auto victim = std::prev(shard.lru.end());
+            if (candidate <= shard.sketch.estimate(hash_string(victim->key))) {
+                rejected_.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            shard.erase(victim);
+            evictions_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    shard.lru.push_front(Shard::Entry{key, std::move(buffer), status, fresh_until_us, stale_until_us, cost, false});
+    shard.index.emplace(shard.lru.front().key, shard.lru.begin());
+    shard.bytes += cost;
+
+    while (shard.bytes > budget && shard.lru.size() > 1) {
+        shard.erase(std::prev(shard.lru.end()));
+        evictions_.fetch_add(1, std::memory_order_relaxed);
+    }
+    return true;
+}
+
+void ResponseCache::abandon_refresh(const std::string& key) {
+    Shard& shard = shard_for(hash_string(key));
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto found = shard.index.find(key);
+    if (found != shard.index.end()) found->second->refreshing = false;
+}
+
+void ResponseCache::clear() {
+    for (size_t i = 0; i < options_.shards; ++i) {
+        std::lock_guard<std::mutex> lock(shards_[i].mutex);
+        shards_[i].index.clear();
+        shards_[i].lru.clear();
+        shards_[i].bytes = 0;
+    }
+}
+
+size_t ResponseCache::size() const {
+    size_t total = 0;
+    for (size_t i = 0; i < options_.shards; ++i) {
+        std::lock_guard<std::mutex> lock(shards_[i].mutex);
+        total += shards_[i].lru.size();
+    }
+    return total;
+}
+
+size_t ResponseCache::bytes() const {
+    size_t total = 0;
+    for (size_t i = 0; i < options_.shards; ++i) {
+        std::lock_guard<std::mutex> lock(shards_[i].mutex);
+        total += shards_[i].bytes;
+    }
+    return total;
+}
+
+ResponseCache::Stats ResponseCache::stats() const {
+    return Stats{hits_.load(std::memory_order_relaxed), stale_hits_.load(std::memory_order_relaxed),
+                 misses_.load(std::memory_order_relaxed), rejected_.load(std::memory_order_relaxed),
+                 evictions_.load(std::memory_order_relaxed)};
+}
+
+std::string CachePolicy::key_for(const crest_request_t* req) const {
+    std::string key = req->method ? req->method : "";
+    key += ' ';
+    key += req->path ? req->path : "";
+    // Unit separators keep "a=b" + "c" distinct from "a=bc"
+    for (const auto& name : query_keys) {
+        const char* value = crest_kv_get(&req->queries, name.c_str(), false);
+        key += '\x1f';
+        if (value) key += value;
+    }
+    for (const auto& name : header_keys) {
+        const char* value = crest_kv_get(&req->headers, name.c_str(), true);
+        key += '\x1e';
+        if (value) key += value;
+    }
+    return key;
+}
+
+bool CachePolicy::cacheable(const crest_response_t* res) const {
+    if (!res->sent || res->status != 200) return false;
+    bool ok = true;
+    for_each_header(res, [&](std::string_view name, std::string_view value) {
+        if (equals_ignore_case(name, "Set-Cookie")) {
+            ok = false;
+        } else if (equals_ignore_case(name, "Cache-Control")) {
+            std::string lower(value);
+            std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+            if (lower.find("no-store") != std::string::npos || lower.find("private") != std::string::npos) ok = false;
+        } else if (equals_ignore_case(name, "Vary")) {
+            // Varying on a header outside the key would serve one client's variant to others
+            while (!value.empty()) {
+                size_t comma = value.find(',');
+                std::string_view field = trim(value.substr(0, comma));
+                value = comma == std::string_view::npos ? std::string_view() : value.substr(comma + 1);
+                if (field.empty()) continue;
+                bool keyed = std::any_of(header_keys.begin(), header_keys.end(),
+                                         [&](const std::string& k) { return equals_ignore_case(k, field); });
+                if (!keyed) ok = false;
+            }
+        }
+    });
+    return ok;
+}
+
+std::string CachePolicy::storable(const crest_response_t* res, const CapturedResponse::Mark& own) {
+    // A view that starts after this request's own headers; it owns nothing
+    crest_response_t shared = *res;
+    shared.headers.items = res->headers.items + own.headers;
+    shared.headers.count = res->headers.count - own.headers;
+    shared.raw_headers = res->raw_headers ? res->raw_headers + own.raw_headers : nullptr;
+    shared.raw_headers_length = res->raw_headers_length - own.raw_headers;
+    
+    size_t length = 0;
+    char* raw = crest_response_serialize(&shared, &length);
+    if (!raw) return std::string();
+    std::string out(raw, length);
+    free(raw);
+    return out;
+}
+
+} // namespace internal
+} // namespace crest
@@ -0,0 +1,227 @@
+/**
+ * @file scheduler.cpp
+ * @brief Timer wheel for periodic and delayed jobs
+ */
+
+#include "crest/internal/scheduler.hpp"
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+
+extern "C" {
+    void crest_log_error(const char* msg);
+}
+
+namespace crest {
+
+void Timer::cancel() {
+    if (state_) state_->cancelled = true;
+}
+
+bool Timer::active() const {
+    return state_ && !state_->cancelled && !state_->finished;
+}
+
+uint64_t Timer::runs() const {
+    return state_ ? state_->runs.load() : 0;
+}
+
+uint64_t Timer::skipped() const {
+    return state_ ? state_->skipped.load() : 0;
+}
+
+namespace internal {
+
+namespace {
+
+int64_t random_ticks(int64_t max_ticks) {
+    if (max_ticks <= 0) return 0;
+    thread_local std::minstd_rand rng(std::random_device{}());
+    return (int64_t)(rng() % (uint64_t)(max_ticks + 1));
+}
+
+void run_timer(const std::shared_ptr<TimerState>& timer) {
+    try {
+        timer->job();
+    } catch (const std::exception& e) {
+        crest_log_error((std::string("Timer job failed: ") + e.what()).c_str());
+    } catch (...) {
+        crest_log_error("Timer job failed");
+    }
+    if (!timer->allow_overlap) timer->running = false;
+}
+
+} // namespace
+
+Scheduler::Scheduler(const Options& opts)
+    : options_(opts), armed_(0), current_tick_(0), stopping_(false) {
+    if (options_.tick_ms <= 0) options_.tick_ms = 10;
+    if (options_.slots == 0) options_.slots = 1;
+    wheel_.resize(options_.slots);
+}
+
+Scheduler::~Scheduler() {
+    stop();
+}
+
+int64_t Scheduler::now_tick() const {
+    return Deadline::now_us() / ((int64_t)options_.tick_ms * 1000);
+}
+
+Timer Scheduler::schedule(int delay_ms, int interval_ms, Task job, const TimerOptions& options) {
+    auto timer = std::make_shared<TimerState>();
+    int64_t tick_ms = options_.tick_ms;
+    timer->job = std::move(job);
+    timer->delay_ticks = std::max<int64_t>(0, (delay_ms + tick_ms - 1) / tick_ms);
+    timer->interval_ticks = interval_ms > 0 ? std::max<int64_t>(1, (interval_ms + tick_ms - 1) / tick_ms) : 0;
+    timer->jitter_ticks = std::max<int64_t>(0, (options.jitter_ms + tick_ms - 1) / tick_ms);
+    timer->allow_overlap = options.allow_overlap;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (executor_) {
+        arm(timer, now_tick());
+    } else {
+        pending_.push_back(timer);
+    }
+    return Timer(timer);
+}
+
+void Scheduler::arm(const std::shared_ptr<TimerState>& timer, int64_t now) {
+    if (armed_ == 0) {
+        // The wheel stood still while empty; restart it from the present
+        current_tick_ = now;
+        cv_.notify_one();
+    }
+    // Due no earlier than the next tick, which the wheel has not yet visited
+    timer->base_tick = std::max(now, current_tick_) + std::max<int64_t>(1, timer->delay_ticks);
+    timer->due_tick = timer->base_tick + random_ticks(timer->jitter_ticks);
+    wheel_[(size_t)(timer->due_tick % (int64_t)options_.slots)].push_back(timer);
+    ++armed_;
+}
+
+void Scheduler::advance(int64_t now, std::vector<std::shared_ptr<TimerState>>& due) {
+    if (now <= current_tick_) return;
+
+    // After a gap longer than one revolution every slot is due exactly once
+    int64_t slots = (int64_t)options_.slots;
+    int64_t steps = std::min(now - current_tick_, slots);
+    std::vector<std::shared_ptr<TimerState>> slot;
+    for (int64_t tick = now - steps + 1; tick <= now; ++tick) {
+        slot.clear();
+        slot.swap(wheel_[(size_t)(tick % slots)]);
+        for (auto& timer : slot) {
+            if (timer->cancelled) {
+                --armed_;
+                continue;
+            }
+            if (timer->due_tick > now) {
+                wheel_[(size_t)(timer->due_tick % slots)].push_back(std::move(timer));
+                continue;
+            }
+
+            if (!timer->allow_overlap && timer->running.exchange(true)) {
+                ++timer->skipped;
+            } else {
+                ++timer->runs;
+                due.push_back(timer);
+            }
+
+            if (timer->interval_ticks == 0) {
+                timer->finished = true;
+                --armed_;
+                continue;
+            }
+            // Step along the original schedule so runs do not drift, skipping
+            // the ones missed while the process was stalled
+            timer->base_tick += timer->interval_ticks;
+            if (timer->base_tick <= now) {
+                timer->base_tick += ((now - timer->base_tick) / timer->interval_ticks + 1) * timer->interval_ticks;
+            }
+            timer->due_tick = timer->base_tick + random_ticks(timer->jitter_ticks);
+            wheel_[(size_t)(timer->due_tick % slots)].push_back(std::move(timer));
+        }
+    }
+    current_tick_ = now;
+}
+
+void Scheduler::loop() {
+    std::vector<std::shared_ptr<TimerState>> due;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_) {
+        if (armed_ == 0) {
+            cv_.wait(lock, [this] { return stopping_ || armed_ > 0; });
+            continue;
+        }
+
+        int64_t tick_us = (int64_t)options_.tick_ms * 1000;
+        int64_t wait_us = (current_tick_ + 1) * tick_us - Deadline::now_us();
+        if (wait_us > 0) {
+            cv_.wait_for(lock, std::chrono::microseconds(wait_us));
+            if (stopping_) break;
+        }
+
+        advance(now_tick(), due);
+        if (due.empty()) continue;
+
+        Executor executor = executor_;
+        lock.unlock();
+        for (auto& timer : due) {
+            executor([timer] { run_timer(timer); });
+        }
+        due.clear();
+        lock.lock();
+    }
+}
+
+void Scheduler::start(Executor executor) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (executor_ || !executor) return;
+
+    executor_ = std::move(executor);
+    stopping_ = false;
+    int64_t now = now_tick();
+    for (auto& timer : pending_) {
+        if (!timer->cancelled) arm(timer, now);
+    }
+    pending_.clear();
+    thread_ = std::thread([this] { loop(); });
+}
+
+void Scheduler::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!executor_) return;
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    if (thread_.joinable()) thread_.join();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& slot : wheel_) {
+        for (auto& timer : slot) {
+            if (!timer->cancelled) pending_.push_back(std::move(timer));
+        }
+        slot.clear();
+    }
+    armed_ = 0;
+    executor_ = nullptr;
+    stopping_ = false;
+}
+
+size_t Scheduler::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t live = 0;
+    for (const auto& timer : pending_) {
+        if (!timer->cancelled) ++live;
+    }
+    for (const auto& slot : wheel_) {
+        for (const auto& timer : slot) {
+            if (!timer->cancelled) ++live;
+        }
+    }
+    return live;
+}
+
+} // namespace internal
+} // namespace crest
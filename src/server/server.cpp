@@ -6,18 +6,29 @@
 #include "crest/crest.h"
 #include "crest/crest.hpp"
 #include "crest/internal/app_internal.h"
+#include "crest/internal/pipeline.hpp"
+#include "crest/internal/load_shedder.hpp"
+#include "crest/internal/scheduler.hpp"
+#include "crest/middleware.hpp"
 #include "../utils/thread_pool.hpp"
 #include <cstdio>
+#include <cctype>
 #include <cstring>
 #include <cstdlib>
 #include <thread>
 #include <atomic>
+#include <functional>
+#include <memory>
 #include <mutex>
+#include <string>
+#include <chrono>
+#include <vector>
 
 extern "C" {
     void crest_log_info(const char* msg);
     void crest_log_success(const char* msg);
     void crest_log_error(const char* msg);
+    void crest_log_warning(const char* msg);
     void crest_log_request(const char* method, const char* path, int status);
 }
 
@@ -40,12 +51,67 @@ extern "C" {
     #define closesocket close
 #endif
 
+namespace crest {
+namespace internal {
+
+/**
+ * @brief One connection from its parsed request until its response is sent
+ *
+ * Heap-allocated so a handler can finish the response after returning: the
+ * worker holds it while dispatching, hold_response() adds holds, and the
+ * last release sends the response and frees everything.
+ */
+struct Exchange {
+    crest_app_t* app = nullptr;
+    SOCKET socket = INVALID_SOCKET;
+    crest_request_t req = {};
+    crest_response_t res = {};
+    const CachePolicy* cache = nullptr;
+    std::string cache_key;
+    CapturedResponse::Mark own_headers = {0, 0};    // Set by middleware ahead of the handler; never stored
+    bool revalidating = false;
+    bool answered = false;          // A deadline already sent the client a 504
+    std::atomic<int> holds{1};
+    std::vector<std::function<void(bool)>> on_release;   // See when_released()
+};
+
+/**
+ * @brief A response deferred with crest_response_defer()
+ *
+ * Shared with the deadline timer; the mutex decides whether completion or
+ * the deadline answers the client.
+ */
+struct PendingState {
+    std::mutex mutex;
+    Exchange* ex = nullptr;
+    bool done = false;
+    Timer deadline;
+};
+
+} // namespace internal
+} // namespace crest
+
 static std::atomic<bool> server_running{false};
+// Accepted connections whose response is not yet sent, including suspended ones
+static std::atomic<size_t> open_connections{0};
+// Guards app->thread_pool against handlers resuming while it is torn down
+static std::mutex pool_mutex;
 
 static const char* get_swagger_html(crest_app_t* app);
 static const char* get_openapi_json(crest_app_t* app);
-static void handle_client(SOCKET client_socket, crest_app_t* app);
+static void handle_client(SOCKET client_socket, const struct sockaddr_in& client_addr, crest_app_t* app, int64_t accepted_us);
+static void finish_exchange(crest::internal::Exchange* ex);
+static void discard_exchange(crest::internal::Exchange* ex);
+static void wait_for_connections(const crest_app_t* app);
+static void expire_pending(crest::internal::PendingState& pending);
+
+struct crest_pending {
+    std::shared_ptr<crest::internal::PendingState> state;
+};
+static void shed_client(SOCKET client_socket);
 static void parse_request(const char* buffer, crest_request_t* req);
+static void send_all(SOCKET client_socket, const char* data, size_t length);
+static void send_hit(SOCKET client_socket, const std::string& stored, const crest_response_t& res);
 
 extern "C" {
 
@@ -101,6 +167,28 @@ int crest_run(crest_app_t* app, const char* host, int port) {
     snprintf(msg, sizeof(msg), "Thread pool initialized with %zu workers", num_threads * 2);
     crest_log_info(msg);
     
+    // Timer jobs share the request pool; the wheel thread only dispatches them
+    auto* scheduler = static_cast<crest::internal::Scheduler*>(app->scheduler);
+    if (scheduler) {
+        auto* pool = static_cast<crest::ThreadPool*>(app->thread_pool);
+        scheduler->start([pool](std::function<void()> job) { pool->enqueue(std::move(job)); });
+    }
+    
+    // Load shedding sits between accept() and the pool: over the adaptive limit
+    // connections are refused here, and CoDel drops them when they wait too long
+    std::unique_ptr<crest::internal::LoadShedder> shedder;
+    if (app->shed_target_ms > 0) {
+        crest::internal::LoadShedder::Options shed_opts;
+        shed_opts.target_us = (int64_t)app->shed_target_ms * 1000;
+        shed_opts.interval_us = (int64_t)app->shed_interval_ms * 1000;
+        shed_opts.min_limit = num_threads * 2;
+        shed_opts.max_limit = (size_t)app->shed_max_concurrency;
+        shedder.reset(new crest::internal::LoadShedder(shed_opts));
+        snprintf(msg, sizeof(msg), "Load shedding enabled (target %dms, interval %dms)",
+                 app->shed_target_ms, app->shed_interval_ms);
+        crest_log_info(msg);
+    }
+    
     if (app->docs_enabled) {
         snprintf(msg, sizeof(msg), "Documentation: http://%s:%d/docs", host, port);
         crest_log_info(msg);
@@ -113,16 +201,52 @@ int crest_run(crest_app_t* app, const char* host, int port) {
         socklen_t client_len = sizeof(client_addr);
         SOCKET client_socket = accept(server_socket, (struct sockaddr*)&client_addr, &client_len);
         
-        if (client_socket != INVALID_SOCKET) {
-            auto* pool = static_cast<crest::ThreadPool*>(app->thread_pool);
-            pool->enqueue([client_socket, app]() {
-                handle_client(client_socket, app);
+        if (client_socket == INVALID_SOCKET) continue;
+        
+        // Deadlines and queueing delay both count from here
+        int64_t accepted_us = crest::Deadline::now_us();
+        auto* pool = static_cast<crest::ThreadPool*>(app->thread_pool);
+        crest::internal::LoadShedder* limiter = shedder.get();
+        if (!limiter) {
+            ++open_connections;
+            pool->enqueue([client_socket, client_addr, app, accepted_us]() {
+                handle_client(client_socket, client_addr, app, accepted_us);
             });
+            continue;
         }
+        
+        if (!limiter->admit()) {
+            shed_client(client_socket);
+            continue;
+        }
+        ++open_connections;
+        pool->enqueue([client_socket, client_addr, app, limiter, accepted_us]() {
+            int64_t now = crest::Deadline::now_us();
+            int64_t sojourn = now - accepted_us;
+            if (limiter->should_drop(sojourn, now)) {
+                shed_client(client_socket);
+                --open_connections;
+                return;
+            }
+            handle_client(client_socket, client_addr, app, accepted_us);
+            limiter->complete(sojourn);
+        });
     }
     
-    delete static_cast<crest::ThreadPool*>(app->thread_pool);
-    app->thread_pool = nullptr;
+    // Suspended handlers still need the pool to finish their responses
+    wait_for_connections(app);
+    
+    // No new timer runs once stopping; runs already queued finish with the requests,
+    // which may still queue after-send work
+    if (scheduler) scheduler->stop();
+    crest::ThreadPool* pool = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        pool = static_cast<crest::ThreadPool*>(app->thread_pool);
+        app->thread_pool = nullptr;
+    }
+    delete pool;
+    crest::internal::flush_background();
     
     closesocket(server_socket);
 #if defined(_WIN32) || defined(_WIN64) || defined(CREST_WINDOWS)
@@ -139,23 +263,70 @@ void crest_stop(crest_app_t* app) {
     }
 }
 
+crest_pending_t* crest_response_defer(crest_response_t* res) {
+    if (!crest::internal::hold_response(res)) return NULL;
+    
+    auto* pending = new crest_pending{std::make_shared<crest::internal::PendingState>()};
+    auto* ex = static_cast<crest::internal::Exchange*>(res->exchange);
+    pending->state->ex = ex;
+    if (ex->req.deadline_us != 0) {
+        int64_t delay_ms = (ex->req.deadline_us - crest::Deadline::now_us() + 999) / 1000;
+        std::shared_ptr<crest::internal::PendingState> state = pending->state;
+        state->deadline = crest::internal::run_after(delay_ms > 0 ? delay_ms : 0, [state] { expire_pending(*state); });
+    }
+    return pending;
+}
+
+void crest_response_complete(crest_pending_t* pending) {
+    if (!pending) return;
+    crest::internal::Exchange* ex;
+    {
+        std::lock_guard<std::mutex> lock(pending->state->mutex);
+        pending->state->done = true;
+        ex = pending->state->ex;
+    }
+    pending->state->deadline.cancel();
+    delete pending;
+    crest::internal::release_response(&ex->res);
+}
+
 } // extern "C"
 
-static void handle_client(SOCKET client_socket, crest_app_t* app) {
+static void handle_client(SOCKET client_socket, const struct sockaddr_in& client_addr, crest_app_t* app, int64_t accepted_us) {
     char buffer[8192] = {0};
     int bytes_read = recv(client_socket, buffer, sizeof(buffer) - 1, 0);
     
     if (bytes_read <= 0) {
         closesocket(client_socket);
+        --open_connections;
         return;
     }
     
-    crest_request_t req = {0};
+    auto* ex = new crest::internal::Exchange();
+    ex->app = app;
+    ex->socket = client_socket;
+    crest_request_t& req = ex->req;
+    crest_response_t& res = ex->res;
     parse_request(buffer, &req);
+    inet_ntop(AF_INET, (void*)&client_addr.sin_addr, req.remote_addr, sizeof(req.remote_addr));
+    
+    // CORS preflights need no route, handler or middleware chain
+    if (app->cors && crest::CorsMiddleware::is_preflight(&req)) {
+        std::string raw;
+        static_cast<const crest::CorsMiddleware*>(app->cors)->preflight(
+            crest_kv_get(&req.headers, "Origin", true),
+            crest_kv_get(&req.headers, "Access-Control-Request-Headers", true),
+            raw);
+        send_all(client_socket, raw.data(), raw.size());
+        crest_log_request(req.method, req.path, 204);
+        closesocket(client_socket);
+        discard_exchange(ex);
+        return;
+    }
     
-    crest_response_t res = {0};
     res.status = 200;
     res.sent = false;
+    res.exchange = ex;
     
     // Handle docs routes only if docs are enabled
     bool is_docs_route = (strcmp(req.path, "/docs") == 0 || 
@@ -178,67 +349,309 @@ static void handle_client(SOCKET client_socket, crest_app_t* app) {
         }
     }
     else {
-        // Find matching route (thread-safe read)
-        bool found = false;
-        std::lock_guard<std::mutex> lock(*static_cast<std::mutex*>(app->route_mutex));
-        for (size_t i = 0; i < app->route_count; i++) {
-            const char* method_str = "";
-            switch (app->routes[i].method) {
-                case CREST_GET: method_str = "GET"; break;
-                case CREST_POST: method_str = "POST"; break;
-                case CREST_PUT: method_str = "PUT"; break;
-                case CREST_DELETE: method_str = "DELETE"; break;
-                case CREST_PATCH: method_str = "PATCH"; break;
-                default: break;
+        crest_route_entry_t route;
+        if (crest_route_find(app, req.method, req.path, &route)) {
+            ex->cache = crest::internal::cache_policy(route);
+            crest::internal::ResponseCache::Lookup hit;
+            if (ex->cache) {
+                ex->cache_key = ex->cache->key_for(&req);
+                hit = ex->cache->store->get(ex->cache_key, crest::Deadline::now_us());
             }
             
-            if (strcmp(req.method, method_str) == 0 && strcmp(req.path, app->routes[i].path) == 0) {
-                found = true;
-                if (app->routes[i].cpp_handler) {
-                    // Call C++ handler
-                    auto* handler = static_cast<crest::Handler*>(app->routes[i].cpp_handler);
-                    crest::Request cpp_req(&req);
-                    crest::Response cpp_res(&res);
-                    (*handler)(cpp_req, cpp_res);
-                } else if (app->routes[i].handler) {
-                    // Call C handler
-                    app->routes[i].handler(&req, &res);
+            req.deadline_us = crest_resolve_deadline(app, &route, &req, accepted_us);
+            if (hit.buffer) {
+                // The middleware runs once, as for a miss: auth and rate limits
+                // decide who gets the hit, and one that answers (401, 429, ...)
+                // sends its own response instead
+                bool served = false;
+                crest::internal::dispatch(route, &req, &res, [&] {
+                    ex->own_headers = crest::internal::CapturedResponse::mark(&res);
+                    send_hit(client_socket, *hit.buffer, res);
+                    crest_log_request(req.method, req.path, hit.status);
+                    closesocket(client_socket);
+                    ex->socket = INVALID_SOCKET;
+                    served = true;
+                    // The stale-while-revalidate winner goes on to the handler; the client already has its answer
+                    ex->revalidating = hit.refresh;
+                    return hit.refresh;
+                });
+                if (served && !hit.refresh) {
+                    discard_exchange(ex);
+                    return;
                 }
-                break;
+                if (!served && hit.refresh) ex->cache->store->abandon_refresh(ex->cache_key);
+            } else if (req.deadline_us != 0 && crest::Deadline::now_us() >= req.deadline_us) {
+                // Work that waited in the queue past its deadline is not started
+                crest_response_json(&res, 504, "{\"error\":\"Deadline Exceeded\"}");
+            } else if (ex->cache) {
+                crest::internal::dispatch(route, &req, &res, [&] {
+                    ex->own_headers = crest::internal::CapturedResponse::mark(&res);
+                    return true;
+                });
+            } else {
+                crest::internal::dispatch(route, &req, &res);
             }
-        }
-        
-        if (!found) {
+        } else {
             crest_response_json(&res, 404, "{\"error\":\"Not Found\"}");
         }
     }
     
-    // Log request
-    crest_log_request(req.method, req.path, res.status);
+    // A handler that holds the response sends it when it releases it
+    crest::internal::release_response(&res);
+}
+
+static void finish_exchange(crest::internal::Exchange* ex) {
+    crest_request_t& req = ex->req;
+    crest_response_t& res = ex->res;
+    const crest::internal::CachePolicy* cache = ex->cache;
     
-    if (res.body) {
-        send(client_socket, res.body, (int)strlen(res.body), 0);
-        free(res.body);
+    // Log request
+    if (!ex->revalidating && !ex->answered) crest_log_request(req.method, req.path, res.status);
+    
+    bool stored = false;
+    if (res.sent && !ex->answered) {
+        size_t length = 0;
+        char* raw = crest_response_serialize(&res, &length);
+        if (raw) {
+            if (cache && cache->cacheable(&res)) {
+                auto buffer = std::make_shared<const std::string>(crest::internal::CachePolicy::storable(&res, ex->own_headers));
+                int64_t fresh_until = crest::Deadline::now_us() + cache->ttl_us;
+                stored = cache->store->put(ex->cache_key, buffer, res.status, fresh_until, fresh_until + cache->stale_us);
+            }
+            if (ex->socket != INVALID_SOCKET) send_all(ex->socket, raw, length);
+            free(raw);
+        }
     }
+    if (ex->revalidating && !stored) cache->store->abandon_refresh(ex->cache_key);
     
-    free(req.method);
-    free(req.path);
-    free(req.body);
+    // The client has its answer before any after-send work is queued. Work of
+    // a response never sent (or superseded by a deadline 504) is released by
+    // discard_exchange without running
+    if (ex->socket != INVALID_SOCKET) closesocket(ex->socket);
+    ex->socket = INVALID_SOCKET;
+    if (res.sent && !ex->answered) crest::internal::submit_deferred(&res);
     
+    discard_exchange(ex);
+}
+
+static void expire_pending(crest::internal::PendingState& pending) {
+    static const char response[] =
+        "HTTP/1.1 504 Gateway Timeout\r\n"
+        "Content-Type: application/json\r\n"
+        "Content-Length: 29\r\n"
+        "\r\n"
+        "{\"error\":\"Deadline Exceeded\"}";
+    
+    std::lock_guard<std::mutex> lock(pending.mutex);
+    if (pending.done) return;
+    // The handler still owns res; only the socket is answered here
+    crest::internal::Exchange* ex = pending.ex;
+    ex->answered = true;
+    crest_log_request(ex->req.method, ex->req.path, 504);
+    SOCKET client_socket = ex->socket;
+    ex->socket = INVALID_SOCKET;
+    if (client_socket == INVALID_SOCKET) return;
+    // This runs on the shared timer wheel; a slow client must not hold up
+    // other deadlines and sleeps, so the write goes to the request pool
+    crest::internal::post_to_pool(&ex->res, [client_socket] {
+        send_all(client_socket, response, sizeof(response) - 1);
+        closesocket(client_socket);
+    });
+}
+
+static void discard_exchange(crest::internal::Exchange* ex) {
+    bool delivered = ex->res.sent && !ex->answered;
+    for (auto& task : ex->on_release) task(delivered);
+    crest_response_free(&ex->res);
+    crest_request_free(&ex->req);
+    delete ex;
+    --open_connections;
+}
+
+static void wait_for_connections(const crest_app_t* app) {
+    int64_t limit_ms = app->request_timeout_ms > 0 ? app->request_timeout_ms : 30000;
+    int64_t give_up = crest::Deadline::now_us() + limit_ms * 1000;
+    while (open_connections > 0 && crest::Deadline::now_us() < give_up) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    if (open_connections > 0) {
+        char msg[128];
+        snprintf(msg, sizeof(msg), "%zu connections still open at shutdown", open_connections.load());
+        crest_log_warning(msg);
+    }
+}
+
+namespace crest {
+namespace internal {
+
+bool hold_response(crest_response_t* res) {
+    if (!res || !res->exchange) return false;
+    ++static_cast<Exchange*>(res->exchange)->holds;
+    return true;
+}
+
+bool when_released(crest_response_t* res, std::function<void(bool delivered)> task) {
+    if (!res || !res->exchange) return false;
+    static_cast<Exchange*>(res->exchange)->on_release.push_back(std::move(task));
+    return true;
+}
+
+void release_response(crest_response_t* res) {
+    auto* ex = static_cast<Exchange*>(res->exchange);
+    if (--ex->holds == 0) finish_exchange(ex);
+}
+
+void post_to_pool(crest_response_t* res, std::function<void()> task) {
+    auto* ex = static_cast<Exchange*>(res->exchange);
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        auto* pool = static_cast<ThreadPool*>(ex->app->thread_pool);
+        if (pool) {
+            pool->enqueue(std::move(task));
+            return;
+        }
+    }
+    task();
+}
+
+} // namespace internal
+} // namespace crest
+
+static void shed_client(SOCKET client_socket) {
+    static const char response[] =
+        "HTTP/1.1 503 Service Unavailable\r\n"
+        "Content-Type: application/json\r\n"
+        "Content-Length: 31\r\n"
+        "Retry-After: 1\r\n"
+        "\r\n"
+        "{\"error\":\"Service Unavailable\"}";
+    
+#ifdef MSG_DONTWAIT
+    // Consume whatever request bytes already arrived so close() does not reset
+    // the connection before the client reads the 503
+    char discard[4096];
+    while (recv(client_socket, discard, sizeof(discard), MSG_DONTWAIT) > 0) {}
+#endif
+    send_all(client_socket, response, sizeof(response) - 1);
     closesocket(client_socket);
 }
 
+static void send_all(SOCKET client_socket, const char* data, size_t length) {
+    while (length > 0) {
+        int sent = send(client_socket, data, (int)length, 0);
+        if (sent <= 0) return;
+        data += sent;
+        length -= (size_t)sent;
+    }
+}
+
+static bool same_name(const char* a, const char* b) {
+    while (*a && *b && tolower((unsigned char)*a) == tolower((unsigned char)*b)) {
+        a++;
+        b++;
+    }
+    return *a == '\0' && *b == '\0';
+}
+
+// Sends a stored response with the headers the route's middleware set for
+// this request (rate-limit counters, CORS, ...) added after the status line.
+// Stored copies never hold those, so nothing is sent twice
+static void send_hit(SOCKET client_socket, const std::string& stored, const crest_response_t& res) {
+    size_t status_end = stored.find("\r\n");
+    if ((res.headers.count == 0 && res.raw_headers_length == 0) || status_end == std::string::npos) {
+        send_all(client_socket, stored.data(), stored.size());
+        return;
+    }
+    
+    std::string out;
+    out.reserve(stored.size() + 64 * res.headers.count + res.raw_headers_length);
+    out.append(stored, 0, status_end + 2);
+    for (size_t i = 0; i < res.headers.count; i++) {
+        const crest_kv_t& h = res.headers.items[i];
+        if (same_name(h.key, "Content-Type") || same_name(h.key, "Content-Length") || same_name(h.key, "Connection")) continue;
+        out.append(h.key).append(": ").append(h.value).append("\r\n");
+    }
+    if (res.raw_headers_length > 0) out.append(res.raw_headers, res.raw_headers_length);
+    out.append(stored, status_end + 2, std::string::npos);
+    send_all(client_socket, out.data(), out.size());
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static std::string url_decode(const char* begin, const char* end) {
+    std::string out;
+    out.reserve(end - begin);
+    for (const char* p = begin; p < end; ++p) {
+        if (*p == '+') {
+            out += ' ';
+        } else if (*p == '%' && end - p > 2 && hex_value(p[1]) >= 0 && hex_value(p[2]) >= 0) {
+            out += (char)(hex_value(p[1]) * 16 + hex_value(p[2]));
+            p += 2;
+        } else {
+            out += *p;
+        }
+    }
+    return out;
+}
+
+static void parse_query(const char* query, crest_request_t* req) {
+    const char* p = query;
+    while (*p) {
+        const char* amp = strchr(p, '&');
+        const char* end = amp ? amp : p + strlen(p);
+        const char* eq = (const char*)memchr(p, '=', end - p);
+        if (end > p) {
+            std::string key = url_decode(p, eq ? eq : end);
+            std::string value = eq ? url_decode(eq + 1, end) : "";
+            crest_kv_add(&req->queries, key.c_str(), value.c_str());
+        }
+        if (!amp) break;
+        p = amp + 1;
+    }
+}
+
 static void parse_request(const char* buffer, crest_request_t* req) {
     char method[16] = {0};
     char path[1024] = {0};
     
     sscanf(buffer, "%15s %1023s", method, path);
     
+    char* query = strchr(path, '?');
+    if (query) {
+        *query++ = '\0';
+        req->query_string = strdup(query);
+        parse_query(query, req);
+    }
+    
     req->method = strdup(method);
     req->path = strdup(path);
     req->body = strdup("");
     
     const char* body_start = strstr(buffer, "\r\n\r\n");
+    
+    // Header lines sit between the request line and the blank line
+    const char* line = strstr(buffer, "\r\n");
+    while (line && line != body_start) {
+        line += 2;
+        const char* eol = strstr(line, "\r\n");
+        if (!eol) break;
+        const char* colon = (const char*)memchr(line, ':', eol - line);
+        if (colon) {
+            const char* value = colon + 1;
+            while (value < eol && (*value == ' ' || *value == '\t')) value++;
+            const char* value_end = eol;
+            while (value_end > value && (value_end[-1] == ' ' || value_end[-1] == '\t')) value_end--;
+            std::string key(line, colon - line);
+            std::string val(value, value_end - value);
+            crest_kv_add(&req->headers, key.c_str(), val.c_str());
+        }
+        line = eol;
+    }
     if (body_start) {
         free(req->body);
         req->body = strdup(body_start + 4);
@@ -0,0 +1,81 @@
+/**
+ * @file frequency_sketch.hpp
+ * @brief Count-min sketch of recent access frequency for TinyLFU admission
+ */
+
+#ifndef CREST_FREQUENCY_SKETCH_HPP
+#define CREST_FREQUENCY_SKETCH_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace crest {
+
+/**
+ * @brief Approximate per-key access counts that decay over time
+ *
+ * Four rows of saturating 4-bit-range counters indexed by double hashing.
+ * After sample_size increments every counter is halved, so the estimate
+ * reflects recent popularity rather than all-time totals. Not thread-safe.
+ */
+class FrequencySketch {
+public:
+    /**
+     * @param width Counters per row, rounded up to a power of two
+     */
+    explicit FrequencySketch(size_t width = 1024) {
+        size_t w = 16;
+        while (w < width) w <<= 1;
+        width_ = w;
+        mask_ = w - 1;
+        counters_.assign(w * kRows, 0);
+        sample_size_ = w * 10;
+        additions_ = 0;
+    }
+
+    void increment(uint64_t hash) {
+        bool added = false;
+        for (size_t row = 0; row < kRows; ++row) {
+            uint8_t& counter = counters_[index(hash, row)];
+            if (counter < kMaxCount) {
+                ++counter;
+                added = true;
+            }
+        }
+        if (added && ++additions_ >= sample_size_) age();
+    }
+
+    uint8_t estimate(uint64_t hash) const {
+        uint8_t result = kMaxCount;
+        for (size_t row = 0; row < kRows; ++row) {
+            result = std::min(result, counters_[index(hash, row)]);
+        }
+        return result;
+    }
+
+private:
+    static constexpr size_t kRows = 4;
+    static constexpr uint8_t kMaxCount = 15;
+
+    size_t index(uint64_t hash, size_t row) const {
+        uint64_t step = (hash >> 32) | 1;
+        return row * width_ + (size_t)((hash + row * step) & mask_);
+    }
+
+    void age() {
+        for (uint8_t& counter : counters_) counter >>= 1;
+        additions_ /= 2;
+    }
+
+    std::vector<uint8_t> counters_;
+    size_t width_;
+    size_t mask_;
+    size_t sample_size_;
+    size_t additions_;
+};
+
+} // namespace crest
+
+#endif // CREST_FREQUENCY_SKETCH_HPP
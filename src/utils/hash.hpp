@@ -0,0 +1,104 @@
+/**
+ * @file hash.hpp
+ * @brief Fast non-cryptographic hashing for cache keys and ETags
+ */
+
+#ifndef CREST_HASH_HPP
+#define CREST_HASH_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include <string>
+
+namespace crest {
+
+namespace hash_detail {
+
+inline uint64_t read64(const unsigned char* p) {
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint64_t read32(const unsigned char* p) {
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// 64x64 -> 128 multiply folded back to 64 bits
+inline uint64_t mix(uint64_t a, uint64_t b) {
+#if defined(__SIZEOF_INT128__)
+    __uint128_t r = (__uint128_t)a * b;
+    return (uint64_t)r ^ (uint64_t)(r >> 64);
+#else
+    uint64_t ha = a >> 32, hb = b >> 32, la = (uint32_t)a, lb = (uint32_t)b;
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t t = rl + (rm0 << 32);
+    uint64_t c = t < rl;
+    uint64_t lo = t + (rm1 << 32);
+    c += lo < t;
+    uint64_t hi = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+    return lo ^ hi;
+#endif
+}
+
+constexpr uint64_t P0 = 0xa0761d6478bd642full;
+constexpr uint64_t P1 = 0xe7037ed1a0b428dbull;
+constexpr uint64_t P2 = 0x8ebc6af09c88c6e3ull;
+constexpr uint64_t P3 = 0x589965cc75374cc3ull;
+
+} // namespace hash_detail
+
+/**
+ * @brief Hash a byte range (wyhash-style, 16 bytes per step)
+ */
+inline uint64_t hash_bytes(const void* data, size_t length, uint64_t seed = 0) {
+    using namespace hash_detail;
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    seed ^= mix(seed ^ P0, P1);
+
+    uint64_t a, b;
+    if (length <= 16) {
+        if (length >= 4) {
+            a = (read32(p) << 32) | read32(p + ((length >> 3) << 2));
+            b = (read32(p + length - 4) << 32) | read32(p + length - 4 - ((length >> 3) << 2));
+        } else if (length > 0) {
+            a = ((uint64_t)p[0] << 16) | ((uint64_t)p[length >> 1] << 8) | p[length - 1];
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        size_t i = length;
+        if (i > 48) {
+            uint64_t s1 = seed, s2 = seed;
+            do {
+                seed = mix(read64(p) ^ P1, read64(p + 8) ^ seed);
+                s1 = mix(read64(p + 16) ^ P2, read64(p + 24) ^ s1);
+                s2 = mix(read64(p + 32) ^ P3, read64(p + 40) ^ s2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= s1 ^ s2;
+        }
+        while (i > 16) {
+            seed = mix(read64(p) ^ P1, read64(p + 8) ^ seed);
+            i -= 16;
+            p += 16;
+        }
+        a = read64(p + i - 16);
+        b = read64(p + i - 8);
+    }
+
+    return mix(P1 ^ length, mix(a ^ P1, b ^ seed));
+}
+
+inline uint64_t hash_string(const std::string& s, uint64_t seed = 0) {
+    return hash_bytes(s.data(), s.size(), seed);
+}
+
+} // namespace crest
+
+#endif // CREST_HASH_HPP
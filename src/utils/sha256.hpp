@@ -0,0 +1,174 @@
+/**
+ * @file sha256.hpp
+ * @brief SHA-256 and HMAC-SHA256 for token signing and verification
+ */
+
+#ifndef CREST_SHA256_HPP
+#define CREST_SHA256_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include <string>
+
+namespace crest {
+
+class Sha256 {
+public:
+    using Digest = std::array<unsigned char, 32>;
+
+    Sha256() { reset(); }
+
+    void reset() {
+        static const uint32_t init[8] = {
+            0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+            0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+        };
+        std::memcpy(state_, init, sizeof(state_));
+        length_ = 0;
+        buffered_ = 0;
+    }
+
+    void update(const void* data, size_t length) {
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        length_ += length;
+
+        if (buffered_ > 0) {
+            size_t take = std::min(length, sizeof(buffer_) - buffered_);
+            std::memcpy(buffer_ + buffered_, p, take);
+            buffered_ += take;
+            p += take;
+            length -= take;
+            if (buffered_ < sizeof(buffer_)) return;
+            transform(buffer_);
+            buffered_ = 0;
+        }
+        while (length >= 64) {
+            transform(p);
+            p += 64;
+            length -= 64;
+        }
+        if (length > 0) {
+            std::memcpy(buffer_, p, length);
+            buffered_ = length;
+        }
+    }
+
+    Digest finish() {
+        uint64_t bits = length_ * 8;
+        unsigned char pad = 0x80;
+        update(&pad, 1);
+        unsigned char zero = 0;
+        while (buffered_ != 56) update(&zero, 1);
+
+        unsigned char len_be[8];
+        for (int i = 0; i < 8; ++i) len_be[i] = (unsigned char)(bits >> (56 - 8 * i));
+        update(len_be, 8);
+
+        Digest out;
+        for (int i = 0; i < 8; ++i) {
+            out[i * 4] = (unsigned char)(state_[i] >> 24);
+            out[i * 4 + 1] = (unsigned char)(state_[i] >> 16);
+            out[i * 4 + 2] = (unsigned char)(state_[i] >> 8);
+            out[i * 4 + 3] = (unsigned char)state_[i];
+        }
+        reset();
+        return out;
+    }
+
+    static Digest hash(const void* data, size_t length) {
+        Sha256 sha;
+        sha.update(data, length);
+        return sha.finish();
+    }
+
+private:
+    static uint32_t rotr(uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
+
+    void transform(const unsigned char* block) {
+        static const uint32_t k[64] = {
+            0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+            0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+            0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+            0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+            0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+            0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+            0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+            0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+        };
+
+        uint32_t w[64];
+        for (int i = 0; i < 16; ++i) {
+            w[i] = ((uint32_t)block[i * 4] << 24) | ((uint32_t)block[i * 4 + 1] << 16) |
+                   ((uint32_t)block[i * 4 + 2] << 8) | (uint32_t)block[i * 4 + 3];
+        }
+        for (int i = 16; i < 64; ++i) {
+            uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+
+        uint32_t a = state_[0], b = state_[1], c = state_[2], d = state_[3];
+        uint32_t e = state_[4], f = state_[5], g = state_[6], h = state_[7];
+        for (int i = 0; i < 64; ++i) {
+            uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + k[i] + w[i];
+            uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g; g = f; f = e; e = d + t1;
+            d = c; c = b; b = a; a = t1 + t2;
+        }
+
+        state_[0] += a; state_[1] += b; state_[2] += c; state_[3] += d;
+        state_[4] += e; state_[5] += f; state_[6] += g; state_[7] += h;
+    }
+
+    uint32_t state_[8];
+    uint64_t length_;
+    unsigned char buffer_[64];
+    size_t buffered_;
+};
+
+/**
+ * @brief HMAC-SHA256 of a message
+ */
+inline Sha256::Digest hmac_sha256(const std::string& key, const void* data, size_t length) {
+    unsigned char block[64] = {0};
+    if (key.size() > sizeof(block)) {
+        Sha256::Digest hashed = Sha256::hash(key.data(), key.size());
+        std::memcpy(block, hashed.data(), hashed.size());
+    } else {
+        std::memcpy(block, key.data(), key.size());
+    }
+
+    unsigned char ipad[64], opad[64];
+    for (int i = 0; i < 64; ++i) {
+        ipad[i] = block[i] ^ 0x36;
+        opad[i] = block[i] ^ 0x5c;
+    }
+
+    Sha256 inner;
+    inner.update(ipad, sizeof(ipad));
+    inner.update(data, length);
+    Sha256::Digest inner_digest = inner.finish();
+
+    Sha256 outer;
+    outer.update(opad, sizeof(opad));
+    outer.update(inner_digest.data(), inner_digest.size());
+    return outer.finish();
+}
+
+/**
+ * @brief Compare secrets without leaking the position of the first mismatch
+ */
+inline bool constant_time_equals(const void* a, const void* b, size_t length) {
+    const unsigned char* x = static_cast<const unsigned char*>(a);
+    const unsigned char* y = static_cast<const unsigned char*>(b);
+    unsigned char diff = 0;
+    for (size_t i = 0; i < length; ++i) diff |= x[i] ^ y[i];
+    return diff == 0;
+}
+
+} // namespace crest
+
+#endif // CREST_SHA256_HPP
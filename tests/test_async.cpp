@@ -0,0 +1,174 @@
+/**
+ * @file test_async.cpp
+ * @brief Test cases for coroutine handlers and their awaitables
+ */
+
+#include "crest/crest.hpp"
+#include "crest/task.hpp"
+#include "crest/internal/app_internal.h"
+#include "crest/internal/pipeline.hpp"
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+// Runs a request through the app's route table without a socket; coroutine
+// routes finish on this thread before it returns
+static void dispatch(crest::App& app, const char* method, const char* path, crest_response_t* res) {
+    crest_request_t req = {};
+    req.method = strdup(method);
+    req.path = strdup(path);
+    req.body = strdup("");
+
+    crest_route_entry_t route;
+    bool found = crest_route_find(app.raw(), method, path, &route);
+    assert(found);
+    crest::internal::dispatch(route, &req, res);
+
+    crest_request_free(&req);
+}
+
+static std::string body_of(const crest_response_t& res) {
+    return res.body ? std::string(res.body, res.body_length) : std::string();
+}
+
+crest::Task<int> add_later(int a, int b) {
+    co_await crest::sleep_for(std::chrono::milliseconds(1));
+    co_return a + b;
+}
+
+void test_coroutine_routes() {
+    std::cout << "Testing coroutine routes..." << std::endl;
+
+    crest::App app;
+    app.get("/now", [](crest::Request& req, crest::Response& res) -> crest::Task<void> {
+        res.json(200, "{\"path\":\"" + req.path() + "\"}");
+        co_return;
+    });
+    app.get("/sleep", [](crest::Request& req, crest::Response& res) -> crest::Task<void> {
+        co_await crest::sleep_for(std::chrono::milliseconds(30));
+        int sum = co_await add_later(2, 3);
+        res.json(200, "{\"sum\":" + std::to_string(sum) + "}");
+    });
+    // Plain handlers still pick the synchronous overload
+    app.get("/sync", [](crest::Request& req, crest::Response& res) {
+        res.text(200, "sync");
+    });
+
+    crest_response_t now = {};
+    dispatch(app, "GET", "/now", &now);
+    assert(now.sent && now.status == 200);
+    assert(body_of(now) == "{\"path\":\"/now\"}");
+    crest_response_free(&now);
+
+    auto start = std::chrono::steady_clock::now();
+    crest_response_t slept = {};
+    dispatch(app, "GET", "/sleep", &slept);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    assert(elapsed >= std::chrono::milliseconds(20));
+    assert(slept.status == 200 && body_of(slept) == "{\"sum\":5}");
+    crest_response_free(&slept);
+
+    crest_response_t sync = {};
+    dispatch(app, "GET", "/sync", &sync);
+    assert(body_of(sync) == "sync");
+    crest_response_free(&sync);
+
+    std::cout << "  ✓ Handlers, sleeps and nested tasks" << std::endl;
+}
+
+void test_blocking_and_completion() {
+    std::cout << "Testing blocking calls and completions..." << std::endl;
+
+    crest::App app;
+    std::atomic<bool> off_thread{false};
+    app.get("/blocking", [&](crest::Request& req, crest::Response& res) -> crest::Task<void> {
+        std::thread::id handler_thread = std::this_thread::get_id();
+        int rows = co_await crest::run_blocking([&] {
+            off_thread = std::this_thread::get_id() != handler_thread;
+            return 42;
+        });
+        try {
+            co_await crest::run_blocking([] { throw std::runtime_error("connection lost"); });
+        } catch (const std::runtime_error& e) {
+            res.json(200, "{\"rows\":" + std::to_string(rows) + ",\"error\":\"" + e.what() + "\"}");
+        }
+    });
+
+    crest_response_t blocking = {};
+    dispatch(app, "GET", "/blocking", &blocking);
+    assert(off_thread);
+    assert(body_of(blocking) == "{\"rows\":42,\"error\":\"connection lost\"}");
+    crest_response_free(&blocking);
+
+    // Completions bridge callback APIs: resolved from another thread
+    app.get("/callback", [](crest::Request& req, crest::Response& res) -> crest::Task<void> {
+        crest::Completion<std::string> reply;
+        std::thread([reply]() mutable {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            reply.resolve("pong");
+        }).detach();
+        std::string body = co_await reply;
+
+        crest::Completion<> ready;
+        ready.resolve();
+        assert(!ready.resolve());
+        co_await ready;
+        res.text(200, body);
+    });
+
+    crest_response_t callback = {};
+    dispatch(app, "GET", "/callback", &callback);
+    assert(body_of(callback) == "pong");
+    crest_response_free(&callback);
+
+    std::cout << "  ✓ run_blocking and Completion" << std::endl;
+}
+
+void test_coroutine_errors_and_middleware() {
+    std::cout << "Testing coroutine errors and middleware..." << std::endl;
+
+    crest::App app;
+    app.get("/denied", [](crest::Request& req, crest::Response& res) -> crest::Task<void> {
+        co_await crest::sleep_for(std::chrono::milliseconds(1));
+        throw crest::Exception("Not yours", 403);
+    });
+    app.get("/broken", [](crest::Request& req, crest::Response& res) -> crest::Task<void> {
+        co_await crest::sleep_for(std::chrono::milliseconds(1));
+        throw std::runtime_error("secret detail");
+    });
+    app.use([](crest::Request& req, crest::Response& res, crest::NextFunction next) {
+        res.set_header("X-Before", "1");
+        next();
+    });
+
+    crest_response_t denied = {};
+    dispatch(app, "GET", "/denied", &denied);
+    assert(denied.status == 403 && body_of(denied) == "{\"error\":\"Not yours\"}");
+    assert(std::string(crest_kv_get(&denied.headers, "X-Before", true)) == "1");
+    crest_response_free(&denied);
+
+    // Unexpected exceptions become a generic 500 without leaking their message
+    crest_response_t broken = {};
+    dispatch(app, "GET", "/broken", &broken);
+    assert(broken.status == 500 && body_of(broken).find("secret") == std::string::npos);
+    crest_response_free(&broken);
+
+    std::cout << "  ✓ Exceptions map to error responses; middleware runs first" << std::endl;
+}
+
+int main() {
+    std::cout << "\n=== Coroutine Handler Tests ===" << std::endl;
+
+    test_coroutine_routes();
+    test_blocking_and_completion();
+    test_coroutine_errors_and_middleware();
+
+    std::cout << "\n✅ All coroutine handler tests passed!" << std::endl;
+    return 0;
+}
@@ -4,8 +4,75 @@
  */
 
 #include "crest/database.hpp"
+#include <atomic>
 #include <cassert>
+#include <chrono>
 #include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+// Minimal connection so pool behaviour can be tested without a database
+class StubConnection : public crest::db::Connection {
+public:
+    bool connect(const std::string&) override { connected_ = true; return true; }
+    void disconnect() override { connected_ = false; }
+    bool is_connected() const override { return connected_; }
+    crest::db::ResultSet execute(const std::string&) override { return {}; }
+    crest::db::ResultSet execute(const std::string&, const std::vector<crest::db::Value>&) override { return {}; }
+    int execute_update(const std::string&) override { return 0; }
+    int execute_update(const std::string&, const std::vector<crest::db::Value>&) override { return 0; }
+    bool begin_transaction() override { return true; }
+    bool commit() override { return true; }
+    bool rollback() override { return true; }
+    std::string escape(const std::string& str) override { return str; }
+    std::string last_error() const override { return ""; }
+
+private:
+    bool connected_ = true;
+};
+
+// Counts what reaches the "database" to show statements are prepared once
+class PreparingConnection : public StubConnection {
+public:
+    int prepares = 0;
+    int prepared_runs = 0;
+    int text_runs = 0;
+    bool reject = false;
+    std::string last_sql;
+    
+    std::shared_ptr<crest::db::Statement> prepare(const std::string& query) override {
+        ++prepares;
+        if (reject) return nullptr;
+        return std::make_shared<crest::db::Statement>(query);
+    }
+    crest::db::ResultSet execute_prepared(crest::db::Statement& stmt, const std::vector<crest::db::Value>&) override {
+        ++prepared_runs;
+        last_sql = stmt.sql();
+        return {crest::db::Row{{"id", 1}}};
+    }
+    int execute_update_prepared(crest::db::Statement& stmt, const std::vector<crest::db::Value>&) override {
+        ++prepared_runs;
+        last_sql = stmt.sql();
+        return 1;
+    }
+    int execute_update(const std::string& query, const std::vector<crest::db::Value>&) override {
+        ++text_runs;
+        last_sql = query;
+        return 1;
+    }
+};
+
+class Widget : public crest::db::Model {
+public:
+    crest::db::Value id = nullptr;
+    std::string name;
+    
+    std::string table_name() const override { return "widgets"; }
+    crest::db::Row to_row() const override { return {{"id", id}, {"name", name}}; }
+    void from_row(const crest::db::Row& row) override { id = row.at("id"); }
+};
 
 void test_query_builder_select() {
     std::cout << "Testing query builder SELECT..." << std::endl;
@@ -98,6 +165,372 @@ void test_connection_pool() {
     std::cout << "  ✓ Connection pool created" << std::endl;
 }
 
+void test_connection_pool_deadline() {
+    std::cout << "Testing connection pool deadlines..." << std::endl;
+    
+    crest::db::ConnectionPool::Config config;
+    config.timeout_seconds = 30;
+    crest::db::ConnectionPool pool(config);
+    
+    // An empty pool gives up at the request's deadline, not after timeout_seconds
+    auto start = std::chrono::steady_clock::now();
+    assert(pool.acquire(crest::Deadline::after(std::chrono::milliseconds(50))) == nullptr);
+    auto waited = std::chrono::steady_clock::now() - start;
+    assert(waited >= std::chrono::milliseconds(45) && waited < std::chrono::seconds(5));
+    
+    pool.add(std::make_shared<StubConnection>());
+    assert(pool.available_count() == 1);
+    
+    // Expired deadlines never take a connection
+    crest::Deadline expired = crest::Deadline::after(std::chrono::milliseconds(0));
+    assert(pool.acquire(expired) == nullptr);
+    assert(pool.available_count() == 1);
+    
+    auto conn = pool.acquire(crest::Deadline::after(std::chrono::seconds(1)));
+    assert(conn != nullptr);
+    assert(pool.active_count() == 1);
+    
+    // A waiter is handed the connection as soon as it is released
+    std::thread releaser([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        pool.release(conn);
+    });
+    auto again = pool.acquire(crest::Deadline::after(std::chrono::seconds(5)));
+    releaser.join();
+    assert(again != nullptr);
+    pool.release(again);
+    
+    std::cout << "  ✓ acquire() honors request deadlines" << std::endl;
+}
+
+void test_connection_pool_factory() {
+    std::cout << "Testing connection pool factory..." << std::endl;
+    
+    std::atomic<int> opened{0};
+    crest::db::ConnectionPool::Config config;
+    config.connection_string = "test";
+    config.min_connections = 2;
+    config.max_connections = 3;
+    config.timeout_seconds = 1;
+    crest::db::ConnectionPool pool(config, [&](const std::string& dsn) {
+        assert(dsn == "test");
+        ++opened;
+        return std::make_shared<StubConnection>();
+    });
+    
+    // Warmed up to min_connections, grown on demand up to max_connections
+    assert(opened == 2 && pool.size() == 2 && pool.available_count() == 2);
+    {
+        auto a = pool.lease();
+        auto b = pool.lease();
+        auto c = pool.lease();
+        assert(a && b && c && opened == 3);
+        assert(pool.active_count() == 3 && pool.available_count() == 0);
+        
+        // Full: the next borrower gives up at its deadline
+        auto d = pool.lease(crest::Deadline::after(std::chrono::milliseconds(30)));
+        assert(!d);
+        
+        // Leases can be handed on and returned early
+        crest::db::ConnectionPool::Lease moved = std::move(a);
+        assert(!a && moved);
+        moved.release();
+        assert(!moved && pool.available_count() == 1);
+    }
+    // Destroyed leases return their connections
+    assert(pool.active_count() == 0 && pool.available_count() == 3 && opened == 3);
+    
+    // A factory that fails yields an empty lease instead of waiting
+    crest::db::ConnectionPool::Config down_config;
+    down_config.min_connections = 1;
+    crest::db::ConnectionPool down(down_config, [](const std::string&) { return nullptr; });
+    assert(down.size() == 0 && !down.lease());
+    
+    std::cout << "  ✓ Warm-up, growth, timeouts and leases" << std::endl;
+}
+
+void test_connection_pool_fifo() {
+    std::cout << "Testing connection pool waiter order..." << std::endl;
+    
+    crest::db::ConnectionPool::Config config;
+    config.min_connections = 1;
+    config.max_connections = 1;
+    config.timeout_seconds = 5;
+    crest::db::ConnectionPool pool(config, [](const std::string&) { return std::make_shared<StubConnection>(); });
+    
+    auto held = pool.lease();
+    std::mutex mutex;
+    std::vector<int> order;
+    std::vector<std::thread> waiters;
+    for (int i = 0; i < 4; ++i) {
+        waiters.emplace_back([&, i] {
+            auto conn = pool.lease();
+            assert(conn);
+            std::lock_guard<std::mutex> lock(mutex);
+            order.push_back(i);
+        });
+        // Queue them one after another
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    held.release();
+    for (auto& t : waiters) t.join();
+    assert((order == std::vector<int>{0, 1, 2, 3}));
+    
+    std::cout << "  ✓ Waiters are served in arrival order" << std::endl;
+}
+
+void test_connection_pool_health() {
+    std::cout << "Testing connection pool health checks..." << std::endl;
+    
+    std::atomic<int> opened{0};
+    std::atomic<bool> healthy{true};
+    crest::db::ConnectionPool::Config config;
+    config.min_connections = 1;
+    config.max_connections = 2;
+    config.idle_check_seconds = 0;
+    config.health_check = [&](crest::db::Connection&) { return healthy.load(); };
+    crest::db::ConnectionPool pool(config, [&](const std::string&) {
+        ++opened;
+        return std::make_shared<StubConnection>();
+    });
+    assert(opened == 1);
+    
+    // A connection that fails its check is replaced before it is handed out
+    healthy = false;
+    {
+        auto conn = pool.lease();
+        assert(conn && opened == 2);
+        healthy = true;
+        
+        // One that broke while leased is dropped on return
+        conn->disconnect();
+    }
+    assert(pool.size() == 0);
+    
+    // maintain() reopens up to min_connections
+    pool.maintain();
+    assert(pool.size() == 1 && opened == 3);
+    
+    // Connections past max_lifetime_seconds are retired
+    crest::db::ConnectionPool::Config short_lived;
+    short_lived.min_connections = 1;
+    short_lived.max_lifetime_seconds = 1;
+    std::atomic<int> reopened{0};
+    crest::db::ConnectionPool aging(short_lived, [&](const std::string&) {
+        ++reopened;
+        return std::make_shared<StubConnection>();
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    aging.maintain();
+    assert(reopened == 2 && aging.size() == 1);
+    
+    std::cout << "  ✓ Dead and expired connections are replaced" << std::endl;
+}
+
+void test_connection_pool_thread_cache() {
+    std::cout << "Testing connection pool thread caches..." << std::endl;
+    
+    crest::db::ConnectionPool::Config config;
+    config.min_connections = 1;
+    config.max_connections = 1;
+    config.timeout_seconds = 5;
+    crest::db::ConnectionPool pool(config, [](const std::string&) { return std::make_shared<StubConnection>(); });
+    
+    // The first return parks the connection; later borrows skip the mutex
+    crest::db::Connection* first = pool.lease().get();
+    uint64_t locks = pool.stats().lock_acquisitions;
+    for (int i = 0; i < 100; ++i) {
+        auto conn = pool.lease();
+        assert(conn.get() == first);
+    }
+    auto stats = pool.stats();
+    assert(stats.fast_acquires >= 100 && stats.fast_releases >= 100);
+    assert(stats.lock_acquisitions == locks);
+    assert(pool.available_count() == 1 && pool.active_count() == 0);
+    
+    // Another thread steals the parked connection instead of waiting
+    std::thread other([&] {
+        auto conn = pool.lease(crest::Deadline::after(std::chrono::milliseconds(100)));
+        assert(conn && conn.get() == first);
+    });
+    other.join();
+    assert(pool.stats().steals == 1);
+    
+    // While someone waits, returns go to the waiter rather than a cache
+    auto held = pool.lease();
+    assert(held);
+    std::thread waiter([&] {
+        auto conn = pool.lease();
+        assert(conn);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    held.release();
+    waiter.join();
+    assert(pool.size() == 1);
+    
+    std::cout << "  ✓ Parked connections are reused, stolen and handed to waiters" << std::endl;
+}
+
+void test_prepared_statements() {
+    std::cout << "Testing prepared statement cache..." << std::endl;
+    
+    PreparingConnection conn;
+    Widget widget;
+    widget.name = "bolt";
+    
+    // Identical generated SQL is prepared once per connection
+    for (int i = 0; i < 5; ++i) assert(widget.save(conn));
+    assert(conn.prepares == 1 && conn.prepared_runs == 5);
+    assert(conn.last_sql.find("INSERT INTO widgets") == 0);
+    
+    widget.id = 7;
+    assert(widget.save(conn) && widget.save(conn));
+    assert(conn.prepares == 2 && conn.last_sql.find("UPDATE widgets") == 0);
+    
+    assert(Widget::find_by_id(conn, "widgets", 7).size() == 1);
+    assert(Widget::find_by_id(conn, "widgets", 8).size() == 1);
+    assert(conn.prepares == 3);
+    assert(conn.statements().size() == 3);
+    assert(conn.statements().hits() == 6 && conn.statements().misses() == 3);
+    
+    // Least recently used statements are evicted beyond capacity
+    conn.statements().set_capacity(2);
+    assert(conn.statements().size() == 2 && conn.statements().evictions() == 1);
+    widget.id = nullptr;
+    assert(widget.save(conn));
+    assert(conn.prepares == 4);
+    
+    // A statement the database rejects is not cached; the text path is used
+    PreparingConnection rejecting;
+    rejecting.reject = true;
+    crest::db::QueryBuilder qb;
+    qb.delete_from("widgets").where("id", "=", 1);
+    assert(qb.execute_update(rejecting) == 1 && qb.execute_update(rejecting) == 1);
+    assert(rejecting.prepares == 2 && rejecting.text_runs == 2 && rejecting.statements().size() == 0);
+    
+    // Drivers without prepared statements still work through the defaults
+    StubConnection plain;
+    assert(qb.execute_update(plain) == 0);
+    assert(plain.statements().size() == 1);
+    
+    std::cout << "  ✓ Statements prepared once, LRU-evicted, rejected ones not cached" << std::endl;
+}
+
+void test_query_shapes() {
+    std::cout << "Testing declared query shapes..." << std::endl;
+    
+    static const crest::db::Query find_user(
+        crest::db::QueryBuilder().select({"id", "name"}).from("users")
+            .where("id", "=").and_where("active", "=", true).or_where("name", "LIKE").limit(1));
+    assert(find_user.sql() == "SELECT id, name FROM users WHERE id = ? AND active = ? OR name LIKE ? LIMIT 1");
+    assert(find_user.arity() == 2);
+    
+    // Fixed values stay in place; arguments fill the placeholders in order
+    auto params = find_user.bind({7, std::string("a%")});
+    assert(params.size() == 3);
+    assert(std::get<int>(params[0]) == 7);
+    assert(std::get<bool>(params[1]) == true);
+    assert(std::get<std::string>(params[2]) == "a%");
+    
+    bool threw = false;
+    try {
+        find_user.bind({7});
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    assert(threw);
+    
+    static const crest::db::Query add_user(
+        crest::db::QueryBuilder().insert_into("users").values({{"source", std::string("api")}}).columns({"name", "email"}));
+    assert(add_user.sql() == "INSERT INTO users (source, name, email) VALUES (?, ?, ?)");
+    auto insert_params = add_user.bind({std::string("ann"), std::string("ann@example.com")});
+    assert(std::get<std::string>(insert_params[0]) == "api");
+    assert(std::get<std::string>(insert_params[2]) == "ann@example.com");
+    
+    static const crest::db::Query rename(
+        crest::db::QueryBuilder().update("users").columns({"name"}).where("id", "="));
+    assert(rename.sql() == "UPDATE users SET name = ? WHERE id = ?");
+    assert(rename.arity() == 2);
+    
+    // Each run binds values against the connection's one prepared statement
+    PreparingConnection conn;
+    for (int id = 0; id < 10; ++id) {
+        assert(find_user.execute(conn, {id, std::string("x")}).size() == 1);
+        assert(rename.execute_update(conn, {std::string("bob"), id}) == 1);
+    }
+    assert(conn.prepares == 2 && conn.prepared_runs == 20);
+    
+    std::cout << "  ✓ SQL built once, values bound per run" << std::endl;
+}
+
+void test_result_set() {
+    std::cout << "Testing columnar result sets..." << std::endl;
+    
+    crest::db::ResultSet rows({"id", "name", "score", "active"});
+    rows.append({1, std::string("ann"), 9.5, true});
+    rows.append({2, nullptr, 7.0, false});
+    rows.append({3, std::string("cy"), nullptr, true});
+    assert(rows.size() == 3 && rows.column_count() == 4);
+    assert(rows.column("name") == 1 && rows.column("missing") == crest::db::ResultSet::npos);
+    
+    // Typed columns are contiguous arrays; strings are views into one arena
+    assert(rows.column_type(0) == crest::db::ColumnType::Int);
+    assert(rows.column_type(1) == crest::db::ColumnType::String);
+    assert((rows.ints(0) == std::vector<int>{1, 2, 3}));
+    assert(rows.doubles(2)[0] == 9.5 && rows.is_null(2, 2));
+    assert(rows.bools(3)[1] == 0);
+    assert(rows[0].text("name") == "ann" && rows[1].text("name").empty());
+    
+    bool threw = false;
+    try {
+        rows.doubles(0);
+    } catch (const std::logic_error&) {
+        threw = true;
+    }
+    assert(threw);
+    
+    // Row views copy cells out; a Row keeps the map's reference access
+    auto second = rows[1];
+    assert(std::get<int>(second.value("id")) == 2);
+    assert(std::holds_alternative<std::nullptr_t>(second.value("name")));
+    assert(second.count("score") == 1 && second.count("missing") == 0);
+    threw = false;
+    try {
+        second.value("missing");
+    } catch (const std::out_of_range&) {
+        threw = true;
+    }
+    assert(threw);
+    crest::db::Row row = rows[2];
+    const std::string& kept = std::get<std::string>(row.at("name"));
+    assert(row.size() == 4 && kept == "cy");
+    
+    int sum = 0;
+    for (auto view : rows) sum += std::get<int>(view.value("id"));
+    assert(sum == 6);
+    
+    // Rows built by name grow the column index and back-fill nulls
+    crest::db::ResultSet built{crest::db::Row{{"id", 1}}, crest::db::Row{{"id", 2}, {"note", std::string("x")}}};
+    assert(built.column_count() == 2 && built.is_null(0, built.column("note")));
+    assert(built[1].text("note") == "x");
+    
+    // A column that sees two types keeps every value
+    built.push_back({{"id", std::string("three")}});
+    assert(built.column_type(0) == crest::db::ColumnType::Mixed);
+    assert(std::get<int>(built[0].value("id")) == 1);
+    assert(built[2].text("id") == "three");
+    
+    threw = false;
+    try {
+        rows.append({4});
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    assert(threw);
+    
+    std::cout << "  ✓ Shared column index, typed columns and row views" << std::endl;
+}
+
 int main() {
     std::cout << "\n=== Database Tests ===" << std::endl;
     
@@ -106,6 +539,14 @@ int main() {
     test_query_builder_update();
     test_query_builder_delete();
     test_connection_pool();
+    test_connection_pool_deadline();
+    test_connection_pool_factory();
+    test_connection_pool_fifo();
+    test_connection_pool_health();
+    test_connection_pool_thread_cache();
+    test_prepared_statements();
+    test_query_shapes();
+    test_result_set();
     
     std::cout << "\n✅ All database tests passed!" << std::endl;
     return 0;
@@ -0,0 +1,162 @@
+/**
+ * @file test_parallel.cpp
+ * @brief Test cases for parallel_for, parallel_reduce and parallel_sort
+ */
+
+#include "crest/crest.hpp"
+#include "crest/parallel.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+void test_parallel_for() {
+    std::cout << "Testing parallel_for..." << std::endl;
+
+    std::vector<int> hits(100000, 0);
+    crest::parallel_for(0, hits.size(), [&](size_t i) { hits[i] += 1; });
+    assert(std::all_of(hits.begin(), hits.end(), [](int h) { return h == 1; }));
+
+    // Explicit grains, offset ranges and empty ranges
+    std::atomic<size_t> sum{0};
+    crest::parallel_for(10, 1010, [&](size_t i) { sum += i; }, 7);
+    assert(sum == (10 + 1009) * 1000 / 2);
+    crest::parallel_for(5, 5, [](size_t) { assert(false); });
+
+    // Chunks land on more than one thread
+    std::mutex mutex;
+    std::set<std::thread::id> threads;
+    crest::parallel_for(0, 64, [&](size_t) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        std::lock_guard<std::mutex> lock(mutex);
+        threads.insert(std::this_thread::get_id());
+    }, 1);
+    assert(threads.size() > 1);
+
+    std::cout << "  ✓ Every index runs once, across the pool" << std::endl;
+}
+
+void test_nested_and_concurrent() {
+    std::cout << "Testing nested and concurrent calls..." << std::endl;
+
+    // Nested loops finish even though every pool thread waits on inner work
+    std::vector<std::atomic<int>> cells(64 * 64);
+    crest::parallel_for(0, 64, [&](size_t row) {
+        crest::parallel_for(0, 64, [&](size_t col) { cells[row * 64 + col] += 1; }, 4);
+    }, 1);
+    assert(std::all_of(cells.begin(), cells.end(), [](const std::atomic<int>& c) { return c == 1; }));
+
+    // Several request threads share the pool
+    std::vector<std::thread> requests;
+    std::atomic<int> correct{0};
+    for (int r = 0; r < 8; ++r) {
+        requests.emplace_back([&, r] {
+            std::vector<int64_t> values(20000, r);
+            int64_t total = crest::parallel_reduce(values.begin(), values.end(), (int64_t)0);
+            if (total == 20000 * (int64_t)r) ++correct;
+        });
+    }
+    for (auto& t : requests) t.join();
+    assert(correct == 8);
+
+    std::cout << "  ✓ No deadlock when nesting; callers share the pool" << std::endl;
+}
+
+void test_parallel_reduce() {
+    std::cout << "Testing parallel_reduce..." << std::endl;
+
+    std::vector<int> values(100001);
+    for (size_t i = 0; i < values.size(); ++i) values[i] = (int)i;
+    int64_t total = crest::parallel_reduce(values.begin(), values.end(), (int64_t)0);
+    assert(total == (int64_t)100000 * 100001 / 2);
+
+    // Chunk results combine in order, so non-commutative ops work
+    std::vector<std::string> words;
+    for (int i = 0; i < 1000; ++i) words.push_back(std::to_string(i % 10));
+    std::string joined = crest::parallel_reduce(words.begin(), words.end(), std::string(">"), std::plus<>());
+    std::string expected = ">";
+    for (const auto& w : words) expected += w;
+    assert(joined == expected);
+
+    struct Order { double amount; };
+    std::vector<Order> orders(5000, Order{1.5});
+    double amount = crest::parallel_reduce(orders.begin(), orders.end(), 0.0, std::plus<>(),
+                                           [](const Order& o) { return o.amount; });
+    assert(amount == 7500.0);
+
+    std::vector<int> none;
+    assert(crest::parallel_reduce(none.begin(), none.end(), 42) == 42);
+
+    std::cout << "  ✓ Sums, ordered combines and transforms" << std::endl;
+}
+
+void test_parallel_sort() {
+    std::cout << "Testing parallel_sort..." << std::endl;
+
+    std::mt19937 rng(7);
+    std::vector<uint32_t> values(200000);
+    for (auto& v : values) v = rng();
+    std::vector<uint32_t> expected = values;
+    std::sort(expected.begin(), expected.end());
+    crest::parallel_sort(values.begin(), values.end());
+    assert(values == expected);
+
+    std::sort(expected.begin(), expected.end(), std::greater<>());
+    crest::parallel_sort(values.begin(), values.end(), std::greater<>());
+    assert(values == expected);
+
+    std::vector<int> small = {3, 1, 2};
+    crest::parallel_sort(small.begin(), small.end());
+    assert((small == std::vector<int>{1, 2, 3}));
+
+    std::cout << "  ✓ Large, descending and small ranges" << std::endl;
+}
+
+void test_parallel_errors() {
+    std::cout << "Testing exceptions..." << std::endl;
+
+    std::atomic<int> ran{0};
+    bool threw = false;
+    try {
+        crest::parallel_for(0, 1000, [&](size_t i) {
+            ++ran;
+            if (i == 3) throw std::runtime_error("bad row");
+        }, 1);
+    } catch (const std::runtime_error& e) {
+        threw = std::string(e.what()) == "bad row";
+    }
+    assert(threw);
+    assert(ran < 1000);
+
+    // The pool is still usable afterwards
+    std::atomic<int> after{0};
+    crest::parallel_for(0, 100, [&](size_t) { ++after; });
+    assert(after == 100);
+
+    std::cout << "  ✓ First exception rethrown, remaining chunks skipped" << std::endl;
+}
+
+int main() {
+    std::cout << "\n=== Parallel Algorithm Tests ===" << std::endl;
+
+    // Fixed size so the tests exercise stealing on any machine
+    assert(crest::configure_parallel(3));
+
+    test_parallel_for();
+    test_nested_and_concurrent();
+    test_parallel_reduce();
+    test_parallel_sort();
+    test_parallel_errors();
+    assert(!crest::configure_parallel(1));
+
+    std::cout << "\n✅ All parallel algorithm tests passed!" << std::endl;
+    return 0;
+}
@@ -0,0 +1,361 @@
+/**
+ * @file test_server.cpp
+ * @brief Test cases that run requests through a real server on a loopback socket
+ */
+
+#include "crest/crest.hpp"
+#include "crest/middleware.hpp"
+#include "crest/task.hpp"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Runs an app on a free loopback port for the lifetime of the object
+class LoopbackServer {
+public:
+    explicit LoopbackServer(crest::App& app) : app_(app), port_(free_port()) {
+        thread_ = std::thread([this] { crest_run(app_.raw(), "127.0.0.1", port_); });
+    }
+
+    ~LoopbackServer() {
+        crest_stop(app_.raw());
+        // accept() only notices the stop once another connection arrives
+        int wake = connect_once();
+        if (wake >= 0) close(wake);
+        thread_.join();
+    }
+
+    /**
+     * @brief Send a raw request and read until the server closes the connection
+     */
+    std::string send(const std::string& request) const {
+        int fd = -1;
+        for (int attempt = 0; attempt < 200 && fd < 0; ++attempt) {
+            fd = connect_once();
+            if (fd < 0) std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        assert(fd >= 0);
+        ::send(fd, request.data(), request.size(), 0);
+        std::string response;
+        char buffer[4096];
+        ssize_t n;
+        while ((n = recv(fd, buffer, sizeof(buffer), 0)) > 0) response.append(buffer, (size_t)n);
+        close(fd);
+        return response;
+    }
+
+    std::string get(const std::string& path, const std::string& headers = "") const {
+        return send("GET " + path + " HTTP/1.1\r\nHost: localhost\r\n" + headers + "\r\n");
+    }
+
+private:
+    static int free_port() {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = 0;
+        bind(fd, (sockaddr*)&addr, sizeof(addr));
+        socklen_t len = sizeof(addr);
+        getsockname(fd, (sockaddr*)&addr, &len);
+        close(fd);
+        return ntohs(addr.sin_port);
+    }
+
+    int connect_once() const {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons((uint16_t)port_);
+        if (connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    crest::App& app_;
+    int port_;
+    std::thread thread_;
+};
+
+static std::string body_of(const std::string& response) {
+    size_t start = response.find("\r\n\r\n");
+    return start == std::string::npos ? "" : response.substr(start + 4);
+}
+
+// Polls until done() holds or a second has passed
+static bool eventually(const std::function<bool()>& done) {
+    for (int i = 0; i < 200; ++i) {
+        if (done()) return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    return done();
+}
+
+void test_after_send_on_server() {
+    std::cout << "Testing after-send work on a served request..." << std::endl;
+
+    crest::App app;
+    std::atomic<int> ran{0};
+    auto unsent_token = std::make_shared<int>(0);
+    std::weak_ptr<int> unsent_alive = unsent_token;
+
+    app.get("/sent", [&](crest::Request& req, crest::Response& res) {
+        res.after_send([&ran] { ++ran; });
+        res.text(200, "done");
+    });
+    // Queues work, then never responds
+    app.get("/silent", [&ran, token = std::move(unsent_token)](crest::Request& req, crest::Response& res) mutable {
+        res.after_send([&ran, token] { ran += 100; });
+        token.reset();
+    });
+
+    {
+        LoopbackServer server(app);
+        assert(body_of(server.get("/sent")) == "done");
+        assert(eventually([&] { return ran == 1; }));
+
+        // The client gets nothing, so the work is released without running
+        assert(server.get("/silent").empty());
+        assert(eventually([&] { return unsent_alive.expired(); }));
+    }
+    assert(ran == 1);
+
+    std::cout << "  ✓ Sent responses run their work; unsent ones release it" << std::endl;
+}
+
+void test_deferred_response_on_server() {
+    std::cout << "Testing deferred responses on a served request..." << std::endl;
+
+    crest::App app;
+    app.get("/deferred", [](crest::Request& req, crest::Response& res) {
+        crest_response_t* raw = res.raw();
+        crest_pending_t* pending = crest_response_defer(raw);
+        assert(pending);
+        // The handler returns at once; another thread finishes the response
+        std::thread([raw, pending] {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            crest_response_json(raw, 200, "{\"late\":true}");
+            crest_response_complete(pending);
+        }).detach();
+    });
+
+    std::atomic<int> completed{0};
+    std::atomic<int> ran{0};
+    auto token = std::make_shared<int>(0);
+    std::weak_ptr<int> token_alive = token;
+    app.get("/slow", [&completed, &ran, token = std::move(token)](crest::Request& req, crest::Response& res) mutable {
+        crest_response_t* raw = res.raw();
+        crest_pending_t* pending = crest_response_defer(raw);
+        res.after_send([&ran, token] { ++ran; });
+        token.reset();
+        std::thread([raw, pending, &completed] {
+            std::this_thread::sleep_for(std::chrono::milliseconds(300));
+            crest_response_json(raw, 200, "{\"late\":true}");
+            crest_response_complete(pending);
+            ++completed;
+        }).detach();
+    });
+
+    {
+        LoopbackServer server(app);
+
+        std::vector<std::thread> clients;
+        std::atomic<int> answered{0};
+        for (int i = 0; i < 8; ++i) {
+            clients.emplace_back([&] {
+                std::string response = server.get("/deferred");
+                if (response.rfind("HTTP/1.1 200", 0) == 0 && body_of(response) == "{\"late\":true}") ++answered;
+            });
+        }
+        for (auto& client : clients) client.join();
+        assert(answered == 8);
+
+        // The deadline answers first; the late completion is discarded
+        auto start = std::chrono::steady_clock::now();
+        std::string timed_out = server.get("/slow", "X-Request-Timeout: 50\r\n");
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        assert(timed_out.rfind("HTTP/1.1 504", 0) == 0);
+        assert(body_of(timed_out) == "{\"error\":\"Deadline Exceeded\"}");
+        assert(elapsed < std::chrono::milliseconds(250));
+        assert(eventually([&] { return completed == 1; }));
+        // Freeing the exchange releases the response's after-send work unrun
+        assert(eventually([&] { return token_alive.expired(); }));
+    }
+    assert(ran == 0);
+
+    std::cout << "  ✓ Completed from another thread; deadlines answer 504 and free the exchange" << std::endl;
+}
+
+static size_t count_of(const std::string& text, const std::string& needle) {
+    size_t count = 0;
+    for (size_t pos = text.find(needle); pos != std::string::npos; pos = text.find(needle, pos + 1)) ++count;
+    return count;
+}
+
+void test_cached_route_middleware_on_server() {
+    std::cout << "Testing middleware in front of cache hits..." << std::endl;
+
+    crest::App app;
+    crest::RateLimitMiddleware::Options limits;
+    limits.max_requests = 3;
+    app.use(std::make_shared<crest::RateLimitMiddleware>(limits));
+
+    std::atomic<int> calls{0};
+    app.get("/private", [&calls](crest::Request& req, crest::Response& res) {
+        ++calls;
+        res.json(200, "{\"secret\":true}");
+    });
+    app.use(crest::Method::GET, "/private",
+            std::make_shared<crest::AuthMiddleware>([](const std::string& token) { return token == "good"; }));
+    crest::CacheKey key;
+    key.headers = {"Authorization"};
+    key.with_middleware = true;
+    app.cache(crest::Method::GET, "/private", 60000, key);
+
+    const std::string token = "Authorization: Bearer good\r\n";
+    {
+        LoopbackServer server(app);
+        std::string first = server.get("/private", token);
+        assert(first.rfind("HTTP/1.1 200", 0) == 0 && calls == 1);
+
+        // A request without a token is refused, not served the stored copy
+        std::string anonymous = server.get("/private");
+        assert(anonymous.rfind("HTTP/1.1 401", 0) == 0);
+        assert(body_of(anonymous).find("secret") == std::string::npos);
+
+        // The hit carries this request's rate-limit state, not the stored one's
+        std::string hit = server.get("/private", token);
+        assert(hit.rfind("HTTP/1.1 200", 0) == 0 && body_of(hit) == "{\"secret\":true}");
+        assert(calls == 1);
+        assert(count_of(hit, "X-RateLimit-Remaining") == 1);
+        assert(hit.find("X-RateLimit-Remaining: 0\r\n") != std::string::npos);
+
+        // Over the limit, a cached route answers 429 like any other
+        assert(server.get("/private", token).rfind("HTTP/1.1 429", 0) == 0);
+    }
+    assert(calls == 1);
+
+    std::cout << "  ✓ Hits still pass auth and rate limits and carry per-client headers" << std::endl;
+}
+
+void test_cache_refresh_on_server() {
+    std::cout << "Testing stale-while-revalidate refreshes on a served request..." << std::endl;
+
+    crest::App app;
+    crest::RateLimitMiddleware::Options limits;
+    limits.max_requests = 3;
+    app.use(std::make_shared<crest::RateLimitMiddleware>(limits));
+    std::atomic<int> middleware_calls{0};
+    app.use([&middleware_calls](crest::Request& req, crest::Response& res, crest::NextFunction next) {
+        ++middleware_calls;
+        res.set_header("X-Trace", "t");
+        next();
+    });
+
+    std::atomic<int> calls{0};
+    app.get("/feed", [&calls](crest::Request& req, crest::Response& res) {
+        res.set_header("X-Version", std::to_string(++calls));
+        res.json(200, "[]");
+    });
+    crest::CacheKey key;
+    key.with_middleware = true;
+    app.cache(crest::Method::GET, "/feed", 50, key, 60000);
+
+    {
+        LoopbackServer server(app);
+        std::string first = server.get("/feed");
+        assert(first.rfind("HTTP/1.1 200", 0) == 0 && calls == 1 && middleware_calls == 1);
+
+        // The stale hit is answered and refreshed by one pass through the chain
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        std::string stale = server.get("/feed");
+        assert(stale.rfind("HTTP/1.1 200", 0) == 0);
+        assert(stale.find("X-Version: 1\r\n") != std::string::npos);
+        assert(eventually([&] { return calls == 2; }));
+        assert(middleware_calls == 2);
+
+        // A third request is still within the limit, and each header appears once
+        std::string fresh = server.get("/feed");
+        assert(fresh.rfind("HTTP/1.1 200", 0) == 0);
+        assert(fresh.find("X-Version: 2\r\n") != std::string::npos);
+        assert(count_of(fresh, "X-Trace") == 1 && count_of(fresh, "X-RateLimit-Remaining") == 1);
+        assert(fresh.find("X-RateLimit-Remaining: 0\r\n") != std::string::npos);
+        assert(calls == 2 && middleware_calls == 3);
+    }
+
+    std::cout << "  ✓ Refreshes run the middleware once and hits repeat no headers" << std::endl;
+}
+
+void test_suspended_handler_duplicates_on_server() {
+    std::cout << "Testing duplicates of suspended coroutine handlers..." << std::endl;
+
+    crest::App app;
+    app.use(std::make_shared<crest::IdempotencyMiddleware>());
+    app.use("/report", std::make_shared<crest::CoalesceMiddleware>());
+
+    std::atomic<int> transfers{0};
+    app.post("/transfer", [&transfers](crest::Request& req, crest::Response& res) -> crest::Task<void> {
+        int id = ++transfers;
+        co_await crest::sleep_for(std::chrono::milliseconds(100));
+        res.json(201, "{\"transfer\":" + std::to_string(id) + "}");
+    });
+    std::atomic<int> reports{0};
+    app.get("/report", [&reports](crest::Request& req, crest::Response& res) -> crest::Task<void> {
+        int id = ++reports;
+        co_await crest::sleep_for(std::chrono::milliseconds(100));
+        res.json(200, "{\"report\":" + std::to_string(id) + "}");
+    });
+
+    {
+        LoopbackServer server(app);
+
+        // The retry arrives while the first request is suspended
+        const std::string transfer = "POST /transfer HTTP/1.1\r\nHost: localhost\r\n"
+                                     "Idempotency-Key: k1\r\nContent-Length: 0\r\n\r\n";
+        std::string first;
+        std::thread original([&] { first = server.send(transfer); });
+        std::this_thread::sleep_for(std::chrono::milliseconds(30));
+        std::string retry = server.send(transfer);
+        original.join();
+        assert(first.rfind("HTTP/1.1 201", 0) == 0 && body_of(first) == "{\"transfer\":1}");
+        assert(retry.rfind("HTTP/1.1 201", 0) == 0 && body_of(retry) == "{\"transfer\":1}");
+        assert(retry.find("Idempotent-Replayed: true") != std::string::npos);
+        assert(transfers == 1);
+
+        std::string leader;
+        std::thread first_report([&] { leader = server.get("/report"); });
+        std::this_thread::sleep_for(std::chrono::milliseconds(30));
+        std::string follower = server.get("/report");
+        first_report.join();
+        assert(body_of(leader) == "{\"report\":1}" && body_of(follower) == "{\"report\":1}");
+        assert(reports == 1);
+    }
+
+    std::cout << "  ✓ Duplicates wait for a suspended handler's response instead of running again" << std::endl;
+}
+
+int main() {
+    std::cout << "\n=== Server Tests ===" << std::endl;
+
+    test_after_send_on_server();
+    test_deferred_response_on_server();
+    test_cached_route_middleware_on_server();
+    test_cache_refresh_on_server();
+    test_suspended_handler_duplicates_on_server();
+
+    std::cout << "\n✅ All server tests passed!" << std::endl;
+    return 0;
+}
@@ -0,0 +1,209 @@
+/**
+ * @file test_session.cpp
+ * @brief Test cases for cookies, cookie signing and the session store
+ */
+
+#include "crest/session.hpp"
+#include "crest/internal/app_internal.h"
+#include <cassert>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <set>
+#include <thread>
+#include <vector>
+
+void test_cookie_parsing() {
+    std::cout << "Testing cookie parsing..." << std::endl;
+    
+    crest_request_t raw = {};
+    crest_kv_add(&raw.headers, "Host", "example.com");
+    crest_kv_add(&raw.headers, "Cookie", " sid=abc.def ;theme=\"dark\"; empty=; novalue; =anon");
+    crest_kv_add(&raw.headers, "cookie", "sid=shadowed; lang=en");
+    
+    // Nothing is parsed until a cookie is asked for
+    assert(!raw.cookies_parsed);
+    crest::Request req(&raw);
+    assert(req.cookie("sid") == "abc.def");
+    assert(raw.cookies_parsed);
+    assert(req.cookie("theme") == "dark");
+    assert(req.has_cookie("empty") && req.cookie("empty").empty());
+    assert(!req.has_cookie("novalue"));
+    assert(req.cookie("lang") == "en");
+    assert(crest_request_get_cookie(&raw, "SID") == nullptr);
+    assert(req.cookies().size() == 4);
+    crest_request_free(&raw);
+    
+    crest_request_t none = {};
+    crest::Request bare(&none);
+    assert(bare.cookies().empty());
+    crest_request_free(&none);
+    
+    std::cout << "  ✓ Cookie header parsed lazily" << std::endl;
+}
+
+void test_set_cookie() {
+    std::cout << "Testing Set-Cookie..." << std::endl;
+    
+    crest_response_t raw = {};
+    crest::Response res(&raw);
+    crest::CookieOptions opts;
+    opts.secure = true;
+    opts.max_age_seconds = 60;
+    res.set_cookie("sid", "abc", opts);
+    res.set_cookie("theme", "dark");
+    res.clear_cookie("old");
+    
+    std::vector<std::string> cookies;
+    for (size_t i = 0; i < raw.headers.count; ++i) {
+        if (strcmp(raw.headers.items[i].key, "Set-Cookie") == 0) cookies.push_back(raw.headers.items[i].value);
+    }
+    assert(cookies.size() == 3);
+    assert(cookies[0] == "sid=abc; Path=/; Max-Age=60; Secure; HttpOnly; SameSite=Lax");
+    assert(cookies[1] == "theme=dark; Path=/; HttpOnly; SameSite=Lax");
+    assert(cookies[2] == "old=; Path=/; Max-Age=0; HttpOnly; SameSite=Lax");
+    
+    bool threw = false;
+    try { res.set_cookie("bad name", "x"); } catch (const crest::Exception&) { threw = true; }
+    assert(threw);
+    threw = false;
+    try { res.set_cookie("ok", "a;b"); } catch (const crest::Exception&) { threw = true; }
+    assert(threw);
+    crest_response_free(&raw);
+    
+    std::cout << "  ✓ Set-Cookie headers built and validated" << std::endl;
+}
+
+void test_cookie_signer() {
+    std::cout << "Testing cookie signing..." << std::endl;
+    
+    crest::CookieSigner signer("secret");
+    std::string signed_value = signer.sign("user-42");
+    assert(signed_value.rfind("user-42.", 0) == 0);
+    assert(signed_value.size() == std::string("user-42.").size() + 43);
+    
+    // RFC 4231-style vector: the precomputed pad states give a plain HMAC-SHA256
+    crest::CookieSigner vector_signer("key");
+    assert(vector_signer.sign("The quick brown fox jumps over the lazy dog") ==
+           "The quick brown fox jumps over the lazy dog.97yD9DBThCSxMpjmqm-xQ-9NWaFJRhdZl0edvC0aPNg");
+    assert(crest::CookieSigner("secret").sign("user-42") == signed_value);
+    
+    std::string value;
+    assert(signer.unsign(signed_value, value) && value == "user-42");
+    assert(signer.unsign(signer.sign("a.b"), value) && value == "a.b");
+    
+    std::string tampered = signed_value;
+    tampered[0] = 'x';
+    assert(!signer.unsign(tampered, value));
+    assert(!signer.unsign("user-42", value));
+    assert(!crest::CookieSigner("other").unsign(signed_value, value));
+    
+    bool threw = false;
+    try { crest::CookieSigner empty(""); } catch (const crest::Exception&) { threw = true; }
+    assert(threw);
+    
+    std::cout << "  ✓ Signatures verify and reject tampering" << std::endl;
+}
+
+void test_session_store() {
+    std::cout << "Testing session store..." << std::endl;
+    
+    crest::SessionStore::Options opts;
+    opts.secret = "secret";
+    crest::SessionStore sessions(opts);
+    
+    std::set<std::string> ids;
+    for (int i = 0; i < 1000; ++i) ids.insert(sessions.create());
+    assert(ids.size() == 1000 && sessions.size() == 1000);
+    
+    std::string id = sessions.create({{"user", "42"}});
+    crest::SessionStore::Data data;
+    assert(sessions.get(id, data) && data["user"] == "42");
+    assert(sessions.update(id, [](crest::SessionStore::Data& d) { d["cart"] = "3"; }));
+    assert(sessions.get(id, data) && data["cart"] == "3");
+    assert(sessions.set(id, {{"user", "7"}}));
+    assert(sessions.get(id, data) && data.size() == 1 && data["user"] == "7");
+    assert(sessions.destroy(id));
+    assert(!sessions.get(id, data));
+    assert(!sessions.set(id, {}));
+    
+    // Cookie round trip through a request and a response
+    crest_response_t raw_res = {};
+    crest::Response res(&raw_res);
+    std::string started = sessions.start(res, {{"user", "9"}});
+    std::string set_cookie = crest_kv_get(&raw_res.headers, "Set-Cookie", true);
+    std::string cookie_pair = set_cookie.substr(0, set_cookie.find(';'));
+    crest_response_free(&raw_res);
+    
+    crest_request_t raw_req = {};
+    crest_kv_add(&raw_req.headers, "Cookie", cookie_pair.c_str());
+    crest::Request req(&raw_req);
+    std::string loaded_id;
+    assert(sessions.load(req, data, &loaded_id) && loaded_id == started && data["user"] == "9");
+    crest_request_free(&raw_req);
+    
+    crest_request_t forged = {};
+    std::string forged_cookie = "sid=" + started + ".AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA";
+    crest_kv_add(&forged.headers, "Cookie", forged_cookie.c_str());
+    crest::Request forged_req(&forged);
+    assert(sessions.session_id(forged_req).empty());
+    assert(!sessions.load(forged_req, data));
+    crest_request_free(&forged);
+    
+    std::cout << "  ✓ Sessions created, read, updated and bound to signed cookies" << std::endl;
+}
+
+void test_session_expiry() {
+    std::cout << "Testing session expiry..." << std::endl;
+    
+    crest::SessionStore::Options opts;
+    opts.secret = "secret";
+    opts.ttl_seconds = 1;
+    opts.tick_ms = 50;
+    opts.wheel_slots = 8;  // smaller than the TTL, so entries wait out whole revolutions
+    opts.shards = 4;
+    crest::SessionStore sessions(opts);
+    
+    std::string idle = sessions.create();
+    std::string active = sessions.create();
+    for (int i = 0; i < 30; ++i) sessions.create();
+    crest::SessionStore::Data data;
+    
+    // Sliding expiry keeps a session alive while it is used
+    for (int i = 0; i < 6; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(250));
+        assert(sessions.get(active, data));
+    }
+    assert(!sessions.get(idle, data));
+    
+    // Shards that were not used meanwhile catch up on their next use or a sweep
+    assert(sessions.sweep() > 0);
+    assert(sessions.size() == 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1200));
+    sessions.sweep();
+    assert(sessions.size() == 0);
+    
+    // Fixed lifetime when sliding is off
+    opts.sliding = false;
+    crest::SessionStore fixed(opts);
+    std::string id = fixed.create();
+    std::this_thread::sleep_for(std::chrono::milliseconds(600));
+    assert(fixed.get(id, data));
+    std::this_thread::sleep_for(std::chrono::milliseconds(600));
+    assert(!fixed.get(id, data));
+    
+    std::cout << "  ✓ Timer wheel expires idle sessions and slides active ones" << std::endl;
+}
+
+int main() {
+    std::cout << "\n=== Session Tests ===" << std::endl;
+    
+    test_cookie_parsing();
+    test_set_cookie();
+    test_cookie_signer();
+    test_session_store();
+    test_session_expiry();
+    
+    std::cout << "\n✅ All session tests passed!" << std::endl;
+    return 0;
+}
@@ -15,12 +15,42 @@ if is_plat("windows") then
     add_syslinks("ws2_32", "mswsock")
 elseif is_plat("linux") then
     add_defines("CREST_LINUX")
-    add_syslinks("pthread")
+    add_syslinks("pthread", "rt")
 elseif is_plat("macosx") then
     add_defines("CREST_MACOS")
     add_syslinks("pthread")
 end
 
+option("zlib")
+    set_default(true)
+    set_showmenu(true)
+    set_description("Enable gzip/deflate response compression (requires zlib)")
+option_end()
+
+option("brotli")
+    set_default(false)
+    set_showmenu(true)
+    set_description("Enable brotli response compression (requires libbrotli)")
+option_end()
+
+option("openssl")
+    set_default(false)
+    set_showmenu(true)
+    set_description("Enable RS256/ES256 JWT verification (requires OpenSSL)")
+option_end()
+
+if has_config("zlib") then
+    add_requires("zlib")
+end
+
+if has_config("brotli") then
+    add_requires("brotli")
+end
+
+if has_config("openssl") then
+    add_requires("openssl")
+end
+
 target("crest")
     set_kind("$(kind)")
     add_files("src/core/*.c")
@@ -43,6 +73,21 @@ target("crest")
     if is_kind("shared") then
         add_defines("CREST_BUILD_SHARED")
     end
+    
+    if has_config("zlib") then
+        add_packages("zlib")
+        add_defines("CREST_HAS_ZLIB")
+    end
+    
+    if has_config("brotli") then
+        add_packages("brotli")
+        add_defines("CREST_HAS_BROTLI")
+    end
+    
+    if has_config("openssl") then
+        add_packages("openssl")
+        add_defines("CREST_HAS_OPENSSL")
+    end
 
 target("crest_example_cpp")
     set_kind("binary")
@@ -155,3 +200,66 @@ target("crest_test_template")
     add_deps("crest")
     add_includedirs("include")
     set_targetdir("build/tests")
+
+target("crest_test_session")
+    set_kind("binary")
+    add_files("tests/test_session.cpp")
+    add_deps("crest")
+    add_includedirs("include")
+    set_targetdir("build/tests")
+
+target("crest_test_async")
+    set_kind("binary")
+    add_files("tests/test_async.cpp")
+    add_deps("crest")
+    add_includedirs("include")
+    set_targetdir("build/tests")
+
+target("crest_test_server")
+    set_kind("binary")
+    add_files("tests/test_server.cpp")
+    add_deps("crest")
+    add_includedirs("include")
+    set_targetdir("build/tests")
+
+target("crest_test_parallel")
+    set_kind("binary")
+    add_files("tests/test_parallel.cpp")
+    add_deps("crest")
+    add_includedirs("include")
+    set_targetdir("build/tests")
+
+target("crest_bench_compression")
+    set_kind("binary")
+    add_files("benchmarks/compression_bench.cpp")
+    add_deps("crest")
+    add_includedirs("include")
+    set_targetdir("build/bench")
+
+target("crest_bench_rate_limit")
+    set_kind("binary")
+    add_files("benchmarks/rate_limit_bench.cpp")
+    add_deps("crest")
+    add_includedirs("include")
+    set_targetdir("build/bench")
+
+target("crest_bench_concurrent_map")
+    set_kind("binary")
+    add_files("benchmarks/concurrent_map_bench.cpp")
+    add_deps("crest")
+    add_includedirs("include")
+    set_targetdir("build/bench")
+
+target("crest_bench_db_pool")
+    set_kind("binary")
+    add_files("benchmarks/db_pool_bench.cpp")
+    add_deps("crest")
+    add_includedirs("include")
+    set_targetdir("build/bench")
+
+target("crest_bench_result_set")
+    set_kind("binary")
+    add_files("benchmarks/result_set_bench.cpp")
+    add_deps("crest")
+    add_includedirs("include")
+    set_targetdir("build/bench")